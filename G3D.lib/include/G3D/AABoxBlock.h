@@ -0,0 +1,199 @@
+/**
+  \file G3D/AABoxBlock.h
+
+  Groups of axis-aligned boxes laid out for testing against a ray with SIMD.
+
+  \created 2026-10-18
+  \edited  2026-10-18
+ */
+
+#ifndef G3D_AABoxBlock_h
+#define G3D_AABoxBlock_h
+
+#include "G3D/platform.h"
+#include "G3D/Array.h"
+#include "G3D/Vector3.h"
+#include "G3D/AABox.h"
+#include "G3D/Ray.h"
+#include "G3D/FastRay.h"
+#include "G3D/Float4.h"
+#include "G3D/Float8.h"
+#include "G3D/Vector3xN.h"
+
+namespace G3D {
+
+/**
+ \brief Float::SIZE axis-aligned boxes stored as structure-of-arrays
+ bounds, for testing one ray against several boxes at once.
+
+ intersect() is a branch-free slab test: it computes the distances at
+ which the ray crosses the two planes of each axis from the ray's
+ precomputed inverse direction, and intersects the three intervals.
+ Unlike Intersect::rayAABox(), it does not branch on the ray's
+ direction class, so it does not mispredict when neighboring rays
+ point different ways, and it reports both the entry and exit distance
+ of every box.
+
+ The typical use is testing the children of a wide tree node: test all
+ children with one call, then visit the lanes set in the returned mask
+ in order of their entry distance.
+
+ A ray that lies exactly in the plane of a face, parallel to it, is
+ treated as hitting the box.  Lanes past count() are never hit.
+
+ <pre>
+   Float4 enter, exit;
+   const int mask = node.childBounds.intersect(ray, maxDistance, enter, exit);
+   for (int i = 0; i < AABoxBlock4::SIZE; ++i) {
+       if (mask & (1 << i)) {
+           // Child i is hit between enter[i] and exit[i]
+           ...
+       }
+   }
+ </pre>
+
+ \sa AABoxBlock4, AABoxBlock8, TriangleBlockN, Intersect
+ */
+template<class Float>
+class AABoxBlockN {
+public:
+    enum {SIZE = Float::SIZE};
+
+    typedef Vector3xN<Float> Vector3N;
+
+private:
+
+    /** Component-major: m_low[axis][lane] */
+    float           m_low[3][SIZE];
+    float           m_high[3][SIZE];
+
+    int             m_count;
+
+    static Vector3N load(const float data[3][SIZE]) {
+        return Vector3N(Float::load(data[0]), Float::load(data[1]), Float::load(data[2]));
+    }
+
+    /** Clips [enter, exit] to one slab.  A NaN in t0 or t1 (0 * inf) means
+        that the ray is parallel to the slab and lies in the plane of one
+        of its faces, so that lane's slab is unbounded. */
+    static void clipSlab(const Float& t0, const Float& t1, Float& enter, Float& exit) {
+        const Float ordered = (t0 == t0) & (t1 == t1);
+        enter = _internal::laneSelect(ordered, _internal::laneMax(_internal::laneMin(t0, t1), enter), enter);
+        exit  = _internal::laneSelect(ordered, _internal::laneMin(_internal::laneMax(t0, t1), exit), exit);
+    }
+
+public:
+
+    /** An empty block */
+    AABoxBlockN() : m_count(0) {
+        for (int a = 0; a < 3; ++a) {
+            for (int i = 0; i < SIZE; ++i) {
+                m_low[a][i]  = 0.0f;
+                m_high[a][i] = 0.0f;
+            }
+        }
+    }
+
+    /** Number of boxes in the block */
+    int count() const {
+        return m_count;
+    }
+
+    bool full() const {
+        return m_count == SIZE;
+    }
+
+    /** Sets lane i, which must be less than or equal to count() */
+    void set(int i, const AABox& box) {
+        debugAssert(i >= 0 && i <= m_count && i < SIZE);
+        for (int a = 0; a < 3; ++a) {
+            m_low[a][i]  = box.low()[a];
+            m_high[a][i] = box.high()[a];
+        }
+        m_count = G3D::max(m_count, i + 1);
+    }
+
+    /** Adds a box to the end of a block that is not full() */
+    void append(const AABox& box) {
+        debugAssertM(! full(), "AABoxBlock is full");
+        set(m_count, box);
+    }
+
+    AABox bounds(int i) const {
+        debugAssert(i >= 0 && i < m_count);
+        return AABox(Point3(m_low[0][i], m_low[1][i], m_low[2][i]),
+                     Point3(m_high[0][i], m_high[1][i], m_high[2][i]));
+    }
+
+    /**
+     Tests a ray given by its origin and inverse direction, both
+     broadcast to every lane, against all boxes.  Use this form inside a
+     traversal loop so that the ray is broadcast only once.
+
+     \param enter Set to the distance at which the ray enters each box,
+     clamped to \a minDistance.
+
+     \param exit Set to the distance at which the ray leaves each box,
+     clamped to \a maxDistance.
+
+     \return A bit mask in which bit i is set if the ray hits box i
+     between \a minDistance and \a maxDistance.  enter and exit are
+     meaningful only for those lanes.
+     */
+    int intersect(const Vector3N& origin, const Vector3N& invDirection, float minDistance,
+                  float maxDistance, Float& enter, Float& exit) const {
+        const Vector3N t0 = (load(m_low) - origin) * invDirection;
+        const Vector3N t1 = (load(m_high) - origin) * invDirection;
+
+        enter = Float(minDistance);
+        exit  = Float(maxDistance);
+        clipSlab(t0.x, t1.x, enter, exit);
+        clipSlab(t0.y, t1.y, enter, exit);
+        clipSlab(t0.z, t1.z, enter, exit);
+
+        return (enter <= exit).movemask() & ((1 << m_count) - 1);
+    }
+
+    /** Tests \a ray between distances 0 and \a maxDistance */
+    int intersect(const Ray& ray, float maxDistance, Float& enter, Float& exit) const {
+        return intersect(Vector3N(ray.origin()), Vector3N(ray.invDirection()), 0.0f, maxDistance, enter, exit);
+    }
+
+    /** Tests \a ray within its distance interval */
+    int intersect(const FastRay& ray, Float& enter, Float& exit) const {
+        return intersect(Vector3N(ray.origin()), Vector3N(ray.invDirection()),
+                         ray.minDistance(), ray.maxDistance(), enter, exit);
+    }
+
+    int intersect(const FastRay& ray) const {
+        Float enter, exit;
+        return intersect(ray, enter, exit);
+    }
+
+    /** Bit mask of the boxes that the ray hits within \a maxDistance */
+    int intersect(const Ray& ray, float maxDistance = finf()) const {
+        Float enter, exit;
+        return intersect(ray, maxDistance, enter, exit);
+    }
+
+    /** Appends blocks holding \a boxes in order, so that box i is lane
+        i % SIZE of block i / SIZE. */
+    static void pack(const Array<AABox>& boxes, Array<AABoxBlockN>& blocks) {
+        for (int i = 0; i < boxes.size(); ++i) {
+            if ((i % SIZE) == 0) {
+                blocks.append(AABoxBlockN());
+            }
+            blocks.last().append(boxes[i]);
+        }
+    }
+};
+
+/** Four boxes tested with SSE.  \sa AABoxBlockN */
+typedef AABoxBlockN<Float4> AABoxBlock4;
+
+/** Eight boxes tested with AVX.  \sa AABoxBlockN */
+typedef AABoxBlockN<Float8> AABoxBlock8;
+
+} // namespace G3D
+
+#endif
@@ -24,6 +24,8 @@
 #endif
 #include <vector>
 #include <algorithm>
+#include <utility>
+#include <type_traits>
 
 #ifdef _MSC_VER
 #   include <new>
@@ -48,6 +50,29 @@ const int SORT_INCREASING = 1;
 const int SORT_DECREASING = -1;
 
 
+/**
+ \brief Determines whether G3D::Array may relocate elements of type T
+ with memcpy when it reallocates its storage.
+
+ The default is true for types with a trivial copy constructor and a
+ trivial destructor, such as int, Vector3, and AABox.  Elements of
+ other types are move-constructed into the new storage.  Specialize
+ this for types that are safe to move bytewise even though they do
+ not meet that test, e.g.,
+
+ \code
+ template<> struct TriviallyRelocatableTrait<MyHandle> {
+     static const bool value = true;
+ };
+ \endcode
+ */
+template<typename T> struct TriviallyRelocatableTrait {
+    static const bool value = 
+        std::is_trivially_copy_constructible<T>::value && 
+        std::is_trivially_destructible<T>::value;
+};
+
+
 
 /**
  \brief Dynamic 1D array tuned for performance.
@@ -68,11 +93,12 @@ const int SORT_DECREASING = -1;
  operation grows it to a reasonable internal size so it is efficient
  to append to small arrays. 
  
- Then Array needs to copy
- data internally on a resize operation it correctly invokes copy
+ When Array needs to move
+ data internally on a resize operation it correctly invokes move
  constructors of the elements (the MSVC6 implementation of
  std::vector uses realloc, which can create memory leaks for classes
- containing references and pointers).  Array provides a guaranteed
+ containing references and pointers), except for types whose
+ TriviallyRelocatableTrait allows a single memcpy.  Array provides a guaranteed
  safe way to access the underlying data as a flat C array --
  Array::getCArray.  Although (T*)std::vector::begin() can be used for
  this purpose, it is not guaranteed to succeed on all platforms.
@@ -87,12 +113,17 @@ const int SORT_DECREASING = -1;
  deallocate the underlying array unless MIN_ELEMENTS is set to 0, MIN_BYTES is 0, and the array
  is empty.
 
+ The template parameter Allocator is the allocation policy.  The default,
+ G3D::SystemAllocator, uses System::malloc and adds no size to the Array.
+ Use G3D::MemoryManagerAllocator to choose a MemoryManager at runtime with
+ clearAndSetMemoryManager().
+
  Do not subclass an Array.
 
  \sa G3D::SmallArray
  */
-template <class T, size_t MIN_ELEMENTS = 10>
-class Array {
+template <class T, size_t MIN_ELEMENTS = 10, class Allocator = SystemAllocator>
+class Array : private Allocator {
 
 private:
     /** Once the array has been allocated, it will never deallocate the underlying 
@@ -105,12 +136,19 @@ private:
     size_t              num;
     size_t              numAllocated;
 
-    MemoryManager::Ref  m_memoryManager;
+    /** The allocation policy is a private base class so that a stateless
+        policy takes no space */
+    Allocator& allocator() {
+        return *this;
+    }
+
+    const Allocator& allocator() const {
+        return *this;
+    }
 
     /** \param n Number of elements
     */
-    void init(size_t n, const MemoryManager::Ref& m) {
-        m_memoryManager = m;
+    void init(size_t n) {
         this->num = 0;
         this->numAllocated = 0;
         data = NULL;
@@ -122,7 +160,7 @@ private:
     }
 
     void _copy(const Array &other) {
-        init(other.num, MemoryManager::create());
+        init(other.num);
         for (size_t i = 0; i < num; ++i) {
             data[i] = other.data[i];
         }
@@ -145,7 +183,7 @@ private:
 
     /**
      Allocates a new array of size numAllocated (not a parameter to the method) 
-     and then copies at most oldNum elements from the old array to it.  Destructors are
+     and then moves at most oldNum elements from the old array to it.  Destructors are
      called for oldNum elements of the old array.
      */
     void realloc(size_t oldNum) {
@@ -156,23 +194,32 @@ private:
          // elements are actually revealed to the application.  They 
          // will be constructed in the resize() method.
 
-         data = (T*)m_memoryManager->alloc(sizeof(T) * numAllocated);
+         data = (T*)allocator().alloc(sizeof(T) * numAllocated);
          alwaysAssertM(data, "Memory manager returned NULL: out of memory?");
 
-         // Call the copy constructors
-         {const size_t N = G3D::min(oldNum, numAllocated);
-          const T* end = data + N;
-          T* oldPtr = oldData;
-          for (T* ptr = data; ptr < end; ++ptr, ++oldPtr) {
-
-             // Use placement new to invoke the constructor at the location
-             // that we determined.  Use the copy constructor to make the assignment.
-             const T* constructed = new (ptr) T(*oldPtr);
-
-             (void)constructed;
-             debugAssertM(constructed == ptr, 
-                 "new returned a different address than the one provided by Array.");
-         }}
+         const size_t N = G3D::min(oldNum, numAllocated);
+         if (TriviallyRelocatableTrait<T>::value) {
+             // Copying the bytes is equivalent to copy construction
+             // followed by destruction for these types
+             if (N > 0) {
+                 System::memcpy(data, oldData, sizeof(T) * N);
+             }
+         } else {
+             // Call the move constructors
+             const T* end = data + N;
+             T* oldPtr = oldData;
+             for (T* ptr = data; ptr < end; ++ptr, ++oldPtr) {
+
+                 // Use placement new to invoke the constructor at the location
+                 // that we determined.  Move from the old element, which is 
+                 // about to be destroyed.
+                 const T* constructed = new (ptr) T(std::move(*oldPtr));
+
+                 (void)constructed;
+                 debugAssertM(constructed == ptr, 
+                     "new returned a different address than the one provided by Array.");
+             }
+         }
 
          // Call destructors on the old array (if there is no destructor, this will compile away)
          {const T* end = oldData + oldNum;
@@ -180,7 +227,7 @@ private:
               ptr->~T();
          }}
 
-         m_memoryManager->free(oldData);
+         allocator().free(oldData);
     }
 
 public:
@@ -196,6 +243,27 @@ public:
        return *this;
    }
 
+   /** 
+    Move assignment.  Takes the elements and the allocator of \a other 
+    without copying, leaving \a other empty.
+    */
+   Array& operator=(Array&& other) {
+       if (this != &other) {
+           clear();
+           allocator().free(data);
+
+           allocator()  = other.allocator();
+           data         = other.data;
+           num          = other.num;
+           numAllocated = other.numAllocated;
+
+           other.data         = NULL;
+           other.num          = 0;
+           other.numAllocated = 0;
+       }
+       return *this;
+   }
+
    Array& operator=(const std::vector<T>& other) {
        resize(other.size());
        for (size_t i = 0; i < num; ++i) {
@@ -262,8 +330,8 @@ public:
        way to avoid large array copies when handing off data without involving reference counting
        or manual memory management. Beware that pointers or references into the arrays will 
        access memory in the <i>other</i> array after the swap. */
-   static void swap(Array<T, MIN_ELEMENTS>& a, Array<T, MIN_ELEMENTS>& b) {
-       alwaysAssertM(a.memoryManager() == b.memoryManager(), "The arrays are required to have the same memory manager");
+   static void swap(Array& a, Array& b) {
+       alwaysAssertM(a.allocator() == b.allocator(), "The arrays are required to have the same memory manager");
         std::swap(a.data, b.data);
         std::swap(a.num, b.num);
         std::swap(a.numAllocated, b.numAllocated);
@@ -279,26 +347,26 @@ public:
 
     /** Creates a zero length array (no heap allocation occurs until resize). */
     Array() : num(0) {
-        init(0, MemoryManager::create());
+        init(0);
     }
     
 
     /**  Creates an array containing v0. */
     explicit Array(const T& v0) {
-        init(1, MemoryManager::create());
+        init(1);
         (*this)[0] = v0;
     }
     
     /**  Creates an array containing v0 and v1. */
     Array(const T& v0, const T& v1) {
-        init(2, MemoryManager::create());
+        init(2);
         (*this)[0] = v0;
         (*this)[1] = v1;
     }
     
     /**  Creates an array containing v0...v2. */
     Array(const T& v0, const T& v1, const T& v2) {
-       init(3, MemoryManager::create());
+       init(3);
        (*this)[0] = v0;
        (*this)[1] = v1;
        (*this)[2] = v2;
@@ -306,7 +374,7 @@ public:
 
     /** Creates an array containing v0...v3. */
     Array(const T& v0, const T& v1, const T& v2, const T& v3) {
-       init(4, MemoryManager::create());
+       init(4);
        (*this)[0] = v0;
        (*this)[1] = v1;
        (*this)[2] = v2;
@@ -315,7 +383,7 @@ public:
 
     /** Creates an array containing v0...v4. */
     Array(const T& v0, const T& v1, const T& v2, const T& v3, const T& v4) {
-       init(5, MemoryManager::create());
+       init(5);
        (*this)[0] = v0;
        (*this)[1] = v1;
        (*this)[2] = v2;
@@ -332,25 +400,37 @@ public:
        _copy(other);
    }
 
-   explicit Array(const std::vector<T>& other) : num(0), data(NULL) {
+   /**
+    Move constructor.  Takes the elements of \a other without copying them
+    and leaves \a other empty.  Both arrays share \a other's allocator.
+    */
+   Array(Array&& other) : 
+       Allocator(other.allocator()),
+       data(other.data), num(other.num), numAllocated(other.numAllocated) {
+       other.data         = NULL;
+       other.num          = 0;
+       other.numAllocated = 0;
+   }
+
+   explicit Array(const std::vector<T>& other) : data(NULL), num(0), numAllocated(0) {
        *this = other;
    }
 
 
    /* Sets this to hold the same contents as other, with num = numAllocated (no unused allocated space) */
-   void copyFrom(const Array<T>& other) {
+   void copyFrom(const Array& other) {
         resize(0);
         append(other);
    }
 
 
    /** Resizes this to match the size of \a other and then copies the data from other using memcpy.  This is only safe for POD types */
-   void copyPOD(const Array<T>& other) {
+   void copyPOD(const Array& other) {
        if (numAllocated < other.num) {
-           m_memoryManager->free(data);
+           allocator().free(data);
            data = NULL;
            if (other.data) {
-              data = (T*)m_memoryManager->alloc(sizeof(T) * other.num);
+              data = (T*)allocator().alloc(sizeof(T) * other.num);
            }
            numAllocated = other.num;
        }
@@ -363,15 +443,15 @@ public:
 
    /** Resizes this to just barely match the size of \a other + itself and then copies the data to the end of the array from other using memcpy.  
         This is only safe for POD types */
-   void appendPOD(const Array<T>& other) {
+   void appendPOD(const Array& other) {
        const size_t oldSize = num;
        num += other.num;
        if (numAllocated < num) {
            alwaysAssertM(other.data, "non-zero array with no allocated space");
            T* old = data;
-           data = (T*)m_memoryManager->alloc(sizeof(T) * num);
+           data = (T*)allocator().alloc(sizeof(T) * num);
            System::memcpy(data, old, sizeof(T) * oldSize);
-           m_memoryManager->free(old);
+           allocator().free(old);
            numAllocated = num;
        }
        if (other.data) {
@@ -392,7 +472,7 @@ public:
            (data + i)->~T();
        }
        
-       m_memoryManager->free(data);
+       allocator().free(data);
        // Set to 0 in case this Array is global and gets referenced during app exit
        data = NULL;
        num = 0;
@@ -408,10 +488,14 @@ public:
        resize(0, shrink);
    }
 
+   /** Only available when Allocator is MemoryManagerAllocator */
    void clearAndSetMemoryManager(const MemoryManager::Ref& m) {
        clear();
-       debugAssert(data == NULL);
-       m_memoryManager = m;
+       // The storage belongs to the old memory manager
+       allocator().free(data);
+       data = NULL;
+       numAllocated = 0;
+       allocator().setMemoryManager(m);
    }
 
    /** resize(0, false) 
@@ -421,7 +505,7 @@ public:
    }
 
    inline MemoryManager::Ref memoryManager() const {
-       return m_memoryManager;
+       return allocator().memoryManager();
    }
 
    /**
@@ -445,7 +529,9 @@ public:
     */
    void fastRemove(int index, bool shrinkIfNecessary = false) {
        debugAssert(index < (int)num);
-       data[index] = data[num - 1];
+       if (index != (int)num - 1) {
+           data[index] = std::move(data[num - 1]);
+       }
        resize(size() - 1, shrinkIfNecessary);
    }
 
@@ -458,7 +544,7 @@ public:
        resize(num + 1, false);
 
        for (size_t i = (size_t)(num - 1); i > (size_t)n; --i) {
-           data[i] = data[i - 1];
+           data[i] = std::move(data[i - 1]);
        }
        data[n] = value;
    }
@@ -507,7 +593,7 @@ public:
         if ((MIN_ELEMENTS == 0) && (MIN_BYTES == 0) && (n == 0) && shrinkIfNecessary) {
             // Deallocate the array completely
             numAllocated = 0;
-            m_memoryManager->free(data);
+            allocator().free(data);
             data = NULL;
             return;
         }
@@ -601,6 +687,25 @@ public:
         }
     }
 
+    /**
+     Move \a value onto the end of the array.  It is safe to append an
+     element that is already in the array.
+     */
+    inline void append(T&& value) {
+        
+        if (num < numAllocated) {
+            new (data + num) T(std::move(value));
+            ++num;
+        } else if (inArray(&value)) {
+            // Resizing would move the value we have a reference to
+            T tmp(std::move(value));
+            append(std::move(tmp));
+        } else {
+            resize(num + 1, DONT_SHRINK_UNDERLYING_ARRAY);
+            data[num - 1] = std::move(value);
+        }
+    }
+
 
     inline void append(const T& v1, const T& v2) {
         if (inArray(&v1) || inArray(&v2)) {
@@ -743,7 +848,7 @@ public:
     Append the elements of array.  Cannot be called with this array
     as an argument.
     */
-   void append(const Array<T>& array) {
+   void append(const Array& array) {
        debugAssert(this != &array);
        size_t oldNum = num;
        size_t arrayLength = array.length();
@@ -771,7 +876,11 @@ public:
        append(value);
    }
 
-   inline void push(const Array<T>& array) {
+   inline void push(T&& value) {
+       append(std::move(value));
+   }
+
+   inline void push(const Array& array) {
        append(array);
    }
 
@@ -780,6 +889,10 @@ public:
        push(v);
    }
 
+   inline void push_back(T&& v) {
+       push(std::move(v));
+   }
+
    /** "The member function removes the last element of the controlled sequence, which must be non-empty."
         For compatibility with std::vector. */
    inline void pop_back() {
@@ -836,7 +949,7 @@ public:
     */
    inline T pop(bool shrinkUnderlyingArrayIfNecessary = true) {
        debugAssert(num > 0);
-       T temp = data[num - 1];
+       T temp(std::move(data[num - 1]));
        resize(num - 1, shrinkUnderlyingArrayIfNecessary);
        return temp;
    }
@@ -851,14 +964,14 @@ public:
 
    /**
     "The member function swaps the controlled sequences between *this and str."
-    Note that this is slower than the optimal std implementation.
+    The elements are moved, not copied.
 
     For compatibility with std::vector.
     */
-   void swap(Array<T>& str) {
-       Array<T> temp = str;
-       str = *this;
-       *this = temp;
+   void swap(Array& str) {
+       Array temp(std::move(str));
+       str = std::move(*this);
+       *this = std::move(temp);
    }
 
 
@@ -1047,7 +1160,7 @@ public:
         Iterator last = end() - count;
 
         while(element < last) {
-            element[0] = element[count];
+            element[0] = std::move(element[count]);
             ++element;
         }
         
@@ -1426,7 +1539,7 @@ return( lhs < rhs? true : false );
 	/** Number of bytes used by the array object and the memory allocated for it's data pointer. Does *not*
 	  * include the memory of objects pointed to by objects in the data array */
 	size_t sizeInMemory() const {
-		return sizeof(Array<T>) + (sizeof(T) * numAllocated);
+		return sizeof(Array) + (sizeof(T) * numAllocated);
 	}
 
     /** Remove all NULL elements in linear time without affecting order of the other elements. */
@@ -1436,7 +1549,7 @@ return( lhs < rhs? true : false );
              if (notNull(data[i])) {
                  if (i > nextNull) {
                     // Move value i down to squeeze out NULLs
-                    data[nextNull] = data[i];
+                    data[nextNull] = std::move(data[i]);
                  }
                 ++nextNull;
              }
@@ -4,7 +4,7 @@
  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
  
  \created 2001-08-09
- \edited  2013-01-03
+ \edited  2026-10-18
 
  Copyright 2000-2012, Morgan McGuire.
  All rights reserved.
@@ -126,6 +126,30 @@ private:
      */
     bool            m_freeBuffer;
 
+    /**
+     When true, the buffer is a read-only view of the whole file that is
+     unmapped in the destructor.
+     */
+    bool            m_memoryMapped;
+
+    /**
+     For a file written by BinaryOutput::compressChunks(), the number of
+     uncompressed bytes in each chunk; zero for all other input.  The
+     buffer then holds decompressed chunks, starting with chunk
+     m_alreadyRead / m_chunkSize.
+     */
+    int64           m_chunkSize;
+
+    /** Position in the file of each compressed chunk, followed by the
+        end of the last one */
+    Array<int64>    m_chunkOffset;
+
+    /** Allocated size of m_buffer while reading chunks */
+    int64           m_bufferCapacity;
+
+    /** Compressed chunks most recently read from the file */
+    Array<uint8>    m_compressedChunks;
+
     /** Ensures that we are able to read at least minLength from startPosition (relative
         to start of file). */
     void loadIntoMemory(int64 startPosition, int64 minLength = 0);
@@ -141,23 +165,91 @@ private:
 
     /** Buffer is compressed; replace it with a decompressed version */
     void decompress();
+
+    /** Replaces the buffer with the decompressed contents of \a data,
+        which was written by BinaryOutput::compressChunks() */
+    void decompressAllChunks(const uint8* data, int64 dataLen);
+
+    /** If the file was written by BinaryOutput::compressChunks(), reads
+        its chunk index so that chunks can be decompressed as they are
+        read, and returns true. */
+    bool openChunks();
+
+    /** loadIntoMemory() for files read through openChunks() */
+    void loadChunks(int64 startPosition, int64 minLength);
+
+public:
+
+    /** How the file constructor brings an uncompressed file into memory */
+    enum FileAccess {
+        /** Read the file into a heap buffer.  Files larger than
+            INITIAL_BUFFER_LENGTH are read in windows as they are used. */
+        COPY_TO_MEMORY,
+
+        /** Map the whole file into the address space and tell the
+            operating system that it will be read in order, so that it
+            reads ahead aggressively and may release pages soon after
+            they are read. */
+        MEMORY_MAP_SEQUENTIAL,
+
+        /** Map the whole file into the address space and ask the
+            operating system not to read ahead, for files that are
+            mostly accessed with setPosition() and skip(). */
+        MEMORY_MAP_RANDOM
+    };
+
+private:
+
+    /** Maps the whole file read-only.  Returns false, leaving the
+        buffer unchanged, if the file cannot be mapped. */
+    bool mapFile(FileAccess access);
+
 public:
 
     /** false, constant to use with the copyMemory option */
     static const bool       NO_COPY;
 
+    /**
+     The first 8 bytes of data written by BinaryOutput::compressChunks().
+     They are followed, in the file's endian, by:
+
+     - uint32 number of uncompressed bytes per chunk
+     - uint32 number of chunks, n
+     - uint64 total number of uncompressed bytes
+     - n + 1 uint64 offsets of each zlib-compressed chunk from the start
+       of the data, followed by the offset of the end of the last chunk
+
+     and then by the chunks.  The fifth byte can never start a zlib
+     stream, so this data is not mistaken for the single-stream format
+     written by BinaryOutput::compress().
+     */
+    static const char* const COMPRESSED_CHUNKS_MAGIC;
+
     /**
        If the file cannot be opened, a zero length buffer is presented.
        Automatically opens files that are inside zipfiles.
 
        @param compressed Set to true if and only if the file was
        compressed using BinaryOutput's zlib compression.  This has
-       nothing to do with whether the input is in a zipfile.
+       nothing to do with whether the input is in a zipfile.  Files
+       written with BinaryOutput::compressChunks() are decompressed one
+       chunk at a time as they are read, so only the chunks around the
+       current position are in memory.
+
+       @param access With MEMORY_MAP_SEQUENTIAL or MEMORY_MAP_RANDOM,
+       an uncompressed file on disk is read directly from the operating
+       system's page cache instead of being copied into a heap buffer,
+       so opening it costs no copy and its pages count against resident
+       memory only while they are in use.  The file must not be
+       modified while the BinaryInput exists.  Compressed files, files
+       inside zipfiles, empty files, and files that cannot be mapped
+       are read as with COPY_TO_MEMORY.
     */
     BinaryInput(
         const std::string&  filename,
         G3DEndian           fileEndian,
-        bool                compressed = false);
+        bool                compressed = false,
+        FileAccess          access = COPY_TO_MEMORY);
 
     /**
      Creates input stream from an in memory source.
@@ -204,6 +296,12 @@ public:
         return m_filename;
     }
 
+    /** True if the file is read through a memory mapping rather than
+        a heap buffer.  \sa FileAccess */
+    bool memoryMapped() const {
+        return m_memoryMapped;
+    }
+
     /**
      Performs bounds checks in debug mode.  [] are relative to
      the start of the file, not the current position.
@@ -404,6 +502,24 @@ public:
     Color4 readColor4();
     Color3 readColor3();
 
+    /** Reads \a n Vector3s, as written by BinaryOutput::writeVector3(),
+        into \a out, which is resized to \a n.  Reads the whole array with
+        one copy, and byte swaps all of it at once if the endian differs
+        from the machine's. */
+    void readVector3(Array<Vector3>& out, int64 n);
+
+    /** \copydoc readVector3(Array<Vector3>&, int64) */
+    void readVector3int16(Array<class Vector3int16>& out, int64 n);
+
+    /** Reads \a n boxes in the format of AABox::serialize() into \a out,
+        which is resized to \a n */
+    void readAABox(Array<class AABox>& out, int64 n);
+
+    /** Reads \a n unsigned 16-bit indices and widens them to int,
+        resizing \a out to \a n.  For 32-bit indices, use
+        readInt32(Array<int32>&, int64). */
+    void readIndex16(Array<int>& out, int64 n);
+
     /**
      Skips ahead n bytes.
      */
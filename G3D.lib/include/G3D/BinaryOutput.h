@@ -4,7 +4,7 @@
  \maintainer Morgan McGuire, http://graphics.cs.williams.edu
  
  \created 2001-08-09
- \edited  2011-08-24
+ \edited  2026-10-18
 
  Copyright 2000-2012, Morgan McGuire.
  All rights reserved.
@@ -29,6 +29,7 @@
 #include "G3D/debug.h"
 #include "G3D/BinaryInput.h"
 #include "G3D/System.h"
+#include "G3D/GThread.h"
 
 #ifdef _MSC_VER
 #   pragma warning (push)
@@ -37,6 +38,10 @@
 #endif
 namespace G3D {
 
+namespace _internal {
+class BinaryOutputWriter;
+}
+
 /**
  Sequential or random access byte-order independent binary file access.
 
@@ -90,8 +95,16 @@ private:
 
     bool            m_ok;
 
+    /** Non-NULL between startBackgroundWriter() and commit() */
+    shared_ptr<_internal::BinaryOutputWriter> m_writer;
+
     void reserveBytesWhenOutOfMemory(size_t bytes);
 
+    /** Called instead of growing the buffer while streaming.  Hands
+        everything before m_pos to the writer and continues in a fresh
+        chunk. */
+    void streamChunk(size_t bytes);
+
     void reallocBuffer(size_t bytes, size_t oldBufferLen);
 
     /**
@@ -144,9 +157,51 @@ public:
      */
     void compress(int level = 9);
 
+    /** Compresses the data in the buffer in place as a sequence of
+        independently compressed chunks of \a chunkSize uncompressed
+        bytes, preceded by a header and an index of the chunks'
+        offsets.  The chunks are compressed concurrently on up to
+        \a maxThreads threads.
+
+        BinaryInput reads the result when constructed with compressed =
+        true.  When reading from a file, it keeps only the chunks that
+        are being read in memory, and setPosition() decompresses only the
+        chunk that contains the new position.
+
+        Call immediately before commit().  Like compress(), this cannot
+        be used for huge files or while streaming.
+
+        \param level Compression level.  0 = fast, low compression; 9 = slow, high compression
+     */
+    void compressChunks(int level = 9, int chunkSize = 1024 * 1024, int maxThreads = GThread::NUM_CORES);
+
     /** True if no errors have been encountered.*/
     bool ok() const;
 
+    /**
+     Streams the file to disk while it is being written.  Whenever the
+     current chunk of \a chunkSize bytes fills, it is handed to a
+     background thread that appends it to the file, and writing
+     continues in a fresh chunk, so writing and disk I/O overlap and
+     memory use stays bounded.  If \a maxQueuedChunks chunks are already
+     waiting for the disk, writing blocks until one is written.
+
+     Call on a file BinaryOutput before writing anything.  commit()
+     writes the last chunk, waits for the thread to finish, and sets
+     ok() to false if any write failed.  The file is created (empty) by
+     this call and is complete only after commit().
+
+     While streaming, getCArray() returns only the current chunk, and
+     setPosition(), setLength(), and skip() cannot move before its
+     start.  compress() is not supported.
+     */
+    void startBackgroundWriter(size_t chunkSize = 4 * 1024 * 1024, int maxQueuedChunks = 4);
+
+    /** True between startBackgroundWriter() and commit() */
+    bool streaming() const {
+        return m_writer.get() != NULL;
+    }
+
     /**
      Returns a pointer to the internal memory buffer.
      */
@@ -176,6 +231,8 @@ public:
 
      @param flush If true (default) the file is ready for reading when the method returns, otherwise 
       the method returns immediately and writes the file in the background.
+      After startBackgroundWriter(), commit always waits for the
+      background writes to finish.
     */
     void commit(bool flush = true);
 
@@ -381,6 +438,22 @@ public:
 
     void writeColor3(const Color3& v);
 
+    /** Writes the first \a n elements of \a v with one copy, byte
+        swapping all of them at once if the endian differs from the
+        machine's.  Read with BinaryInput::readVector3(Array<Vector3>&, int64). */
+    void writeVector3(const Array<Vector3>& v, int n);
+
+    /** \copydoc writeVector3(const Array<Vector3>&, int) */
+    void writeVector3int16(const Array<class Vector3int16>& v, int n);
+
+    /** Writes the first \a n boxes in the format of AABox::serialize() */
+    void writeAABox(const Array<class AABox>& b, int n);
+
+    /** Writes the first \a n indices, which must be less than 65536, as
+        unsigned 16-bit integers.  For 32-bit indices, use
+        writeInt32(const Array<int32>&, int). */
+    void writeIndex16(const Array<int>& index, int n);
+
     /**
      Skips ahead n bytes.
      */
@@ -0,0 +1,221 @@
+/**
+  \file G3D/CompactMesh.h
+
+  Indexed triangle mesh with small vertices and indices, for collision.
+
+  \created 2026-10-18
+  \edited  2026-10-18
+ */
+
+#ifndef G3D_CompactMesh_h
+#define G3D_CompactMesh_h
+
+#include "G3D/platform.h"
+#include "G3D/g3dmath.h"
+#include "G3D/Array.h"
+#include "G3D/Vector3.h"
+#include "G3D/Vector3int16.h"
+#include "G3D/AABox.h"
+#include "G3D/Sphere.h"
+#include "G3D/Triangle.h"
+#include "G3D/Ray.h"
+#include "G3D/FastRay.h"
+#include "G3D/AABoxBlock.h"
+
+namespace G3D {
+
+/**
+ \brief Immutable indexed triangle mesh that stores little more than its
+ vertices and indices, and answers ray, sphere, and box queries directly.
+
+ An Array<Triangle> costs over 100 bytes per triangle because every
+ Triangle caches its plane, edges, and area.  CompactMesh keeps one
+ shared vertex array and three indices per triangle:
+
+ - Indices are 16-bit when there are at most 65536 vertices and 32-bit
+   otherwise.
+ - Vertices are full-precision Vector3s, or with QUANTIZED, Vector3int16s
+   on a grid that spans the bounds of the mesh.  The error is at most
+   half of quantizationStep() on each axis.  Shared vertices decode to
+   identical positions, so a closed mesh stays closed.
+
+ The only derived data are the bounds of each cluster of
+ CLUSTER_SIZE consecutive triangles, kept in AABoxBlock8s (about 3 bytes
+ per triangle).  A ray query tests eight clusters at once against those
+ boxes and then tests the triangles of each hit cluster as a
+ TriangleBlock8.  Sphere and box queries cull by cluster and by
+ triangle bounds before building a Triangle for the exact
+ CollisionDetection test.  Culling works best when consecutive
+ triangles are near one another, as they are in most exported meshes
+ and in strips.
+
+ Queries cost time proportional to the number of clusters.  For large
+ static meshes, put several CompactMeshes in a KDTree or
+ DynamicAABBTree.
+
+ \sa Triangle, MeshAlg, TriangleBlockN
+ */
+class CompactMesh {
+public:
+
+    enum VertexFormat {
+        /** 12 bytes per vertex */
+        FULL_PRECISION,
+
+        /** 6 bytes per vertex, snapped to a 65536^3 grid over the bounds */
+        QUANTIZED
+    };
+
+    /** Number of consecutive triangles that share one bounding box */
+    enum {CLUSTER_SIZE = 8};
+
+private:
+
+    typedef AABoxBlock8::Vector3N Vector3N;
+
+    VertexFormat            m_format;
+
+    /** Used when m_format == FULL_PRECISION */
+    Array<Point3>           m_vertex;
+
+    /** Used when m_format == QUANTIZED.  Each component is stored offset by
+        -32768 so that the full range of int16 is used. */
+    Array<Vector3int16>     m_quantizedVertex;
+
+    /** Used when there are at most 65536 vertices */
+    Array<uint16>           m_index16;
+
+    /** Used when there are more than 65536 vertices */
+    Array<uint32>           m_index32;
+
+    int                     m_numVertices;
+
+    int                     m_numTriangles;
+
+    AABox                   m_bounds;
+
+    /** Size of one quantization step on each axis */
+    Vector3                 m_step;
+
+    /** Bounds of cluster c are lane c % 8 of block c / 8 */
+    Array<AABoxBlock8>      m_cluster;
+
+    void computeClusters();
+
+    /** Calls callback(t, v0, v1, v2) for every triangle t whose bounds
+        overlap box, until the callback returns false */
+    template<class Callback>
+    void forEachTriangleNear(const AABox& box, Callback& callback) const;
+
+    /** Tests the triangles of cluster c against ray, shortening it at hits */
+    int intersectCluster(int c, FastRay& ray, float& w0, float& w1, float& w2) const;
+
+    bool intersectsAnyInCluster(int c, const FastRay& ray) const;
+
+public:
+
+    /** An empty mesh */
+    CompactMesh();
+
+    /**
+     \param index Three vertex indices per triangle, which are
+     counter-clockwise when viewed from the front.
+     */
+    CompactMesh(const Array<Point3>& vertex, const Array<int>& index, VertexFormat format = FULL_PRECISION);
+
+    void set(const Array<Point3>& vertex, const Array<int>& index, VertexFormat format = FULL_PRECISION);
+
+    void clear();
+
+    VertexFormat format() const {
+        return m_format;
+    }
+
+    int numVertices() const {
+        return m_numVertices;
+    }
+
+    int numTriangles() const {
+        return m_numTriangles;
+    }
+
+    /** Bounds of all vertices */
+    const AABox& bounds() const {
+        return m_bounds;
+    }
+
+    /** Distance between adjacent quantized positions on each axis.  Zero
+        for FULL_PRECISION. */
+    const Vector3& quantizationStep() const {
+        return m_step;
+    }
+
+    /** Vertex \a v, decoded if quantized */
+    Point3 vertex(int v) const {
+        debugAssert(v >= 0 && v < m_numVertices);
+        if (m_format == QUANTIZED) {
+            const Vector3int16& q = m_quantizedVertex[v];
+            return m_bounds.low() + m_step * Vector3(float(int(q.x) + 32768),
+                                                     float(int(q.y) + 32768),
+                                                     float(int(q.z) + 32768));
+        } else {
+            return m_vertex[v];
+        }
+    }
+
+    /** Index of corner \a i (0, 1, or 2) of triangle \a t */
+    int index(int t, int i) const {
+        debugAssert(t >= 0 && t < m_numTriangles && i >= 0 && i < 3);
+        return (m_index32.size() > 0) ? int(m_index32[3 * t + i]) : int(m_index16[3 * t + i]);
+    }
+
+    void getTriangle(int t, Point3& v0, Point3& v1, Point3& v2) const {
+        v0 = vertex(index(t, 0));
+        v1 = vertex(index(t, 1));
+        v2 = vertex(index(t, 2));
+    }
+
+    /** Builds a full Triangle, with all of its derived data */
+    Triangle triangle(int t) const {
+        Point3 v0, v1, v2;
+        getTriangle(t, v0, v1, v2);
+        return Triangle(v0, v1, v2);
+    }
+
+    /** Bytes of heap memory used */
+    size_t sizeInBytes() const;
+
+    /**
+     Finds the closest front-face hit of \a ray within its distance
+     interval.  On a hit, shortens the ray's interval to end at the hit,
+     sets the weights of the triangle's three vertices, and returns the
+     index of the triangle.  Otherwise returns -1.
+     */
+    int intersect(FastRay& ray, float& w0, float& w1, float& w2) const;
+
+    int intersect(FastRay& ray) const {
+        float w0, w1, w2;
+        return intersect(ray, w0, w1, w2);
+    }
+
+    /** Finds the closest hit nearer than \a distance and updates
+        \a distance; see intersect(FastRay&) */
+    int intersect(const Ray& ray, float& distance, float& w0, float& w1, float& w2) const;
+
+    /** True if \a ray hits any front face within its distance interval.
+        Stops at the first hit, so it is faster than intersect() for
+        line-of-sight tests. */
+    bool intersectsAny(const FastRay& ray) const;
+
+    /** Appends the indices of the triangles that touch \a sphere */
+    void getIntersectingTriangles(const Sphere& sphere, Array<int>& triangles) const;
+
+    /** Appends the indices of the triangles that touch \a box */
+    void getIntersectingTriangles(const AABox& box, Array<int>& triangles) const;
+
+    bool intersects(const Sphere& sphere) const;
+};
+
+} // namespace G3D
+
+#endif
@@ -253,6 +253,10 @@ public:
 
     void toWorldSpace(const class AABox& b, class AABox& result) const;
 
+    /** Computes the world-space bounds of every box in \a b.  \a b and
+        \a result may be the same array. */
+    void toWorldSpace(const Array<AABox>& b, Array<AABox>& result) const;
+
     class Box toWorldSpace(const class AABox& b) const;
 
     class Box toWorldSpace(const class Box& b) const;
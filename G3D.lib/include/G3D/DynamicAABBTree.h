@@ -0,0 +1,726 @@
+/**
+  \file G3D/DynamicAABBTree.h
+
+  Bounding volume hierarchy for sets of moving objects.
+
+  \created 2026-10-18
+  \edited  2026-10-18
+ */
+
+#ifndef G3D_DynamicAABBTree_h
+#define G3D_DynamicAABBTree_h
+
+#include "G3D/platform.h"
+#include "G3D/Array.h"
+#include "G3D/Table.h"
+#include "G3D/AABox.h"
+#include "G3D/Sphere.h"
+#include "G3D/Ray.h"
+#include "G3D/SmallArray.h"
+#include "G3D/BoundsTrait.h"
+// For the BoundsTrait specializations of the G3D geometry classes
+#include "G3D/KDTree.h"
+#include <algorithm>
+
+namespace G3D {
+
+/**
+ \brief A set of objects with axis-aligned bounds that supports fast
+ overlap and ray queries while its members move.
+
+ Each member is a leaf of a binary tree whose interior nodes hold the
+ union of the bounds below them.  Leaves store <i>fattened</i> bounds:
+ the member's own bounds grown by a margin (and optionally stretched in
+ the direction the member is moving).  update() is O(1) while a member
+ stays inside its fattened bounds and O(log n) when it leaves them.
+ Insertion chooses the sibling that least increases the total surface
+ area of the tree.  On the way back to the root, every modification
+ applies tree rotations that reduce surface area, which keeps query
+ performance close to that of a tree built from scratch, and rotations
+ that limit the difference in height between subtrees, which bounds the
+ depth for members inserted in sorted order.  rebuild() restores an
+ optimal tree after large changes.
+
+ Unlike KDTree there is no balance() step and no splitting planes, so
+ this is the better choice for players, creatures and projectiles that
+ move every frame.  KDTree remains faster to query for static content.
+
+ The template parameters are the same as for KDTree: <i>T</i> needs
+ BoundsTrait, HashTrait and EqualsTrait specializations, and the hash
+ code and equality of a value must not depend on its position, so that
+ a moved object can be found again by update() and remove().
+
+ Values are copied into the tree.  The pointers returned by queries
+ remain valid until the tree is next modified.
+
+ \sa KDTree, PointHashGrid
+ */
+template< class T,
+          class BoundsFunc = BoundsTrait<T>,
+          class HashFunc   = HashTrait<T>,
+          class EqualsFunc = EqualsTrait<T> >
+class DynamicAABBTree {
+protected:
+
+    enum {NONE = -1};
+
+    /** Largest difference in height between the subtrees of a node
+        before rotate() restores balance at the expense of area.  Small
+        values make queries slower; without the limit, members inserted
+        in sorted order degenerate the tree into a list. */
+    enum {MAX_IMBALANCE = 8};
+
+    /** Interior nodes have two children; leaves refer to one member.
+        Values are kept out of the nodes so that traversal touches as
+        little memory as possible. */
+    class Node {
+    public:
+        /** Union of the children for interior nodes, fattened member
+            bounds for leaves. */
+        AABox           bounds;
+
+        /** Index of the parent, or the next free node while on the free list */
+        int             parent;
+
+        int             child[2];
+
+        /** 0 for leaves, -1 for free nodes */
+        int             height;
+
+        /** Index into m_member.  Leaves only. */
+        int             member;
+
+        Node() : parent(NONE), height(-1), member(NONE) {
+            child[0] = child[1] = NONE;
+        }
+
+        bool isLeaf() const {
+            return child[0] == NONE;
+        }
+    };
+
+    class Member {
+    public:
+        T               value;
+
+        /** Exact bounds of value */
+        AABox           bounds;
+
+        int             leaf;
+    };
+
+    /** Orders leaves by the center of their bounds along one axis */
+    class CenterComparator {
+    public:
+        const Array<Node>&  node;
+        const int           axis;
+
+        CenterComparator(const Array<Node>& node, int axis) : node(node), axis(axis) {}
+
+        bool operator()(int a, int b) const {
+            const AABox& A = node[a].bounds;
+            const AABox& B = node[b].bounds;
+            return (A.low()[axis] + A.high()[axis]) < (B.low()[axis] + B.high()[axis]);
+        }
+    };
+
+    /** Nodes are addressed by index so that the pool can grow */
+    Array<Node>         m_node;
+
+    /** Packed so that getMembers() and rebuild() are linear scans */
+    Array<Member>       m_member;
+
+    int                 m_root;
+
+    /** Head of the list of unused entries in m_node, linked through Node::parent */
+    int                 m_freeList;
+
+    /** Maps each member to its leaf */
+    Table<T, int, HashFunc, EqualsFunc> m_leaf;
+
+    float               m_margin;
+
+    int allocateNode() {
+        int i;
+        if (m_freeList == NONE) {
+            i = m_node.size();
+            m_node.next();
+        } else {
+            i = m_freeList;
+            m_freeList = m_node[i].parent;
+        }
+        Node& n = m_node[i];
+        n.parent = NONE;
+        n.child[0] = n.child[1] = NONE;
+        n.height = 0;
+        n.member = NONE;
+        return i;
+    }
+
+    void freeNode(int i) {
+        Node& n = m_node[i];
+        n.height = -1;
+        n.parent = m_freeList;
+        m_freeList = i;
+    }
+
+    /** Inline equivalent of AABox::intersects for the traversal loops */
+    static bool overlaps(const AABox& a, const AABox& b) {
+        return (a.low().x <= b.high().x) && (b.low().x <= a.high().x) &&
+               (a.low().y <= b.high().y) && (b.low().y <= a.high().y) &&
+               (a.low().z <= b.high().z) && (b.low().z <= a.high().z);
+    }
+
+    static AABox merged(const AABox& a, const AABox& b) {
+        return AABox(a.low().min(b.low()), a.high().max(b.high()));
+    }
+
+    /** valueBounds grown by the margin and swept by displacement */
+    AABox fatten(const AABox& valueBounds, const Vector3& displacement) const {
+        const Vector3 m(m_margin, m_margin, m_margin);
+        return AABox(valueBounds.low() - m + displacement.min(Vector3::zero()),
+                     valueBounds.high() + m + displacement.max(Vector3::zero()));
+    }
+
+    /** Inserts the leaf next to the existing node that minimizes the
+        increase in total surface area, then refits the ancestors. */
+    void insertLeaf(int leaf) {
+        if (m_root == NONE) {
+            m_root = leaf;
+            m_node[leaf].parent = NONE;
+            return;
+        }
+
+        const AABox leafBounds = m_node[leaf].bounds;
+        int index = m_root;
+        while (! m_node[index].isLeaf()) {
+            const Node& n = m_node[index];
+            const float area = n.bounds.area();
+            const float combinedArea = merged(n.bounds, leafBounds).area();
+
+            // Cost of making a new parent for this node and the leaf
+            const float cost = 2.0f * combinedArea;
+
+            // Minimum cost of pushing the leaf further down the tree
+            const float inheritanceCost = 2.0f * (combinedArea - area);
+
+            float childCost[2];
+            for (int c = 0; c < 2; ++c) {
+                const Node& child = m_node[n.child[c]];
+                const float a = merged(child.bounds, leafBounds).area();
+                childCost[c] = inheritanceCost + (child.isLeaf() ? a : (a - child.bounds.area()));
+            }
+
+            if ((cost < childCost[0]) && (cost < childCost[1])) {
+                break;
+            }
+
+            index = n.child[(childCost[1] < childCost[0]) ? 1 : 0];
+        }
+
+        const int sibling = index;
+        const int oldParent = m_node[sibling].parent;
+        const int newParent = allocateNode();
+        Node& p = m_node[newParent];
+        p.parent   = oldParent;
+        p.bounds   = merged(leafBounds, m_node[sibling].bounds);
+        p.height   = m_node[sibling].height + 1;
+        p.child[0] = sibling;
+        p.child[1] = leaf;
+        m_node[sibling].parent = newParent;
+        m_node[leaf].parent = newParent;
+
+        if (oldParent == NONE) {
+            m_root = newParent;
+        } else {
+            Node& op = m_node[oldParent];
+            op.child[(op.child[0] == sibling) ? 0 : 1] = newParent;
+        }
+
+        refitAncestors(newParent);
+    }
+
+    /** Detaches the leaf from the tree without freeing it */
+    void removeLeaf(int leaf) {
+        if (leaf == m_root) {
+            m_root = NONE;
+            return;
+        }
+
+        const int parent = m_node[leaf].parent;
+        const int grandParent = m_node[parent].parent;
+        const int sibling = m_node[parent].child[(m_node[parent].child[0] == leaf) ? 1 : 0];
+
+        if (grandParent == NONE) {
+            m_root = sibling;
+            m_node[sibling].parent = NONE;
+        } else {
+            Node& gp = m_node[grandParent];
+            gp.child[(gp.child[0] == parent) ? 0 : 1] = sibling;
+            m_node[sibling].parent = grandParent;
+            refitAncestors(grandParent);
+        }
+        freeNode(parent);
+    }
+
+    /** Rebalances and recomputes the bounds and heights from index to the root */
+    void refitAncestors(int index) {
+        while (index != NONE) {
+            index = rotate(index);
+            Node& n = m_node[index];
+            const Node& a = m_node[n.child[0]];
+            const Node& b = m_node[n.child[1]];
+            n.height = 1 + max(a.height, b.height);
+            n.bounds = merged(a.bounds, b.bounds);
+            index = n.parent;
+        }
+    }
+
+    /** Applies at most one rotation at interior node a.  If one subtree is
+        more than MAX_IMBALANCE taller than the other, a child of the taller
+        one is promoted to bound the height of the tree.  Otherwise, a child
+        of a is swapped with a grandchild on the other side when that
+        reduces the surface area of the tree.  Returns the index of the
+        node now at a's position. */
+    int rotate(int a) {
+        const Node& A = m_node[a];
+        if (A.isLeaf()) {
+            return a;
+        }
+
+        const int balance = m_node[A.child[1]].height - m_node[A.child[0]].height;
+        if (balance > MAX_IMBALANCE) {
+            return promote(a, 1);
+        } else if (balance < -MAX_IMBALANCE) {
+            return promote(a, 0);
+        }
+
+        // Find the swap of a child with a grandchild that most reduces the
+        // area of the grandchild's parent.  a's own bounds do not change.
+        float bestGain = 0.0f;
+        int bestSide = NONE;
+        int bestGrandchild = NONE;
+        for (int side = 0; side < 2; ++side) {
+            const Node& X = m_node[A.child[side]];
+            const Node& Y = m_node[A.child[1 - side]];
+            if (Y.isLeaf()) {
+                continue;
+            }
+            const float area = Y.bounds.area();
+            for (int k = 0; k < 2; ++k) {
+                const float gain = area - merged(X.bounds, m_node[Y.child[1 - k]].bounds).area();
+                if (gain > bestGain) {
+                    bestGain = gain;
+                    bestSide = side;
+                    bestGrandchild = k;
+                }
+            }
+        }
+
+        if (bestSide != NONE) {
+            const int x = A.child[bestSide];
+            const int y = A.child[1 - bestSide];
+            Node& Y = m_node[y];
+            const int g = Y.child[bestGrandchild];
+            const int keep = Y.child[1 - bestGrandchild];
+
+            m_node[a].child[bestSide] = g;
+            m_node[g].parent = a;
+            Y.child[bestGrandchild] = x;
+            m_node[x].parent = y;
+            Y.bounds = merged(m_node[x].bounds, m_node[keep].bounds);
+            Y.height = 1 + max(m_node[x].height, m_node[keep].height);
+        }
+
+        return a;
+    }
+
+    /** Rotates child[side] of a up into a's position; a adopts the shorter
+        grandchild in its place. */
+    int promote(int a, int side) {
+        Node& A = m_node[a];
+        const int c = A.child[side];
+        Node& C = m_node[c];
+        const int f = C.child[0];
+        const int g = C.child[1];
+
+        // Swap a and c
+        C.child[0] = a;
+        C.parent = A.parent;
+        A.parent = c;
+
+        if (C.parent == NONE) {
+            m_root = c;
+        } else {
+            Node& P = m_node[C.parent];
+            P.child[(P.child[0] == a) ? 0 : 1] = c;
+        }
+
+        // Keep the taller grandchild under c
+        const bool fTaller = m_node[f].height > m_node[g].height;
+        const int keep  = fTaller ? f : g;
+        const int moved = fTaller ? g : f;
+        C.child[1] = keep;
+        A.child[side] = moved;
+        m_node[moved].parent = a;
+
+        const Node& other = m_node[A.child[1 - side]];
+        A.bounds = merged(other.bounds, m_node[moved].bounds);
+        A.height = 1 + max(other.height, m_node[moved].height);
+
+        C.bounds = merged(A.bounds, m_node[keep].bounds);
+        C.height = 1 + max(A.height, m_node[keep].height);
+
+        return c;
+    }
+
+    /** Reinserts leaf i with new fat bounds */
+    void moveLeaf(int i, const Vector3& displacement) {
+        removeLeaf(i);
+        m_node[i].bounds = fatten(m_member[m_node[i].member].bounds, displacement);
+        insertLeaf(i);
+    }
+
+    /** Builds a subtree over the leaves by recursive median splits along
+        the longest axis of their centers.  Returns the subtree root. */
+    int buildSubtree(int* leaf, int n) {
+        if (n == 1) {
+            return leaf[0];
+        }
+
+        AABox centers = AABox(m_node[leaf[0]].bounds.center());
+        for (int i = 1; i < n; ++i) {
+            centers.merge(m_node[leaf[i]].bounds.center());
+        }
+        const int axis = centers.extent().primaryAxis();
+
+        const int mid = n / 2;
+        std::nth_element(leaf, leaf + mid, leaf + n, CenterComparator(m_node, axis));
+
+        const int c0 = buildSubtree(leaf, mid);
+        const int c1 = buildSubtree(leaf + mid, n - mid);
+
+        const int i = allocateNode();
+        Node& p = m_node[i];
+        p.child[0] = c0;
+        p.child[1] = c1;
+        p.bounds = merged(m_node[c0].bounds, m_node[c1].bounds);
+        p.height = 1 + max(m_node[c0].height, m_node[c1].height);
+        m_node[c0].parent = i;
+        m_node[c1].parent = i;
+        return i;
+    }
+
+    /** Slab test of the ray against the box over [0, maxDistance].  A ray
+        that lies in the plane of a face hits the box. */
+    static bool rayIntersects(const Ray& ray, const AABox& box, float maxDistance, float& enter) {
+        const Vector3& origin = ray.origin();
+        const Vector3& inv = ray.invDirection();
+        float t0 = 0.0f;
+        float t1 = maxDistance;
+        for (int a = 0; a < 3; ++a) {
+            float tNear = (box.low()[a] - origin[a]) * inv[a];
+            float tFar  = (box.high()[a] - origin[a]) * inv[a];
+            if ((tNear != tNear) || (tFar != tFar)) {
+                // NaN (0 * inf): the ray is parallel to this slab and lies in
+                // the plane of one of its faces, so the slab does not clip it
+                continue;
+            }
+            if (tNear > tFar) {
+                std::swap(tNear, tFar);
+            }
+            if (tNear > t0) { t0 = tNear; }
+            if (tFar < t1)  { t1 = tFar; }
+        }
+        enter = t0;
+        return t0 <= t1;
+    }
+
+    void getIntersectingMembers(const AABox& box, const Sphere& sphere, Array<T*>& members, bool useSphere) const {
+        if (m_root == NONE) {
+            return;
+        }
+        SmallArray<int, 64> stack;
+        stack.push(m_root);
+        while (stack.size() > 0) {
+            const Node& n = m_node[stack.pop()];
+            if (! overlaps(n.bounds, box)) {
+                continue;
+            }
+            if (n.isLeaf()) {
+                const Member& m = m_member[n.member];
+                if (overlaps(m.bounds, box) &&
+                    (! useSphere || m.bounds.intersects(sphere))) {
+                    members.append(const_cast<T*>(&m.value));
+                }
+            } else {
+                stack.push(n.child[0]);
+                stack.push(n.child[1]);
+            }
+        }
+    }
+
+public:
+
+    /**
+     \param margin Distance by which the bounds of each member are grown
+     when it is inserted.  Members that move less than this between calls
+     to update() do not change the tree.  Larger margins make update()
+     cheaper and queries slower.
+     */
+    explicit DynamicAABBTree(float margin = 0.1f) : m_root(NONE), m_freeList(NONE), m_margin(margin) {
+        debugAssertM(margin >= 0.0f, "Negative margin");
+    }
+
+    float margin() const {
+        return m_margin;
+    }
+
+    /** Removes all members and releases the node storage */
+    void clear() {
+        m_node.clear();
+        m_member.clear();
+        m_leaf.clear();
+        m_root = NONE;
+        m_freeList = NONE;
+    }
+
+    int size() const {
+        return m_leaf.size();
+    }
+
+    /** Longest path from the root to a leaf; 0 for a single member and
+        -1 for an empty tree. */
+    int height() const {
+        return (m_root == NONE) ? -1 : m_node[m_root].height;
+    }
+
+    /**
+     Returns true if this object is in the set, otherwise
+     returns false.  O(1) time.
+     */
+    bool contains(const T& value) const {
+        return m_leaf.containsKey(value);
+    }
+
+    /**
+     Inserts an object into the set if it is not already present.
+     O(log n) time.
+     */
+    void insert(const T& value) {
+        if (contains(value)) {
+            return;
+        }
+        const int i = allocateNode();
+        Member& m = m_member.next();
+        m.value = value;
+        BoundsFunc::getBounds(value, m.bounds);
+        m.leaf = i;
+        m_node[i].member = m_member.size() - 1;
+        m_node[i].bounds = fatten(m.bounds, Vector3::zero());
+        insertLeaf(i);
+        m_leaf.set(value, i);
+    }
+
+    /**
+     Removes an object from the set in O(log n) time.  It is an error to
+     remove members that are not present.
+     */
+    void remove(const T& value) {
+        const int* i = m_leaf.getPointer(value);
+        debugAssertM(i != NULL, "Tried to remove an element from a DynamicAABBTree that was not present");
+        if (i == NULL) {
+            return;
+        }
+        const int leaf = *i;
+        const int j = m_node[leaf].member;
+        m_leaf.remove(value);
+        removeLeaf(leaf);
+        freeNode(leaf);
+
+        m_member.fastRemove(j);
+        if (j < m_member.size()) {
+            // Repoint the leaf of the member that was moved into slot j
+            m_node[m_member[j].leaf].member = j;
+        }
+    }
+
+    /**
+     If the element is in the set, replaces the stored copy with value and
+     moves it to match its new bounds; otherwise, inserts it.
+
+     O(1) if the new bounds are still inside the member's fattened bounds,
+     and O(log n) otherwise.
+
+     \param displacement Expected motion of the member before the next
+     update, e.g., velocity times the time step.  When the member leaves its
+     fattened bounds, the new ones are also stretched by this vector so
+     that a fast-moving member does not have to be reinserted on every
+     update.  Bounds that have become much larger than the member needs,
+     e.g., after it stops, are shrunk.
+     */
+    void update(const T& value, const Vector3& displacement = Vector3::zero()) {
+        int* index = m_leaf.getPointer(value);
+        if (index == NULL) {
+            insert(value);
+            return;
+        }
+
+        const int i = *index;
+        const AABox& fatBounds = m_node[i].bounds;
+        Member& m = m_member[m_node[i].member];
+        m.value = value;
+        BoundsFunc::getBounds(value, m.bounds);
+
+        if (fatBounds.contains(m.bounds)) {
+            // Shrink bounds left oversized by an earlier displacement
+            const float neededArea = fatten(m.bounds, displacement).area();
+            if (fatBounds.area() <= 4.0f * neededArea) {
+                return;
+            }
+        }
+
+        moveLeaf(i, displacement);
+    }
+
+    /** If a value that is EqualsFunc to @a value is present, returns a pointer to the
+        version stored in the data structure, otherwise returns NULL.
+     */
+    const T* getPointer(const T& value) const {
+        const int* i = m_leaf.getPointer(value);
+        return (i == NULL) ? NULL : &(m_member[m_node[*i].member].value);
+    }
+
+    /** Returns an array of all members of the set. */
+    void getMembers(Array<T>& members) const {
+        for (int i = 0; i < m_member.size(); ++i) {
+            members.append(m_member[i].value);
+        }
+    }
+
+    /**
+     Discards the interior of the tree and rebuilds it top-down from the
+     current leaves.  Incremental insertion and rotations keep the height
+     logarithmic, but after many members have moved across the world the
+     nodes overlap more than those of a tree built from scratch, which
+     slows queries.  Call this occasionally, e.g., every few seconds or
+     when profiling shows queries slowing down.
+     O(n log n).
+     */
+    void rebuild() {
+        if (m_member.size() < 2) {
+            return;
+        }
+
+        Array<int> leaf;
+        leaf.resize(m_member.size());
+        for (int i = 0; i < m_member.size(); ++i) {
+            leaf[i] = m_member[i].leaf;
+        }
+
+        for (int i = 0; i < m_node.size(); ++i) {
+            if (m_node[i].height > 0) {
+                freeNode(i);
+            }
+        }
+
+        m_root = buildSubtree(leaf.getCArray(), leaf.size());
+        m_node[m_root].parent = NONE;
+    }
+
+    /**
+     Appends all members whose bounds intersect the box.
+     */
+    void getIntersectingMembers(const AABox& box, Array<T*>& members) const {
+        getIntersectingMembers(box, Sphere(Vector3::zero(), 0), members, false);
+    }
+
+    void getIntersectingMembers(const AABox& box, Array<T>& members) const {
+        Array<T*> temp;
+        getIntersectingMembers(box, temp);
+        for (int i = 0; i < temp.size(); ++i) {
+            members.append(*temp[i]);
+        }
+    }
+
+    /**
+      @brief Finds all members whose bounding boxes intersect the sphere.  The actual
+      elements may not intersect the sphere.
+
+      @param members The results are appended to this array.
+     */
+    void getIntersectingMembers(const Sphere& sphere, Array<T*>& members) const {
+        AABox box;
+        sphere.getBounds(box);
+        getIntersectingMembers(box, sphere, members, true);
+    }
+
+    void getIntersectingMembers(const Sphere& sphere, Array<T>& members) const {
+        Array<T*> temp;
+        getIntersectingMembers(sphere, temp);
+        for (int i = 0; i < temp.size(); ++i) {
+            members.append(*temp[i]);
+        }
+    }
+
+    /**
+     Invoke a callback for every member along a ray until the closest
+     intersection is found.  The callback and parameters are the same as
+     for KDTree::intersectRay().  Subtrees are visited nearest first, so
+     that once an intersection is found, farther subtrees are culled.
+     */
+    template<typename RayCallback>
+    void intersectRay(
+        const Ray&      ray,
+        RayCallback&    intersectCallback,
+        float&          distance,
+        bool            intersectCallbackIsFast = false) const {
+
+        float enter;
+        if ((m_root == NONE) || ! rayIntersects(ray, m_node[m_root].bounds, distance, enter)) {
+            return;
+        }
+
+        // Nodes whose bounds the ray entered at the recorded distance
+        SmallArray<int, 64>   stack;
+        SmallArray<float, 64> stackEnter;
+        stack.push(m_root);
+        stackEnter.push(enter);
+
+        while (stack.size() > 0) {
+            const Node& n = m_node[stack.pop()];
+            if (stackEnter.pop() > distance) {
+                // An intersection was found since this node was pushed
+                continue;
+            }
+
+            if (n.isLeaf()) {
+                const Member& m = m_member[n.member];
+                if (intersectCallbackIsFast || rayIntersects(ray, m.bounds, distance, enter)) {
+                    intersectCallback(ray, m.value, distance);
+                }
+                continue;
+            }
+
+            float childEnter[2];
+            bool hit[2];
+            for (int c = 0; c < 2; ++c) {
+                hit[c] = rayIntersects(ray, m_node[n.child[c]].bounds, distance, childEnter[c]);
+            }
+
+            // Push the farther child first so that the nearer one is visited next
+            const int first = (hit[0] && hit[1] && (childEnter[1] < childEnter[0])) ? 1 : 0;
+            for (int k = 1; k >= 0; --k) {
+                const int c = (k == 0) ? first : 1 - first;
+                if (hit[c]) {
+                    stack.push(n.child[c]);
+                    stackEnter.push(childEnter[c]);
+                }
+            }
+        }
+    }
+};
+
+} // namespace G3D
+
+#endif
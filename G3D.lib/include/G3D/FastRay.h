@@ -0,0 +1,271 @@
+/**
+  \file G3D/FastRay.h
+
+  Ray with only the data needed for slab and triangle tests.
+
+  \created 2026-10-18
+  \edited  2026-10-18
+ */
+
+#ifndef G3D_FastRay_h
+#define G3D_FastRay_h
+
+#include "G3D/platform.h"
+#include "G3D/g3dmath.h"
+#include "G3D/Vector3.h"
+#include "G3D/Triangle.h"
+#include "G3D/AABox.h"
+#include "G3D/Ray.h"
+
+namespace G3D {
+
+/**
+ \brief A ray segment that is cheap to construct.
+
+ G3D::Ray precomputes the slopes and classification used by
+ Intersect::rayAABox() every time it is constructed, which costs a
+ dozen products and a chain of branches and makes each Ray more than
+ 80 bytes.  FastRay stores only the origin, the unit direction, its
+ inverse, and the interval of distances [minDistance(),
+ maxDistance()] along the ray that count as hits (44 bytes), so it is
+ the better choice when many rays are each tested against only a few
+ objects, such as batched line-of-sight checks.
+
+ The box test is a slab test on the inverse direction, and the
+ triangle test is the same one-sided Moller-Trumbore test as
+ Ray::intersectionTime().  Both report only hits within the distance
+ interval.  The box test includes both ends of the interval; the
+ triangle test, like TriangleBlockN, excludes maxDistance(), so that a
+ closest-hit search that shortens the interval to each hit finds only
+ strictly closer hits.  TriangleBlockN and AABoxBlockN accept FastRay
+ directly.
+
+ <pre>
+   // Line of sight between two eyes
+   const FastRay ray = FastRay::fromSegment(eyeA, eyeB);
+   bool visible = true;
+   for (int i = 0; (i < blockers.size()) && visible; ++i) {
+       visible = ! ray.intersects(blockers[i]);
+   }
+ </pre>
+
+ \sa Ray, TriangleBlockN, AABoxBlockN
+ */
+class FastRay {
+private:
+
+    Point3          m_origin;
+
+    /** Unit length */
+    Vector3         m_direction;
+
+    /** 1.0 / direction.  May have inf() components */
+    Vector3         m_invDirection;
+
+    float           m_minDistance;
+
+    float           m_maxDistance;
+
+public:
+
+    /** A ray from the origin along the X axis */
+    FastRay() : m_origin(Point3::zero()), m_direction(Vector3::unitX()),
+        m_invDirection(1.0f, finf(), finf()), m_minDistance(0.0f), m_maxDistance(finf()) {}
+
+    /** \param direction Assumed to have unit length */
+    FastRay(const Point3& origin, const Vector3& direction,
+            float minDistance = 0.0f, float maxDistance = finf()) :
+        m_origin(origin), m_direction(direction), m_invDirection(Vector3::one() / direction),
+        m_minDistance(minDistance), m_maxDistance(maxDistance) {
+        debugAssert(direction.isUnit());
+    }
+
+    /** The whole of \a ray, from its origin to infinity */
+    explicit FastRay(const Ray& ray) :
+        m_origin(ray.origin()), m_direction(ray.direction()), m_invDirection(ray.invDirection()),
+        m_minDistance(0.0f), m_maxDistance(finf()) {}
+
+    /** The segment from \a start to \a end, which must be distinct */
+    static FastRay fromSegment(const Point3& start, const Point3& end) {
+        const Vector3 delta = end - start;
+        const float length = delta.length();
+        debugAssertM(length > 0.0f, "FastRay::fromSegment requires distinct points");
+        return FastRay(start, delta / length, 0.0f, length);
+    }
+
+    /** The G3D::Ray with the same origin and direction.  The distance
+        interval is not represented by Ray. */
+    Ray toRay() const {
+        return Ray(m_origin, m_direction);
+    }
+
+    const Point3& origin() const {
+        return m_origin;
+    }
+
+    /** Unit direction vector */
+    const Vector3& direction() const {
+        return m_direction;
+    }
+
+    /** Component-wise inverse of direction vector.  May have inf() components */
+    const Vector3& invDirection() const {
+        return m_invDirection;
+    }
+
+    /** Hits closer than this are ignored */
+    float minDistance() const {
+        return m_minDistance;
+    }
+
+    /** Hits farther than this are ignored */
+    float maxDistance() const {
+        return m_maxDistance;
+    }
+
+    void setMinDistance(float d) {
+        m_minDistance = d;
+    }
+
+    /** Typically called with the distance to the closest hit found so far,
+        so that later tests only look for closer ones */
+    void setMaxDistance(float d) {
+        m_maxDistance = d;
+    }
+
+    /** The point at distance \a t along the ray */
+    Point3 point(float t) const {
+        return m_origin + m_direction * t;
+    }
+
+    /**
+     Distances at which the ray enters and leaves \a box, clipped to the
+     distance interval.  Returns false if they do not overlap.  A ray that
+     lies exactly in the plane of a face, parallel to it, hits the box.
+     */
+    bool intersect(const AABox& box, float& enter, float& exit) const {
+        enter = m_minDistance;
+        exit  = m_maxDistance;
+        for (int a = 0; a < 3; ++a) {
+            const float t0 = (box.low()[a] - m_origin[a]) * m_invDirection[a];
+            const float t1 = (box.high()[a] - m_origin[a]) * m_invDirection[a];
+
+            if ((t0 != t0) || (t1 != t1)) {
+                // NaN (0 * inf): the ray is parallel to this slab and lies
+                // in the plane of one of its faces, so the slab does not
+                // clip the interval (as in AABoxBlockN)
+                continue;
+            }
+
+            const float tNear = (t0 < t1) ? t0 : t1;
+            const float tFar  = (t0 < t1) ? t1 : t0;
+            if (tNear > enter) {
+                enter = tNear;
+            }
+            if (tFar < exit) {
+                exit = tFar;
+            }
+        }
+        return enter <= exit;
+    }
+
+    bool intersects(const AABox& box) const {
+        float enter, exit;
+        return intersect(box, enter, exit);
+    }
+
+    /** Distance at which the ray enters \a box, minDistance() if it starts
+        inside it, or finf() if there is no hit within the interval. */
+    float intersectionTime(const AABox& box) const {
+        float enter, exit;
+        return intersect(box, enter, exit) ? enter : finf();
+    }
+
+    /**
+     One-sided triangle test with precomputed edges; see
+     Ray::intersectionTime().  Returns finf() if there is no hit in
+     [minDistance(), maxDistance()).
+
+     \param w0, w1, w2 Set to the weights of vertices 0, 1, and 2 at
+     the hit point.
+     */
+    float intersectionTime(
+        const Point3&  vert0,
+        const Point3&  vert1,
+        const Point3&  vert2,
+        const Vector3& edge01,
+        const Vector3& edge02,
+        float&         w0,
+        float&         w1,
+        float&         w2) const {
+
+        (void)vert1;
+        (void)vert2;
+
+        static const float EPSILON = 0.000001f;
+
+        // If the determinant is near zero, the ray lies in the plane of the
+        // triangle; if it is negative, the ray hits the back face
+        const Vector3 p = m_direction.cross(edge02);
+        const float det = edge01.dot(p);
+        if (det < EPSILON) {
+            return finf();
+        }
+
+        const Vector3 s = m_origin - vert0;
+        const float u = s.dot(p);
+        if ((u < 0.0f) || (u > det)) {
+            return finf();
+        }
+
+        const Vector3 q = s.cross(edge01);
+        const float v = m_direction.dot(q);
+        if ((v < 0.0f) || (u + v > det)) {
+            return finf();
+        }
+
+        const float invDet = 1.0f / det;
+        const float t = edge02.dot(q) * invDet;
+        if ((t < m_minDistance) || (t >= m_maxDistance)) {
+            return finf();
+        }
+
+        w1 = u * invDet;
+        w2 = v * invDet;
+        w0 = 1.0f - w1 - w2;
+        return t;
+    }
+
+    float intersectionTime(
+        const Point3&  vert0,
+        const Point3&  vert1,
+        const Point3&  vert2,
+        const Vector3& edge01,
+        const Vector3& edge02) const {
+        float w0, w1, w2;
+        return intersectionTime(vert0, vert1, vert2, edge01, edge02, w0, w1, w2);
+    }
+
+    float intersectionTime(const Point3& vert0, const Point3& vert1, const Point3& vert2,
+                           float& w0, float& w1, float& w2) const {
+        return intersectionTime(vert0, vert1, vert2, vert1 - vert0, vert2 - vert0, w0, w1, w2);
+    }
+
+    float intersectionTime(const Point3& vert0, const Point3& vert1, const Point3& vert2) const {
+        return intersectionTime(vert0, vert1, vert2, vert1 - vert0, vert2 - vert0);
+    }
+
+    float intersectionTime(const Triangle& triangle, float& w0, float& w1, float& w2) const {
+        return intersectionTime(triangle.vertex(0), triangle.vertex(1), triangle.vertex(2),
+                                triangle.edge01(), triangle.edge02(), w0, w1, w2);
+    }
+
+    float intersectionTime(const Triangle& triangle) const {
+        return intersectionTime(triangle.vertex(0), triangle.vertex(1), triangle.vertex(2),
+                                triangle.edge01(), triangle.edge02());
+    }
+};
+
+} // namespace G3D
+
+#endif
@@ -499,6 +499,26 @@ public:
         mutex.unlock();
     }
 
+    /** \brief Uncompressed size in bytes of \a entry inside \a zipfile, or -1 if
+        the zipfile does not contain it.  Entry names use '/' and are not case sensitive.
+
+        Opened zipfiles and a hashed index of their contents are cached until clearCache()
+        or until the zipfile changes on disk, so repeated queries do not reparse the
+        central directory.
+     */
+    static int64 zipEntrySize(const std::string& zipfile, const std::string& entry);
+
+    /** \brief Decompresses \a entry from \a zipfile into \a dst, which must hold
+        \a numBytes = zipEntrySize() bytes.  Returns false if the entry could not be read in full.
+
+        May be called from multiple threads at once.  Reads of different entries (or of the
+        same entry) from one zipfile proceed concurrently on separate zipfile handles.
+    */
+    static bool readZipEntry(const std::string& zipfile, const std::string& entry, void* dst, int64 numBytes);
+
+    /** Appends the names of all entries in \a zipfile, as stored, to \a names. */
+    static void getZipEntries(const std::string& zipfile, Array<std::string>& names);
+
     /** Adds \a filename to usedFiles().  This is called automatically by open() and all 
       G3D routines that open files. */
     static void markFileUsed(const std::string& filename);
@@ -0,0 +1,725 @@
+/**
+  \file G3D/FlatTable.h
+
+  Open-addressing hash table with inline storage.
+
+  \created 2026-10-18
+  \edited  2026-10-18
+ */
+
+#ifndef G3D_FlatTable_h
+#define G3D_FlatTable_h
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+#include "G3D/platform.h"
+#include "G3D/Array.h"
+#include "G3D/debug.h"
+#include "G3D/System.h"
+#include "G3D/g3dmath.h"
+#include "G3D/EqualsTrait.h"
+#include "G3D/HashTrait.h"
+#include "G3D/MemoryManager.h"
+
+#ifdef G3D_SSE2
+#   include <emmintrin.h>
+#endif
+
+namespace G3D {
+
+namespace _internal {
+
+/** Control-byte groups for G3D::FlatTable.  A control byte is either
+    FlatTable_Group::EMPTY or the top 7 bits of the slot's mixed hash (high
+    bit clear). */
+class FlatTable_Group {
+public:
+    enum {
+        /** Number of control bytes examined per probe step */
+        WIDTH = 16,
+        EMPTY = 0x80
+    };
+
+    /** Bit i is set if ctrl[i] == tag, for i in [0, WIDTH) */
+    static uint32 match(const uint8* ctrl, uint8 tag) {
+#       ifdef G3D_SSE2
+            const __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+            return uint32(_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(char(tag)))));
+#       else
+            uint32 m = 0;
+            for (int i = 0; i < WIDTH; ++i) {
+                m |= uint32(ctrl[i] == tag) << i;
+            }
+            return m;
+#       endif
+    }
+
+    /** Bit i is set if ctrl[i] is EMPTY */
+    static uint32 matchEmpty(const uint8* ctrl) {
+#       ifdef G3D_SSE2
+            // EMPTY is the only control byte with the high bit set
+            return uint32(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))));
+#       else
+            uint32 m = 0;
+            for (int i = 0; i < WIDTH; ++i) {
+                m |= uint32(ctrl[i] >> 7) << i;
+            }
+            return m;
+#       endif
+    }
+
+    /** Index of the lowest set bit of a nonzero mask */
+    static int lowestBit(uint32 m) {
+        debugAssert(m != 0);
+#       if defined(__GNUC__)
+            return __builtin_ctz(m);
+#       else
+            int i = 0;
+            while ((m & 1) == 0) {
+                m >>= 1;
+                ++i;
+            }
+            return i;
+#       endif
+    }
+};
+
+} // namespace _internal
+
+
+/**
+ \brief An unordered map from keys to values that stores entries
+ directly in one flat array.
+
+ FlatTable is a drop-in alternative to G3D::Table for hot lookup
+ paths.  It uses the same HashTrait and EqualsTrait, the same Entry
+ and Iterator interface and the same Allocator policies.  Entries live
+ in a single power-of-two array (linear probing) alongside a parallel
+ array of one-byte control tags, so a lookup touches one or two cache
+ lines instead of walking a linked bucket list.  Sixteen tags are
+ compared at once with SSE2 when G3D_SSE2 is defined.
+
+ Removal shifts later entries of the probe run backward, so there
+ are no tombstones and lookups never slow down after many removals.
+
+ Differences from Table:
+ <ul>
+ <li> Pointers and references to keys and values (including those
+      returned by getCreate, getPointer and the Iterator) are
+      invalidated by <i>any</i> insertion or removal, not only by
+      rehashing.
+ <li> Key and Value are moved when the table grows, so they must be
+      move- or copy-constructible.
+ <li> The hash code is recomputed during removal and growth rather than
+      cached per entry; use Table when hashing a key is expensive.
+ </ul>
+
+ The maximum load factor is 7/8.
+
+ \sa G3D::Table, G3D::FastPODTable
+ */
+template<class Key, class Value, class HashFunc = HashTrait<Key>, class EqualsFunc = EqualsTrait<Key>, class Allocator = SystemAllocator>
+class FlatTable : private Allocator {
+public:
+
+    /** The pairs returned by iterator. */
+    class Entry {
+    public:
+        Key    key;
+        Value  value;
+        Entry() {}
+        Entry(const Key& k) : key(k), value() {}
+        Entry(const Key& k, const Value& v) : key(k), value(v) {}
+        Entry(Entry&& e) : key(std::move(e.key)), value(std::move(e.value)) {}
+        Entry(const Entry& e) : key(e.key), value(e.value) {}
+        Entry& operator=(Entry&& e) { key = std::move(e.key); value = std::move(e.value); return *this; }
+        Entry& operator=(const Entry& e) { key = e.key; value = e.value; return *this; }
+        bool operator==(const Entry &peer) const { return (key == peer.key && value == peer.value); }
+        bool operator!=(const Entry &peer) const { return !operator==(peer); }
+    };
+
+private:
+
+    typedef FlatTable<Key, Value, HashFunc, EqualsFunc, Allocator> ThisType;
+    typedef _internal::FlatTable_Group Group;
+
+    /** Array of m_capacity entries, constructed only where the control byte is full */
+    Entry*          m_slot;
+
+    /** m_capacity + Group::WIDTH - 1 bytes; the tail mirrors the first
+        Group::WIDTH - 1 bytes so that a group load never wraps. Shares
+        the allocation with m_slot. */
+    uint8*          m_ctrl;
+
+    /** Zero or a power of two no smaller than Group::WIDTH */
+    size_t          m_capacity;
+
+    size_t          m_size;
+
+    Allocator& allocator() {
+        return *this;
+    }
+
+    const Allocator& allocator() const {
+        return *this;
+    }
+
+    static bool isFull(uint8 c) {
+        return (c & Group::EMPTY) == 0;
+    }
+
+    /** Scrambles a user hash code so that both the low bits (slot) and
+        the high bits (tag) depend on all input bits. */
+    static uint64 mix(const Key& key) {
+        uint64 h = uint64(HashFunc::hashCode(key)) * 0x9E3779B97F4A7C15ULL;
+        return h ^ (h >> 32);
+    }
+
+    static uint8 tagOf(uint64 h) {
+        return uint8(h >> 57);
+    }
+
+    size_t homeOf(uint64 h) const {
+        return size_t(h) & (m_capacity - 1);
+    }
+
+    void setCtrl(size_t i, uint8 c) {
+        m_ctrl[i] = c;
+        if (i < Group::WIDTH - 1) {
+            m_ctrl[m_capacity + i] = c;
+        }
+    }
+
+    /** Returns the slot holding key or -1 */
+    ptrdiff_t find(const Key& key) const {
+        if (m_size == 0) {
+            return -1;
+        }
+
+        const uint64 h    = mix(key);
+        const uint8  tag  = tagOf(h);
+        const size_t mask = m_capacity - 1;
+        size_t       i    = homeOf(h);
+
+        // An equal key lies in the contiguous run beginning at its home
+        // slot, so the search ends at the first group containing an
+        // EMPTY byte.
+        while (true) {
+            const uint8* g = m_ctrl + i;
+            for (uint32 m = Group::match(g, tag); m != 0; m &= m - 1) {
+                const size_t s = (i + Group::lowestBit(m)) & mask;
+                if (EqualsFunc::equals(m_slot[s].key, key)) {
+                    return ptrdiff_t(s);
+                }
+            }
+            if (Group::matchEmpty(g) != 0) {
+                return -1;
+            }
+            i = (i + Group::WIDTH) & mask;
+        }
+    }
+
+    /** Returns the first EMPTY slot in the probe run for hash h.  The table must not be full. */
+    size_t findEmpty(uint64 h) const {
+        const size_t mask = m_capacity - 1;
+        size_t       i    = homeOf(h);
+        while (true) {
+            const uint32 m = Group::matchEmpty(m_ctrl + i);
+            if (m != 0) {
+                return (i + Group::lowestBit(m)) & mask;
+            }
+            i = (i + Group::WIDTH) & mask;
+        }
+    }
+
+    /** Allocates empty storage for newCapacity entries and moves all entries into it. */
+    void rehash(size_t newCapacity) {
+        debugAssert(isPow2(newCapacity) && (newCapacity >= size_t(Group::WIDTH)));
+        debugAssert(newCapacity - newCapacity / 8 >= m_size);
+
+        Entry*       oldSlot     = m_slot;
+        const uint8* oldCtrl     = m_ctrl;
+        const size_t oldCapacity = m_capacity;
+
+        void* p = allocator().alloc(newCapacity * sizeof(Entry) + newCapacity + Group::WIDTH - 1);
+        alwaysAssertM(p != NULL, "Out of memory in FlatTable");
+        m_slot     = static_cast<Entry*>(p);
+        m_ctrl     = reinterpret_cast<uint8*>(m_slot + newCapacity);
+        m_capacity = newCapacity;
+        System::memset(m_ctrl, Group::EMPTY, newCapacity + Group::WIDTH - 1);
+
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (isFull(oldCtrl[i])) {
+                const uint64 h = mix(oldSlot[i].key);
+                const size_t s = findEmpty(h);
+                new (m_slot + s) Entry(std::move(oldSlot[i]));
+                setCtrl(s, tagOf(h));
+                oldSlot[i].~Entry();
+            }
+        }
+
+        if (oldSlot != NULL) {
+            allocator().free(oldSlot);
+        }
+    }
+
+    /** Smallest legal capacity that holds n entries without exceeding the load factor */
+    static size_t capacityFor(size_t n) {
+        size_t c = Group::WIDTH;
+        while (c - c / 8 < n) {
+            c *= 2;
+        }
+        return c;
+    }
+
+    /** Destroys all entries and frees the storage */
+    void freeMemory() {
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (isFull(m_ctrl[i])) {
+                m_slot[i].~Entry();
+            }
+        }
+        if (m_slot != NULL) {
+            allocator().free(m_slot);
+        }
+        m_slot     = NULL;
+        m_ctrl     = NULL;
+        m_capacity = 0;
+        m_size     = 0;
+    }
+
+    void copyFrom(const ThisType& h) {
+        if (h.m_size == 0) {
+            return;
+        }
+        rehash(h.m_capacity);
+        for (size_t i = 0; i < h.m_capacity; ++i) {
+            if (isFull(h.m_ctrl[i])) {
+                // Same capacity and hash, so every entry keeps its slot
+                new (m_slot + i) Entry(h.m_slot[i]);
+                m_ctrl[i] = h.m_ctrl[i];
+            }
+        }
+        System::memcpy(m_ctrl + m_capacity, m_ctrl, Group::WIDTH - 1);
+        m_size = h.m_size;
+    }
+
+    /** Removes the entry in slot i by shifting later members of its
+        probe run backward (no tombstones). */
+    void eraseSlot(size_t i) {
+        const size_t mask = m_capacity - 1;
+        m_slot[i].~Entry();
+
+        size_t j = i;
+        while (true) {
+            j = (j + 1) & mask;
+            if (! isFull(m_ctrl[j])) {
+                break;
+            }
+
+            // Move j into the hole at i unless j's home slot lies
+            // cyclically in (i, j], in which case j is already as close
+            // to home as it can be.
+            const uint64 h    = mix(m_slot[j].key);
+            const size_t home = homeOf(h);
+            const bool   stay = (i <= j) ? ((i < home) && (home <= j)) : ((i < home) || (home <= j));
+            if (! stay) {
+                new (m_slot + i) Entry(std::move(m_slot[j]));
+                setCtrl(i, m_ctrl[j]);
+                m_slot[j].~Entry();
+                i = j;
+            }
+        }
+
+        setCtrl(i, Group::EMPTY);
+        --m_size;
+    }
+
+public:
+
+    /** Creates an empty table.  No memory is allocated until the first insertion. */
+    FlatTable() : m_slot(NULL), m_ctrl(NULL), m_capacity(0), m_size(0) {}
+
+    explicit FlatTable(const Allocator& a) : Allocator(a), m_slot(NULL), m_ctrl(NULL), m_capacity(0), m_size(0) {}
+
+    FlatTable(const ThisType& h) : Allocator(h.allocator()), m_slot(NULL), m_ctrl(NULL), m_capacity(0), m_size(0) {
+        copyFrom(h);
+    }
+
+    FlatTable(ThisType&& h) : Allocator(h.allocator()), m_slot(h.m_slot), m_ctrl(h.m_ctrl), m_capacity(h.m_capacity), m_size(h.m_size) {
+        h.m_slot     = NULL;
+        h.m_ctrl     = NULL;
+        h.m_capacity = 0;
+        h.m_size     = 0;
+    }
+
+    FlatTable& operator=(const ThisType& h) {
+        if (this != &h) {
+            freeMemory();
+            allocator() = h.allocator();
+            copyFrom(h);
+        }
+        return *this;
+    }
+
+    FlatTable& operator=(ThisType&& h) {
+        if (this != &h) {
+            freeMemory();
+            allocator()  = h.allocator();
+            m_slot       = h.m_slot;
+            m_ctrl       = h.m_ctrl;
+            m_capacity   = h.m_capacity;
+            m_size       = h.m_size;
+            h.m_slot     = NULL;
+            h.m_ctrl     = NULL;
+            h.m_capacity = 0;
+            h.m_size     = 0;
+        }
+        return *this;
+    }
+
+    virtual ~FlatTable() {
+        freeMemory();
+    }
+
+    /** Only supported when Allocator is MemoryManagerAllocator.  Clears the table. */
+    void clearAndSetMemoryManager(const MemoryManager::Ref& m) {
+        clear();
+        allocator().setMemoryManager(m);
+    }
+
+    /** Makes room for n entries so that no rehash occurs until the size exceeds n. */
+    void setSizeHint(size_t n) {
+        const size_t c = capacityFor(n);
+        if (c > m_capacity) {
+            rehash(c);
+        }
+    }
+
+    /** Fraction of slots in use */
+    double debugGetLoad() const {
+        return (m_capacity == 0) ? 0.0 : double(m_size) / double(m_capacity);
+    }
+
+    size_t debugGetNumSlots() const {
+        return m_capacity;
+    }
+
+    /** Length of the longest probe from an entry's home slot to the slot that holds it */
+    size_t debugGetLongestProbe() const {
+        size_t longest = 0;
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (isFull(m_ctrl[i])) {
+                const size_t d = (i - homeOf(mix(m_slot[i].key))) & (m_capacity - 1);
+                longest = max(longest, d);
+            }
+        }
+        return longest;
+    }
+
+    /**
+     C++ STL style iterator variable.  Call begin() to get the first
+     iterator, pre-increment (++i) the iterator to get to the next
+     value.  Use dereference (*i) to access the element.  Do not modify
+     the table while iterating.
+     */
+    class Iterator {
+    private:
+        friend class FlatTable<Key, Value, HashFunc, EqualsFunc, Allocator>;
+
+        size_t          index;
+        size_t          m_capacity;
+        Entry*          m_slot;
+        const uint8*    m_ctrl;
+
+        /** Creates the end iterator. */
+        Iterator() : index(0), m_capacity(0), m_slot(NULL), m_ctrl(NULL) {}
+
+        Iterator(size_t capacity, Entry* slot, const uint8* ctrl) :
+            index(0), m_capacity(capacity), m_slot(slot), m_ctrl(ctrl) {
+            findNext();
+        }
+
+        /** Advances index to the next full slot, or to m_capacity */
+        void findNext() {
+            while ((index < m_capacity) && ! isFull(m_ctrl[index])) {
+                ++index;
+            }
+        }
+
+        bool isDone() const {
+            return index >= m_capacity;
+        }
+
+    public:
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+        bool operator==(const Iterator& other) const {
+            if (isDone() || other.isDone()) {
+                return isDone() == other.isDone();
+            } else {
+                return (m_slot == other.m_slot) && (index == other.index);
+            }
+        }
+
+        /** Pre increment. */
+        Iterator& operator++() {
+            debugAssert(! isDone());
+            ++index;
+            findNext();
+            return *this;
+        }
+
+        /** Post increment (slower than preincrement). */
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++(*this);
+            return old;
+        }
+
+        const Entry& operator*() const {
+            return m_slot[index];
+        }
+
+        const Value& value() const {
+            return m_slot[index].value;
+        }
+
+        const Key& key() const {
+            return m_slot[index].key;
+        }
+
+        Entry* operator->() const {
+            debugAssert(! isDone());
+            return m_slot + index;
+        }
+
+        operator Entry*() const {
+            debugAssert(! isDone());
+            return m_slot + index;
+        }
+
+        bool isValid() const {
+            return ! isDone();
+        }
+
+        /** @deprecated  Use isValid */
+        bool hasMore() const {
+            return ! isDone();
+        }
+    };
+
+    /**
+     C++ STL style iterator method.  Returns the first Entry, which
+     contains a key and value.  Use preincrement (++entry) to get to
+     the next element.  Do not modify the table while iterating.
+     */
+    Iterator begin() const {
+        return Iterator(m_capacity, m_slot, m_ctrl);
+    }
+
+    /** C++ STL style iterator method.  Returns one after the last iterator element. */
+    const Iterator end() const {
+        return Iterator();
+    }
+
+    /** Removes all elements. Guaranteed to free all memory associated with the table. */
+    void clear() {
+        freeMemory();
+    }
+
+    /** Returns the number of keys. */
+    size_t size() const {
+        return m_size;
+    }
+
+    /**
+     Returns the Entry for key, inserting a default-constructed value if
+     key is not present.  The reference is invalidated by the next
+     insertion or removal.
+     */
+    Entry& getCreateEntry(const Key& key, bool& created) {
+        const ptrdiff_t f = find(key);
+        if (f >= 0) {
+            created = false;
+            return m_slot[f];
+        }
+
+        if (m_size + 1 > m_capacity - m_capacity / 8) {
+            rehash(capacityFor(m_size + 1));
+        }
+
+        const uint64 h = mix(key);
+        const size_t s = findEmpty(h);
+        new (m_slot + s) Entry(key);
+        setCtrl(s, tagOf(h));
+        ++m_size;
+        created = true;
+        return m_slot[s];
+    }
+
+    Entry& getCreateEntry(const Key& key) {
+        bool ignore;
+        return getCreateEntry(key, ignore);
+    }
+
+    /** Returns the current value that key maps to, creating it if necessary. */
+    Value& getCreate(const Key& key) {
+        return getCreateEntry(key).value;
+    }
+
+    /** \param created Set to true if the entry was created by this method. */
+    Value& getCreate(const Key& key, bool& created) {
+        return getCreateEntry(key, created).value;
+    }
+
+    /** Inserting key into a table is O(1), but may cause a potentially slow rehashing. */
+    void set(const Key& key, const Value& value) {
+        getCreateEntry(key).value = value;
+    }
+
+    /** If @a key is present, sets @a removedKey and @a removedValue to the
+        entry being removed and returns true.  Otherwise returns false. */
+    bool getRemove(const Key& key, Key& removedKey, Value& removedValue) {
+        const ptrdiff_t f = find(key);
+        if (f < 0) {
+            return false;
+        }
+        removedKey   = std::move(m_slot[f].key);
+        removedValue = std::move(m_slot[f].value);
+        eraseSlot(size_t(f));
+        return true;
+    }
+
+    /**
+     Removes an element from the table if it is present.
+     @return true if the element was found and removed, otherwise false
+     */
+    bool remove(const Key& key) {
+        const ptrdiff_t f = find(key);
+        if (f < 0) {
+            return false;
+        }
+        eraseSlot(size_t(f));
+        return true;
+    }
+
+    /** Returns a pointer to the stored value for key, or NULL.  The
+        pointer is invalidated by the next insertion or removal. */
+    Value* getPointer(const Key& key) const {
+        const ptrdiff_t f = find(key);
+        return (f < 0) ? NULL : &(m_slot[f].value);
+    }
+
+    /** If a value that is EqualsFunc to @a key is present, returns a pointer to the
+        version stored in the data structure, otherwise returns NULL. */
+    const Key* getKeyPointer(const Key& key) const {
+        const ptrdiff_t f = find(key);
+        return (f < 0) ? NULL : &(m_slot[f].key);
+    }
+
+    /** Returns the value associated with key.  @deprecated Use get(key, val) or getPointer(key) */
+    Value& get(const Key& key) const {
+        Value* p = getPointer(key);
+        alwaysAssertM(p != NULL, "Key not found");
+        return *p;
+    }
+
+    /** If the key is present in the table, val is set to the associated value and returns true.
+        If the key is not present, returns false. */
+    bool get(const Key& key, Value& val) const {
+        const Value* p = getPointer(key);
+        if (p == NULL) {
+            return false;
+        }
+        val = *p;
+        return true;
+    }
+
+    /** Returns true if key is in the table. */
+    bool containsKey(const Key& key) const {
+        return find(key) >= 0;
+    }
+
+    /** Short syntax for get. */
+    Value& operator[](const Key& key) const {
+        return get(key);
+    }
+
+    /** Returns an array of all of the keys in the table. */
+    Array<Key> getKeys() const {
+        Array<Key> keyArray;
+        getKeys(keyArray);
+        return keyArray;
+    }
+
+    void getKeys(Array<Key>& keyArray) const {
+        keyArray.resize(0, DONT_SHRINK_UNDERLYING_ARRAY);
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (isFull(m_ctrl[i])) {
+                keyArray.append(m_slot[i].key);
+            }
+        }
+    }
+
+    /** Will contain duplicate values if they exist in the table.  Parallel to getKeys() if the table has not been modified. */
+    void getValues(Array<Value>& valueArray) const {
+        valueArray.resize(0, DONT_SHRINK_UNDERLYING_ARRAY);
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (isFull(m_ctrl[i])) {
+                valueArray.append(m_slot[i].value);
+            }
+        }
+    }
+
+    /** Calls delete on all of the keys and then clears the table. */
+    void deleteKeys() {
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (isFull(m_ctrl[i])) {
+                delete m_slot[i].key;
+                m_slot[i].key = NULL;
+            }
+        }
+        clear();
+    }
+
+    /**
+     Calls delete on all of the values.  This is unsafe--do not call
+     unless you know that each value appears at most once.
+
+     Does not clear the table, so you are left with a table of NULL pointers.
+     */
+    void deleteValues() {
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (isFull(m_ctrl[i])) {
+                delete m_slot[i].value;
+                m_slot[i].value = NULL;
+            }
+        }
+    }
+
+    bool operator==(const ThisType& other) const {
+        if (size() != other.size()) {
+            return false;
+        }
+        for (Iterator it = begin(); it.isValid(); ++it) {
+            const Value* v = other.getPointer(it->key);
+            if ((v == NULL) || (*v != it->value)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator!=(const ThisType& other) const {
+        return ! (*this == other);
+    }
+};
+
+} // namespace G3D
+
+#endif
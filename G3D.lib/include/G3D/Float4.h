@@ -0,0 +1,239 @@
+/**
+  \file G3D/Float4.h
+
+  Four-wide float SIMD vector.
+
+  \created 2026-10-18
+  \edited  2026-10-18
+ */
+
+#ifndef G3D_Float4_h
+#define G3D_Float4_h
+
+#include <cstring>
+
+#include "G3D/platform.h"
+#include "G3D/g3dmath.h"
+#include "G3D/debugAssert.h"
+
+#ifdef G3D_SSE2
+#   include <emmintrin.h>
+#endif
+
+namespace G3D {
+
+/**
+ \brief Four floats that are operated on in parallel.
+
+ Uses SSE registers when G3D_SSE2 is defined and plain floats
+ otherwise, so kernels written with Float4 are portable.  Comparison
+ operators return a lane mask (all bits set where true) for use with
+ select(), the bitwise operators and movemask().
+
+ min() and max() follow SSE semantics: if either lane is NaN, the lane
+ from the second argument is returned.
+
+ \sa Float8
+ */
+class Float4 {
+public:
+    enum {SIZE = 4};
+
+#ifdef G3D_SSE2
+    __m128              v;
+
+    Float4() {}
+
+    Float4(__m128 x) : v(x) {}
+
+    /** Broadcasts s to all lanes */
+    explicit Float4(float s) : v(_mm_set1_ps(s)) {}
+
+    Float4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+
+    /** Unaligned load of SIZE floats */
+    static Float4 load(const float* p) {
+        return Float4(_mm_loadu_ps(p));
+    }
+
+    /** Unaligned store of SIZE floats */
+    void store(float* p) const {
+        _mm_storeu_ps(p, v);
+    }
+
+    static Float4 zero() {
+        return Float4(_mm_setzero_ps());
+    }
+
+    Float4 operator+(const Float4& b) const { return _mm_add_ps(v, b.v); }
+    Float4 operator-(const Float4& b) const { return _mm_sub_ps(v, b.v); }
+    Float4 operator*(const Float4& b) const { return _mm_mul_ps(v, b.v); }
+    Float4 operator/(const Float4& b) const { return _mm_div_ps(v, b.v); }
+    Float4 operator-() const { return _mm_sub_ps(_mm_setzero_ps(), v); }
+
+    Float4 operator< (const Float4& b) const { return _mm_cmplt_ps(v, b.v); }
+    Float4 operator<=(const Float4& b) const { return _mm_cmple_ps(v, b.v); }
+    Float4 operator> (const Float4& b) const { return _mm_cmpgt_ps(v, b.v); }
+    Float4 operator>=(const Float4& b) const { return _mm_cmpge_ps(v, b.v); }
+    Float4 operator==(const Float4& b) const { return _mm_cmpeq_ps(v, b.v); }
+    Float4 operator!=(const Float4& b) const { return _mm_cmpneq_ps(v, b.v); }
+
+    Float4 operator&(const Float4& b) const { return _mm_and_ps(v, b.v); }
+    Float4 operator|(const Float4& b) const { return _mm_or_ps(v, b.v); }
+    Float4 operator^(const Float4& b) const { return _mm_xor_ps(v, b.v); }
+
+    /** (~this) & b */
+    Float4 andNot(const Float4& b) const { return _mm_andnot_ps(v, b.v); }
+
+    /** Bit i is the sign (high) bit of lane i */
+    int movemask() const { return _mm_movemask_ps(v); }
+
+    float operator[](int i) const {
+        debugAssert(i >= 0 && i < SIZE);
+        float f[SIZE];
+        store(f);
+        return f[i];
+    }
+
+    Float4 sqrt() const { return _mm_sqrt_ps(v); }
+
+    /** Approximate 1 / sqrt(x), about 12 bits of precision */
+    Float4 rsqrt() const { return _mm_rsqrt_ps(v); }
+
+    Float4 abs() const { return _mm_andnot_ps(_mm_set1_ps(-0.0f), v); }
+
+    friend Float4 min(const Float4& a, const Float4& b) { return _mm_min_ps(a.v, b.v); }
+    friend Float4 max(const Float4& a, const Float4& b) { return _mm_max_ps(a.v, b.v); }
+
+    /** Returns the lanes of a where mask is set and the lanes of b elsewhere */
+    friend Float4 select(const Float4& mask, const Float4& a, const Float4& b) {
+        return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+    }
+
+#else
+    float               v[SIZE];
+
+private:
+
+    static float fromBits(uint32 u) {
+        float f;
+        std::memcpy(&f, &u, sizeof(f));
+        return f;
+    }
+
+    static uint32 toBits(float f) {
+        uint32 u;
+        std::memcpy(&u, &f, sizeof(u));
+        return u;
+    }
+
+    static float mask(bool b) {
+        return fromBits(b ? 0xFFFFFFFF : 0);
+    }
+
+public:
+
+    Float4() {}
+
+    explicit Float4(float s) {
+        v[0] = v[1] = v[2] = v[3] = s;
+    }
+
+    Float4(float a, float b, float c, float d) {
+        v[0] = a; v[1] = b; v[2] = c; v[3] = d;
+    }
+
+    static Float4 load(const float* p) {
+        return Float4(p[0], p[1], p[2], p[3]);
+    }
+
+    void store(float* p) const {
+        for (int i = 0; i < SIZE; ++i) { p[i] = v[i]; }
+    }
+
+    static Float4 zero() {
+        return Float4(0.0f);
+    }
+
+#   define G3D_FLOAT4_BINARY(op, expr) \
+    Float4 operator op(const Float4& b) const { \
+        Float4 r; \
+        for (int i = 0; i < SIZE; ++i) { const float x = v[i]; const float y = b.v[i]; (void)x; (void)y; r.v[i] = (expr); } \
+        return r; \
+    }
+
+    G3D_FLOAT4_BINARY(+,  x + y)
+    G3D_FLOAT4_BINARY(-,  x - y)
+    G3D_FLOAT4_BINARY(*,  x * y)
+    G3D_FLOAT4_BINARY(/,  x / y)
+    G3D_FLOAT4_BINARY(<,  mask(x <  y))
+    G3D_FLOAT4_BINARY(<=, mask(x <= y))
+    G3D_FLOAT4_BINARY(>,  mask(x >  y))
+    G3D_FLOAT4_BINARY(>=, mask(x >= y))
+    G3D_FLOAT4_BINARY(==, mask(x == y))
+    G3D_FLOAT4_BINARY(!=, mask(! (x == y)))
+    G3D_FLOAT4_BINARY(&,  fromBits(toBits(x) & toBits(y)))
+    G3D_FLOAT4_BINARY(|,  fromBits(toBits(x) | toBits(y)))
+    G3D_FLOAT4_BINARY(^,  fromBits(toBits(x) ^ toBits(y)))
+#   undef G3D_FLOAT4_BINARY
+
+    Float4 operator-() const { return Float4(-v[0], -v[1], -v[2], -v[3]); }
+
+    Float4 andNot(const Float4& b) const {
+        Float4 r;
+        for (int i = 0; i < SIZE; ++i) { r.v[i] = fromBits(~toBits(v[i]) & toBits(b.v[i])); }
+        return r;
+    }
+
+    int movemask() const {
+        int m = 0;
+        for (int i = 0; i < SIZE; ++i) { m |= int(toBits(v[i]) >> 31) << i; }
+        return m;
+    }
+
+    float operator[](int i) const {
+        debugAssert(i >= 0 && i < SIZE);
+        return v[i];
+    }
+
+    Float4 sqrt() const { return Float4(::sqrtf(v[0]), ::sqrtf(v[1]), ::sqrtf(v[2]), ::sqrtf(v[3])); }
+
+    Float4 rsqrt() const { return Float4(1.0f) / sqrt(); }
+
+    Float4 abs() const { return Float4(::fabsf(v[0]), ::fabsf(v[1]), ::fabsf(v[2]), ::fabsf(v[3])); }
+
+    friend Float4 min(const Float4& a, const Float4& b) {
+        Float4 r;
+        for (int i = 0; i < SIZE; ++i) { r.v[i] = (a.v[i] < b.v[i]) ? a.v[i] : b.v[i]; }
+        return r;
+    }
+
+    friend Float4 max(const Float4& a, const Float4& b) {
+        Float4 r;
+        for (int i = 0; i < SIZE; ++i) { r.v[i] = (a.v[i] > b.v[i]) ? a.v[i] : b.v[i]; }
+        return r;
+    }
+
+    friend Float4 select(const Float4& mask, const Float4& a, const Float4& b) {
+        return (mask & a) | mask.andNot(b);
+    }
+#endif
+
+    Float4& operator+=(const Float4& b) { return *this = *this + b; }
+    Float4& operator-=(const Float4& b) { return *this = *this - b; }
+    Float4& operator*=(const Float4& b) { return *this = *this * b; }
+
+    /** True if any lane of this mask is set */
+    bool any() const {
+        return movemask() != 0;
+    }
+
+    /** True if every lane of this mask is set */
+    bool all() const {
+        return movemask() == (1 << SIZE) - 1;
+    }
+};
+
+} // namespace G3D
+
+#endif
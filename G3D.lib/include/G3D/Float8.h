@@ -0,0 +1,187 @@
+/**
+  \file G3D/Float8.h
+
+  Eight-wide float SIMD vector.
+
+  \created 2026-10-18
+  \edited  2026-10-18
+ */
+
+#ifndef G3D_Float8_h
+#define G3D_Float8_h
+
+#include "G3D/platform.h"
+#include "G3D/Float4.h"
+
+#ifdef G3D_AVX
+#   include <immintrin.h>
+#endif
+
+namespace G3D {
+
+/**
+ \brief Eight floats that are operated on in parallel.
+
+ Uses a single AVX register when G3D_AVX is defined and a pair of
+ Float4 otherwise.  The interface matches Float4 so that kernels can be
+ written as templates over the vector width.
+
+ \sa Float4
+ */
+class Float8 {
+public:
+    enum {SIZE = 8};
+
+#ifdef G3D_AVX
+    __m256              v;
+
+    Float8() {}
+
+    Float8(__m256 x) : v(x) {}
+
+    /** Broadcasts s to all lanes */
+    explicit Float8(float s) : v(_mm256_set1_ps(s)) {}
+
+    /** Unaligned load of SIZE floats */
+    static Float8 load(const float* p) {
+        return Float8(_mm256_loadu_ps(p));
+    }
+
+    /** Unaligned store of SIZE floats */
+    void store(float* p) const {
+        _mm256_storeu_ps(p, v);
+    }
+
+    static Float8 zero() {
+        return Float8(_mm256_setzero_ps());
+    }
+
+    Float8 operator+(const Float8& b) const { return _mm256_add_ps(v, b.v); }
+    Float8 operator-(const Float8& b) const { return _mm256_sub_ps(v, b.v); }
+    Float8 operator*(const Float8& b) const { return _mm256_mul_ps(v, b.v); }
+    Float8 operator/(const Float8& b) const { return _mm256_div_ps(v, b.v); }
+    Float8 operator-() const { return _mm256_sub_ps(_mm256_setzero_ps(), v); }
+
+    Float8 operator< (const Float8& b) const { return _mm256_cmp_ps(v, b.v, _CMP_LT_OQ); }
+    Float8 operator<=(const Float8& b) const { return _mm256_cmp_ps(v, b.v, _CMP_LE_OQ); }
+    Float8 operator> (const Float8& b) const { return _mm256_cmp_ps(v, b.v, _CMP_GT_OQ); }
+    Float8 operator>=(const Float8& b) const { return _mm256_cmp_ps(v, b.v, _CMP_GE_OQ); }
+    Float8 operator==(const Float8& b) const { return _mm256_cmp_ps(v, b.v, _CMP_EQ_OQ); }
+    Float8 operator!=(const Float8& b) const { return _mm256_cmp_ps(v, b.v, _CMP_NEQ_UQ); }
+
+    Float8 operator&(const Float8& b) const { return _mm256_and_ps(v, b.v); }
+    Float8 operator|(const Float8& b) const { return _mm256_or_ps(v, b.v); }
+    Float8 operator^(const Float8& b) const { return _mm256_xor_ps(v, b.v); }
+
+    /** (~this) & b */
+    Float8 andNot(const Float8& b) const { return _mm256_andnot_ps(v, b.v); }
+
+    /** Bit i is the sign (high) bit of lane i */
+    int movemask() const { return _mm256_movemask_ps(v); }
+
+    float operator[](int i) const {
+        debugAssert(i >= 0 && i < SIZE);
+        float f[SIZE];
+        store(f);
+        return f[i];
+    }
+
+    Float8 sqrt() const { return _mm256_sqrt_ps(v); }
+
+    /** Approximate 1 / sqrt(x), about 12 bits of precision */
+    Float8 rsqrt() const { return _mm256_rsqrt_ps(v); }
+
+    Float8 abs() const { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v); }
+
+    friend Float8 min(const Float8& a, const Float8& b) { return _mm256_min_ps(a.v, b.v); }
+    friend Float8 max(const Float8& a, const Float8& b) { return _mm256_max_ps(a.v, b.v); }
+
+    /** Returns the lanes of a where mask is set and the lanes of b elsewhere */
+    friend Float8 select(const Float8& mask, const Float8& a, const Float8& b) {
+        return _mm256_blendv_ps(b.v, a.v, mask.v);
+    }
+
+#else
+    /** Lanes 0-3 and 4-7 */
+    Float4              lo, hi;
+
+    Float8() {}
+
+    Float8(const Float4& a, const Float4& b) : lo(a), hi(b) {}
+
+    explicit Float8(float s) : lo(s), hi(s) {}
+
+    static Float8 load(const float* p) {
+        return Float8(Float4::load(p), Float4::load(p + 4));
+    }
+
+    void store(float* p) const {
+        lo.store(p);
+        hi.store(p + 4);
+    }
+
+    static Float8 zero() {
+        return Float8(Float4::zero(), Float4::zero());
+    }
+
+#   define G3D_FLOAT8_BINARY(op) \
+    Float8 operator op(const Float8& b) const { return Float8(lo op b.lo, hi op b.hi); }
+
+    G3D_FLOAT8_BINARY(+)
+    G3D_FLOAT8_BINARY(-)
+    G3D_FLOAT8_BINARY(*)
+    G3D_FLOAT8_BINARY(/)
+    G3D_FLOAT8_BINARY(<)
+    G3D_FLOAT8_BINARY(<=)
+    G3D_FLOAT8_BINARY(>)
+    G3D_FLOAT8_BINARY(>=)
+    G3D_FLOAT8_BINARY(==)
+    G3D_FLOAT8_BINARY(!=)
+    G3D_FLOAT8_BINARY(&)
+    G3D_FLOAT8_BINARY(|)
+    G3D_FLOAT8_BINARY(^)
+#   undef G3D_FLOAT8_BINARY
+
+    Float8 operator-() const { return Float8(-lo, -hi); }
+
+    Float8 andNot(const Float8& b) const { return Float8(lo.andNot(b.lo), hi.andNot(b.hi)); }
+
+    int movemask() const { return lo.movemask() | (hi.movemask() << 4); }
+
+    float operator[](int i) const {
+        debugAssert(i >= 0 && i < SIZE);
+        return (i < 4) ? lo[i] : hi[i - 4];
+    }
+
+    Float8 sqrt() const { return Float8(lo.sqrt(), hi.sqrt()); }
+
+    Float8 rsqrt() const { return Float8(lo.rsqrt(), hi.rsqrt()); }
+
+    Float8 abs() const { return Float8(lo.abs(), hi.abs()); }
+
+    friend Float8 min(const Float8& a, const Float8& b) { return Float8(min(a.lo, b.lo), min(a.hi, b.hi)); }
+    friend Float8 max(const Float8& a, const Float8& b) { return Float8(max(a.lo, b.lo), max(a.hi, b.hi)); }
+
+    friend Float8 select(const Float8& mask, const Float8& a, const Float8& b) {
+        return Float8(select(mask.lo, a.lo, b.lo), select(mask.hi, a.hi, b.hi));
+    }
+#endif
+
+    Float8& operator+=(const Float8& b) { return *this = *this + b; }
+    Float8& operator-=(const Float8& b) { return *this = *this - b; }
+    Float8& operator*=(const Float8& b) { return *this = *this * b; }
+
+    /** True if any lane of this mask is set */
+    bool any() const {
+        return movemask() != 0;
+    }
+
+    /** True if every lane of this mask is set */
+    bool all() const {
+        return movemask() == (1 << SIZE) - 1;
+    }
+};
+
+} // namespace G3D
+
+#endif
@@ -49,6 +49,13 @@
 #include "G3D/Vector4.h"
 #include "G3D/Vector4int16.h"
 #include "G3D/Vector4int8.h"
+#include "G3D/Float4.h"
+#include "G3D/Float8.h"
+#include "G3D/Vector3xN.h"
+#include "G3D/FastRay.h"
+#include "G3D/AABoxBlock.h"
+#include "G3D/TriangleBlock.h"
+#include "G3D/CompactMesh.h"
 #include "G3D/Color1.h"
 #include "G3D/Color3.h"
 #include "G3D/Color4.h"
@@ -133,6 +140,8 @@ template<class T> struct HashTrait< shared_ptr<T> > {
 #include "G3D/Rect2D.h"
 #include "G3D/KDTree.h"
 #include "G3D/PointKDTree.h"
+#include "G3D/DynamicAABBTree.h"
+#include "G3D/SweepAndPrune.h"
 #include "G3D/TextOutput.h"
 #include "G3D/MeshBuilder.h"
 #include "G3D/Stopwatch.h"
@@ -164,6 +173,7 @@ template<class T> struct HashTrait< shared_ptr<T> > {
 #include "G3D/Parse3DS.h"
 #include "G3D/PathDirection.h"
 #include "G3D/FastPODTable.h"
+#include "G3D/FlatTable.h"
 #include "G3D/FastPointHashGrid.h"
 #include "G3D/PixelTransferBuffer.h"
 #include "G3D/CPUPixelTransferBuffer.h"
@@ -33,6 +33,8 @@ public:
       by Martin Eisemann, Thorsten Grosch, Stefan Mller and Marcus Magnor
       Computer Graphics Lab, TU Braunschweig, Germany and
       University of Koblenz-Landau, Germany
+
+      \sa AABoxBlockN for testing one ray against several boxes at once
     */
     static bool __fastcall rayAABox(const Ray& ray, const AABox& box);
 
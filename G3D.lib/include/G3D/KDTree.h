@@ -24,12 +24,19 @@
 #include "G3D/Box.h"
 #include "G3D/Triangle.h"
 #include "G3D/Ray.h"
+#include "G3D/LineSegment.h"
 #include "G3D/Frustum.h"
 #include "G3D/BinaryInput.h"
 #include "G3D/BinaryOutput.h"
 #include "G3D/CollisionDetection.h"
 #include "G3D/BoundsTrait.h"
+#include "G3D/SmallArray.h"
+#include "G3D/GThread.h"
+#include "G3D/AtomicInt32.h"
+#include "G3D/Float4.h"
+#include "G3D/Float8.h"
 #include <algorithm>
+#include <type_traits>
 
 // If defined, in debug mode the tree is checked for consistency
 // as a way of detecting corruption due to implementation bugs
@@ -191,6 +198,63 @@ template< class T,
           class HashFunc   = HashTrait<T>, 
           class EqualsFunc = EqualsTrait<T> > 
 class KDTree {
+public:
+
+    /** Strategy used by balance() to choose splitting planes. */
+    enum SplitHeuristic {
+        /** Median (and optionally mean) splits along the longest axis; see balance(). */
+        MEDIAN_SPLIT,
+
+        /** Surface area heuristic: evaluates SAH_NUM_BINS candidate planes on
+            every axis and takes the one with the lowest expected ray traversal
+            cost.  Slower to build than MEDIAN_SPLIT but produces much better
+            trees for long, thin or clustered content such as level geometry.
+            Nodes are not split further when splitting would not reduce
+            the expected cost, so leaves may hold more than valuesPerNode
+            members. */
+        SAH_SPLIT
+    };
+
+    enum {
+        /** Number of candidate planes per axis evaluated by SAH_SPLIT */
+        SAH_NUM_BINS = 32
+    };
+
+    /** Tree shape and quality metrics reported by getStatistics() */
+    class Statistics {
+    public:
+        int         numNodes;
+        int         numLeaves;
+
+        /** Depth of the deepest node; the root has depth 0 */
+        int         maxDepth;
+
+        float       averageLeafDepth;
+
+        /** Average number of members stored at a leaf, including empty leaves */
+        float       averageValuesPerLeaf;
+
+        /** Largest number of members stored at a single node */
+        int         maxValuesPerNode;
+
+        /** Members stored at interior nodes because they straddle the splitting plane */
+        int         numInteriorValues;
+
+        /** Surface area heuristic estimate of the cost of a random ray query, in units
+            of one member bounds test (a node visit costs sahTraversalCost()).  Lower
+            is better; compare values for the same content under different build
+            settings. */
+        float       expectedCost;
+
+        Statistics() : numNodes(0), numLeaves(0), maxDepth(0), averageLeafDepth(0),
+            averageValuesPerLeaf(0), maxValuesPerNode(0), numInteriorValues(0), expectedCost(0) {}
+    };
+
+    /** Cost of visiting a node relative to testing one member's bounds, used by SAH_SPLIT */
+    static float sahTraversalCost() {
+        return 1.5f;
+    }
+
 protected:
 #define TreeType KDTree<T, BoundsFunc, HashFunc, EqualsFunc>
 
@@ -213,10 +277,19 @@ protected:
 
         T                   value;
 
-        Handle() {}
+        /** True if insert() or update() placed this handle at its node,
+            false if balance() or rebalanceDegraded() did */
+        bool                inserted;
+
+        Handle() : inserted(false) {}
+
+        inline Handle(const T& v) : value(v), inserted(false) {
+            updateBounds();
+        }
 
-        inline Handle(const T& v) : value(v) {
-            BoundsFunc::getBounds(v, bounds);
+        /** Recomputes bounds and center from value */
+        void updateBounds() {
+            BoundsFunc::getBounds(value, bounds);
             bounds = bounds.intersect(AABox::large());
             center = bounds.center();
         }
@@ -368,8 +441,12 @@ protected:
           */
         Array<AABox>        boundsArray;
 
+        /** Number of handles in valueArray that are Handle::inserted.
+            Used to measure degradation(). */
+        int                 numInserted;
+
         /** Creates node with NULL children */
-        Node() {
+        Node() : numInserted(0) {
             splitAxis     = Vector3::X_AXIS;
             splitLocation = 0;
             splitBounds   = AABox(-Vector3::inf(), Vector3::inf());
@@ -381,7 +458,7 @@ protected:
         /**
          Doesn't clone children.
          */
-        Node(const Node& other) : valueArray(other.valueArray), boundsArray(other.boundsArray) {
+        Node(const Node& other) : valueArray(other.valueArray), boundsArray(other.boundsArray), numInserted(other.numInserted) {
             splitAxis       = other.splitAxis;
             splitLocation   = other.splitLocation;
             splitBounds     = other.splitBounds;            
@@ -392,7 +469,7 @@ protected:
 
         /** Copies the specified subarray of pt into point, NULLs the children.
             Assumes a second pass will set splitBounds. */
-        Node(const Array<Handle*>& pt) : valueArray(pt) {
+        Node(const Array<Handle*>& pt) : valueArray(pt), numInserted(0) {
             splitAxis     = Vector3::X_AXIS;
             splitLocation = 0;
             for (int i = 0; i < 2; ++i) {
@@ -507,6 +584,30 @@ protected:
             }
         }
 
+        /** True if bounds is strictly inside splitBounds, so that a member with
+            these bounds is on the same side of every ancestor's splitting
+            plane as this node and may be stored here or below. */
+        bool cellContains(const AABox& bounds) const {
+            for (int a = 0; a < 3; ++a) {
+                if (! (bounds.low()[a] > splitBounds.low()[a]) || ! (bounds.high()[a] < splitBounds.high()[a])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /** Adds the number of members in this subtree to numValues and the
+            number of those counted by numInserted to inserted. */
+        void countInserted(int& numValues, int& inserted) const {
+            numValues += valueArray.size();
+            inserted  += numInserted;
+            for (int c = 0; c < 2; ++c) {
+                if (child[c] != NULL) {
+                    child[c]->countInserted(numValues, inserted);
+                }
+            }
+        }
+
         /** Returns the deepest node that completely contains bounds. */
         Node* findDeepestContainingNode(const AABox& bounds) {
 
@@ -701,6 +802,360 @@ protected:
     };
 
 
+    /** Per-axis histograms of member bounds used by SAH_SPLIT.  Counts
+        from disjoint subsets of a node's members may be summed. */
+    class SAHBins {
+    public:
+        /** high[a][b] = number of members whose high edge along axis a falls in bin b; likewise low */
+        int         high[3][SAH_NUM_BINS];
+        int         low[3][SAH_NUM_BINS];
+
+        SAHBins() {
+            System::memset(high, 0, sizeof(high));
+            System::memset(low, 0, sizeof(low));
+        }
+
+        /** Adds source[begin..end) binned over bounds */
+        void add(const Array<Handle*>& source, int begin, int end, const AABox& bounds) {
+            for (int a = 0; a < 3; ++a) {
+                const float lo    = bounds.low()[a];
+                const float width = bounds.high()[a] - lo;
+                if (! (width > 0.0f)) {
+                    continue;
+                }
+                const float binsPerUnit = SAH_NUM_BINS / width;
+                for (int i = begin; i < end; ++i) {
+                    const AABox& b = source[i]->bounds;
+                    high[a][iClamp(int((b.high()[a] - lo) * binsPerUnit), 0, SAH_NUM_BINS - 1)] += 1;
+                    low[a][iClamp(int((b.low()[a] - lo) * binsPerUnit), 0, SAH_NUM_BINS - 1)] += 1;
+                }
+            }
+        }
+
+        void operator+=(const SAHBins& other) {
+            for (int a = 0; a < 3; ++a) {
+                for (int b = 0; b < SAH_NUM_BINS; ++b) {
+                    high[a][b] += other.high[a][b];
+                    low[a][b]  += other.low[a][b];
+                }
+            }
+        }
+    };
+
+    /**
+     Chooses the splitting plane with the lowest binned surface area
+     heuristic cost for the @a n members with the given bins, whose
+     bounds are @a bounds.  Members that straddle the plane stay at the
+     node and are tested whenever the node is visited.
+
+     @return false if no plane is expected to be cheaper than making
+     a leaf of all of the members.
+     */
+    static bool chooseSAHSplit(
+        const SAHBins&          bins,
+        int                     n,
+        const AABox&            bounds,
+        Vector3::Axis&          splitAxis,
+        float&                  splitLocation) {
+
+        const float parentArea  = bounds.area();
+        float       bestCost    = float(n);
+
+        if (! (parentArea > 0.0f) || ! isFinite(parentArea)) {
+            return false;
+        }
+
+        bool found = false;
+        for (int a = 0; a < 3; ++a) {
+            const float lo    = bounds.low()[a];
+            const float width = bounds.high()[a] - lo;
+            if (! (width > 0.0f)) {
+                continue;
+            }
+            const float binsPerUnit = SAH_NUM_BINS / width;
+
+            // numAbove[k] = members entirely above the plane at the start of bin k
+            int numAbove[SAH_NUM_BINS + 1];
+            numAbove[SAH_NUM_BINS] = 0;
+            for (int k = SAH_NUM_BINS - 1; k >= 0; --k) {
+                numAbove[k] = numAbove[k + 1] + bins.low[a][k];
+            }
+
+            int numBelow = 0;
+            for (int k = 1; k < SAH_NUM_BINS; ++k) {
+                numBelow += bins.high[a][k - 1];
+                const float location = lo + k / binsPerUnit;
+
+                AABox lowBox, highBox;
+                bounds.split(Vector3::Axis(a), location, lowBox, highBox);
+
+                const int numStraddle = n - numBelow - numAbove[k];
+                const float cost = sahTraversalCost() + numStraddle +
+                    (lowBox.area() * numBelow + highBox.area() * numAbove[k]) / parentArea;
+
+                if ((cost < bestCost) && (numStraddle < n)) {
+                    bestCost      = cost;
+                    splitAxis     = Vector3::Axis(a);
+                    splitLocation = location;
+                    found         = true;
+                }
+            }
+        }
+
+        return found;
+    }
+
+    /** A subtree whose construction balance() deferred so that it can run concurrently with others */
+    class BuildTask {
+    public:
+        Array<Handle*>      source;
+        int                 numMeanSplits;
+
+        /** Where to store the root of the subtree */
+        Node**              result;
+    };
+
+    /** Parameters shared by the makeNode calls of one balance() */
+    class BuildSettings {
+    public:
+        int                 valuesPerNode;
+        SplitHeuristic      heuristic;
+
+        /** Threads available for partitioning a single large node */
+        int                 numThreads;
+
+        /** If not NULL, subtrees with at most taskSize members are appended here
+            instead of being built immediately */
+        Array<BuildTask>*   deferred;
+        int                 taskSize;
+
+        BuildSettings(int v, SplitHeuristic h) : valuesPerNode(v), heuristic(h), numThreads(1), deferred(NULL), taskSize(0) {}
+    };
+
+    enum {
+        /** Nodes with at least this many members are partitioned by all threads
+            when balance() runs with more than one thread */
+        PARALLEL_NODE_SIZE = 1 << 15,
+
+        /** balance() runs on one thread for trees smaller than this */
+        PARALLEL_TREE_SIZE = 1 << 13
+    };
+
+    /** Computes bounds, SAH bins and partitions of one large node on
+        several threads by splitting the members into contiguous chunks.
+        Results are combined in chunk order, so they are identical to the
+        single-threaded versions. */
+    class ParallelNodeSplitter {
+    public:
+        const Array<Handle*>&   source;
+        const int               numThreads;
+        const int               numChunks;
+        const int               chunkSize;
+
+        Array<AABox>            chunkBounds;
+
+        AABox                   bounds;
+        Array<SAHBins>          chunkBins;
+
+        Comparator              comparator;
+        Array< Array<Handle*> > lt;
+        Array< Array<Handle*> > eq;
+        Array< Array<Handle*> > gt;
+
+        ParallelNodeSplitter(const Array<Handle*>& s, int t) :
+            source(s), numThreads(t), numChunks(t * 4),
+            chunkSize((s.size() + t * 4 - 1) / (t * 4)), comparator(Vector3::X_AXIS, 0) {}
+
+        int begin(int chunk) const {
+            return G3D::min(chunk * chunkSize, source.size());
+        }
+
+        int end(int chunk) const {
+            return G3D::min((chunk + 1) * chunkSize, source.size());
+        }
+
+        void run(void (ParallelNodeSplitter::*method)(int, int)) {
+            GThread::runConcurrently2D(Vector2int32(0, 0), Vector2int32(1, numChunks), this, method, numThreads);
+        }
+
+        void boundsChunk(int, int c) {
+            if (begin(c) < end(c)) {
+                chunkBounds[c] = TreeType::computeBounds(source, begin(c), end(c) - 1);
+            }
+        }
+
+        void binChunk(int, int c) {
+            chunkBins[c].add(source, begin(c), end(c), bounds);
+        }
+
+        void partitionChunk(int, int c) {
+            for (int i = begin(c); i < end(c); ++i) {
+                Handle* h = source[i];
+                switch (comparator(NULL, h)) {
+                case -1: lt[c].append(h); break;
+                case  0: eq[c].append(h); break;
+                default: gt[c].append(h); break;
+                }
+            }
+        }
+
+        AABox computeBounds() {
+            chunkBounds.resize(numChunks);
+            run(&ParallelNodeSplitter::boundsChunk);
+            Vector3 lo = Vector3::inf();
+            Vector3 hi = -lo;
+            for (int c = 0; c < numChunks; ++c) {
+                if (begin(c) < end(c)) {
+                    lo = lo.min(chunkBounds[c].low());
+                    hi = hi.max(chunkBounds[c].high());
+                }
+            }
+            return AABox(lo, hi);
+        }
+
+        void computeBins(const AABox& b, SAHBins& bins) {
+            bounds = b;
+            chunkBins.resize(numChunks);
+            run(&ParallelNodeSplitter::binChunk);
+            for (int c = 0; c < numChunks; ++c) {
+                bins += chunkBins[c];
+            }
+        }
+
+        /** Equivalent to source.partition(NULL, ltOut, eqOut, gtOut, Comparator(axis, location)) */
+        void partition(Vector3::Axis axis, float location, Array<Handle*>& ltOut, Array<Handle*>& eqOut, Array<Handle*>& gtOut) {
+            comparator = Comparator(axis, location);
+            lt.resize(numChunks);
+            eq.resize(numChunks);
+            gt.resize(numChunks);
+            run(&ParallelNodeSplitter::partitionChunk);
+            ltOut.fastClear();
+            eqOut.fastClear();
+            gtOut.fastClear();
+            for (int c = 0; c < numChunks; ++c) {
+                ltOut.append(lt[c]);
+                eqOut.append(eq[c]);
+                gtOut.append(gt[c]);
+            }
+        }
+    };
+
+    /** Runs deferred BuildTasks on a pool of threads, largest first */
+    class BuildWorker {
+    public:
+        TreeType*           tree;
+        Array<BuildTask>&   task;
+        Array<int>          order;
+        BuildSettings       settings;
+        AtomicInt32         nextTask;
+
+        BuildWorker(TreeType* t, Array<BuildTask>& k, const BuildSettings& s) :
+            tree(t), task(k), settings(s), nextTask(0) {
+
+            // Deferred subtrees are built without further deferral or nested parallelism
+            settings.numThreads = 1;
+            settings.deferred   = NULL;
+
+            order.resize(task.size());
+            for (int i = 0; i < order.size(); ++i) {
+                order[i] = i;
+            }
+            std::sort(order.begin(), order.end(), LargerTask(task));
+        }
+
+        class LargerTask {
+        public:
+            const Array<BuildTask>& task;
+            LargerTask(const Array<BuildTask>& t) : task(t) {}
+            bool operator()(int a, int b) const {
+                return task[a].source.size() > task[b].source.size();
+            }
+        };
+
+        void run(int, int) {
+            Array<Handle*> temp;
+            for (int i = nextTask.add(1); i < order.size(); i = nextTask.add(1)) {
+                BuildTask& t = task[order[i]];
+                *t.result = tree->makeNode(t.source, t.numMeanSplits, settings, temp);
+            }
+        }
+    };
+
+    /** Rebuilds the largest subtrees under node whose fraction of inserted
+        members exceeds maxDegradation.  Returns the new root of the subtree. */
+    Node* rebalanceDegraded(
+        Node*                   node,
+        float                   maxDegradation,
+        int                     numMeanSplits,
+        const BuildSettings&    settings,
+        Array<Handle*>&         temp,
+        int&                    numRebuilt) {
+
+        int numValues = 0;
+        int inserted = 0;
+        node->countInserted(numValues, inserted);
+
+        if ((inserted > 0) && (float(inserted) > maxDegradation * float(numValues))) {
+            const AABox bounds = node->splitBounds;
+            Array<Handle*> source;
+            node->getHandles(source);
+            delete node;
+            for (int i = 0; i < source.size(); ++i) {
+                source[i]->inserted = false;
+            }
+
+            node = makeNode(source, numMeanSplits, settings, temp);
+            node->assignSplitBounds(bounds);
+            ++numRebuilt;
+        } else {
+            for (int c = 0; c < 2; ++c) {
+                if (node->child[c] != NULL) {
+                    node->child[c] = rebalanceDegraded(node->child[c], maxDegradation, numMeanSplits, settings, temp, numRebuilt);
+                }
+            }
+        }
+        return node;
+    }
+
+    /** Records that h is stored at node.  Every handle is already a key of
+        memberTable during balance(), so this never resizes the table and
+        may be called concurrently for different handles. */
+    void setMemberNode(Handle* h, Node* node) {
+        Node** p = memberTable.getPointer(Member(h));
+        debugAssertM(p != NULL, "KDTree member missing from the member table");
+        *p = node;
+    }
+
+    /** Makes a leaf containing all of source and clears source. */
+    Node* makeLeaf(Array<Handle*>& source) {
+        Node* node = new Node(source);
+
+        // Set the pointers in the memberTable
+        for (int i = 0; i < source.size(); ++i) {
+            setMemberNode(source[i], node);
+        }
+        source.clear();
+        return node;
+    }
+
+    /** Builds the subtree for source into child, or defers it to settings.deferred. */
+    void makeChild(
+        Node*&                  child,
+        Array<Handle*>&         source,
+        int                     numMeanSplits,
+        const BuildSettings&    settings,
+        Array<Handle*>&         temp) {
+
+        if ((settings.deferred != NULL) && (source.size() <= settings.taskSize) && (source.size() > settings.valuesPerNode)) {
+            BuildTask& t    = settings.deferred->next();
+            t.source        = std::move(source);
+            t.numMeanSplits = numMeanSplits;
+            t.result        = &child;
+        } else {
+            child = makeNode(source, numMeanSplits, settings, temp);
+        }
+    }
+
     /**
      Recursively subdivides the subarray.
     
@@ -710,37 +1165,55 @@ protected:
      */
     Node* makeNode(
         Array<Handle*>& source, 
-        int valuesPerNode, 
         int numMeanSplits,
+        const BuildSettings& settings,
         Array<Handle*>& temp)  {
 
         Node* node = NULL;
         
-        if (source.size() <= valuesPerNode) {
+        if (source.size() <= settings.valuesPerNode) {
             // Make a new leaf node
-            node = new Node(source);
-            
-            // Set the pointers in the memberTable
-            for (int i = 0; i < source.size(); ++i) {
-                memberTable.set(Member(source[i]), node);
-            }
-            source.clear();
+            node = makeLeaf(source);
             
         } else {
-            // Make a new internal node
-            node = new Node();
-            
-            const AABox& bounds = computeBounds(source, 0, source.size() - 1);
+            const bool parallel = (settings.numThreads > 1) && (source.size() >= PARALLEL_NODE_SIZE);
+            ParallelNodeSplitter splitter(source, settings.numThreads);
+
+            const AABox& bounds = parallel ? splitter.computeBounds() : computeBounds(source, 0, source.size() - 1);
             const Vector3& extent = bounds.high() - bounds.low();
             
             Vector3::Axis splitAxis = extent.primaryAxis();
             
             float splitLocation;
 
+            if (settings.heuristic == SAH_SPLIT) {
+                SAHBins bins;
+                if (parallel) {
+                    splitter.computeBins(bounds, bins);
+                } else {
+                    bins.add(source, 0, source.size(), bounds);
+                }
+
+                if (! chooseSAHSplit(bins, source.size(), bounds, splitAxis, splitLocation)) {
+                    // Splitting would not pay for itself
+                    return makeLeaf(source);
+                }
+            }
+
+            // Make a new internal node
+            node = new Node();
+
             // Arrays for holding the children
             Array<Handle*> lt, gt;
-                
-            if (numMeanSplits <= 0) {
+
+            if (settings.heuristic == SAH_SPLIT) {
+                if (parallel) {
+                    splitter.partition(splitAxis, splitLocation, lt, node->valueArray, gt);
+                } else {
+                    source.partition(NULL, lt, node->valueArray, gt, Comparator(splitAxis, splitLocation));
+                }
+
+            } else if (numMeanSplits <= 0) {
 
                 source.medianPartition(lt, node->valueArray, gt, temp, CenterComparator(splitAxis));
 
@@ -782,7 +1255,7 @@ protected:
             // Note: numMeanSplits may have been increased by the code in the previous case above in order to
             // force a re-partition.
 
-            if (numMeanSplits > 0) {
+            if ((settings.heuristic == MEDIAN_SPLIT) && (numMeanSplits > 0)) {
                 // Split along the mean
                 splitLocation = 
                     bounds.high()[splitAxis] * 0.5f + 
@@ -791,7 +1264,11 @@ protected:
                 debugAssertM(isFinite(splitLocation),
                             "Internal error: split location must be finite.");
 
-                source.partition(NULL, lt, node->valueArray, gt, Comparator(splitAxis, splitLocation));
+                if (parallel) {
+                    splitter.partition(splitAxis, splitLocation, lt, node->valueArray, gt);
+                } else {
+                    source.partition(NULL, lt, node->valueArray, gt, Comparator(splitAxis, splitLocation));
+                }
 
                 // The Comparator ensures that elements are strictly on the correct side of the split
             }
@@ -829,15 +1306,15 @@ protected:
             for (int i = 0; i < node->valueArray.size(); ++i) {
                 Handle* v = node->valueArray[i];
                 node->boundsArray[i] = v->bounds;
-                memberTable.set(Member(v), node);
+                setMemberNode(v, node);
             }
 
             if (lt.size() > 0) {            
-                node->child[0] = makeNode(lt, valuesPerNode, numMeanSplits - 1, temp);
+                makeChild(node->child[0], lt, numMeanSplits - 1, settings, temp);
             }
             
             if (gt.size() > 0) {
-                node->child[1] = makeNode(gt, valuesPerNode, numMeanSplits - 1, temp);
+                makeChild(node->child[1], gt, numMeanSplits - 1, settings, temp);
             }
             
         }
@@ -868,6 +1345,659 @@ protected:
         return dst;
     }
 
+    /**
+     One 32-byte record of the packed tree created by pack().  Each
+     node is a <code>node</code> record immediately followed by one
+     <code>value</code> record per member stored at that node, so the
+     bounds tested at a node share its cache lines.  The node's low
+     child (if any) begins immediately after its value records; the
+     high child is at an explicit index.  Records contain no pointers.
+     */
+    union PackedRecord {
+        enum {LOW_CHILD = 1, HIGH_CHILD = 2};
+
+        struct {
+            float           splitLocation;
+            uint8           splitAxis;
+
+            /** Bitwise OR of LOW_CHILD and HIGH_CHILD */
+            uint8           childFlags;
+            uint16          pad0;
+
+            /** Number of value records following this one */
+            uint32          numValues;
+
+            /** Record index of the high child */
+            uint32          highChild;
+
+            /** One past the last record in this subtree */
+            uint32          subtreeEnd;
+            uint32          pad1[3];
+        } node;
+
+        struct {
+            float           low[3];
+
+            /** Index into packedHandle */
+            uint32          handle;
+            float           high[3];
+            uint32          pad;
+        } value;
+    };
+
+    /** Appends the subtree rooted at n to packed in depth-first order. */
+    void packNode(const Node* n) {
+        const int i = packed.size();
+        const int numValues = n->valueArray.size();
+        packed.resize(i + 1 + numValues, DONT_SHRINK_UNDERLYING_ARRAY);
+
+        PackedRecord& r = packed[i];
+        System::memset(&r, 0, sizeof(PackedRecord));
+        r.node.splitLocation = n->splitLocation;
+        r.node.splitAxis     = uint8(n->splitAxis);
+        r.node.numValues     = numValues;
+
+        for (int v = 0; v < numValues; ++v) {
+            PackedRecord& b = packed[i + 1 + v];
+            const AABox& bounds = n->boundsArray[v];
+            for (int a = 0; a < 3; ++a) {
+                b.value.low[a]  = bounds.low()[a];
+                b.value.high[a] = bounds.high()[a];
+            }
+            b.value.handle = packedHandle.size();
+            b.value.pad    = 0;
+            packedHandle.append(n->valueArray[v]);
+        }
+
+        if (n->child[0] != NULL) {
+            packed[i].node.childFlags |= PackedRecord::LOW_CHILD;
+            packNode(n->child[0]);
+        }
+
+        if (n->child[1] != NULL) {
+            packed[i].node.childFlags |= PackedRecord::HIGH_CHILD;
+            packed[i].node.highChild = packed.size();
+            packNode(n->child[1]);
+        }
+
+        packed[i].node.subtreeEnd = packed.size();
+    }
+
+    /** Discards the packed form; called by every method that modifies the tree. */
+    void unpack() {
+        packed.clear();
+        packedHandle.clear();
+        packedRecord    = NULL;
+        mappedValue     = NULL;
+        numMappedValues = 0;
+    }
+
+    /** The member referenced by a value record */
+    const T& packedValue(uint32 handle) const {
+        return (mappedValue != NULL) ? mappedValue[handle] : packedHandle[handle]->value;
+    }
+
+    enum {
+        PACKED_FORMAT_VERSION = 1,
+
+        /** Written in the byte order of the machine that wrote the file */
+        PACKED_BYTE_ORDER     = 0x01020304,
+
+        /** Alignment of sections within the serialized form */
+        PACKED_ALIGNMENT      = 64
+    };
+
+    /** First bytes of the format written by serializePacked().  Offsets
+        are in bytes from the start of the header. */
+    class PackedHeader {
+    public:
+        /** "G3DKDTR" */
+        char            magic[8];
+        uint32          version;
+        uint32          byteOrder;
+        uint32          recordSize;
+        uint32          valueSize;
+        uint32          numRecords;
+        uint32          numValues;
+        uint64          recordOffset;
+        uint64          valueOffset;
+        uint64          totalSize;
+        uint8           pad[8];
+    };
+
+    static uint64 alignPacked(uint64 offset) {
+        return (offset + PACKED_ALIGNMENT - 1) & ~uint64(PACKED_ALIGNMENT - 1);
+    }
+
+    /** Throws unless the numRecords records form the depth-first layout
+        written by packNode(), with every handle below numValues.  Called by
+        mapPacked() so that traversals of untrusted data stay in bounds. */
+    static void validatePacked(const PackedRecord* record, uint32 numRecords, uint32 numValues) {
+        if (record[0].node.subtreeEnd != numRecords) {
+            throw "Corrupt packed KDTree root";
+        }
+
+        // Each entry is a node and the end of the range its subtree must fill
+        SmallArray<uint32, 64> stack;
+        stack.push(0);
+        stack.push(numRecords);
+        while (stack.size() > 0) {
+            const uint32 end = stack.pop();
+            const uint32 n   = stack.pop();
+            const PackedRecord& node = record[n];
+            const uint64 childStart = uint64(n) + 1 + node.node.numValues;
+
+            if ((node.node.subtreeEnd != end) || (childStart > end) || (node.node.splitAxis > 2) ||
+                (node.node.childFlags & ~(PackedRecord::LOW_CHILD | PackedRecord::HIGH_CHILD))) {
+                throw "Corrupt packed KDTree node";
+            }
+
+            for (uint32 v = n + 1; v < uint32(childStart); ++v) {
+                if (record[v].value.handle >= numValues) {
+                    throw "Corrupt packed KDTree member index";
+                }
+            }
+
+            // The low child fills the records up to the high child, or to
+            // the end of this subtree if there is no high child
+            const bool hasLow  = (node.node.childFlags & PackedRecord::LOW_CHILD) != 0;
+            const bool hasHigh = (node.node.childFlags & PackedRecord::HIGH_CHILD) != 0;
+            const uint32 lowEnd = hasHigh ? node.node.highChild : end;
+            if ((hasHigh && ((node.node.highChild < childStart) || (node.node.highChild >= end))) ||
+                (hasLow ? (childStart >= lowEnd) : (childStart != lowEnd))) {
+                throw "Corrupt packed KDTree child index";
+            }
+
+            if (hasLow) {
+                stack.push(uint32(childStart));
+                stack.push(lowEnd);
+            }
+            if (hasHigh) {
+                stack.push(node.node.highChild);
+                stack.push(end);
+            }
+        }
+    }
+
+    /** Slab test of a ray against a value record's bounds over [0, maxDistance] */
+    static bool rayHitsPackedBounds(const Ray& ray, const PackedRecord& r, float maxDistance) {
+        float t0 = 0.0f;
+        float t1 = maxDistance;
+        for (int a = 0; a < 3; ++a) {
+            float n = (r.value.low[a]  - ray.origin()[a]) * ray.invDirection()[a];
+            float f = (r.value.high[a] - ray.origin()[a]) * ray.invDirection()[a];
+            if ((n != n) || (f != f)) {
+                // NaN (0 * inf): the ray is parallel to this slab and lies in the
+                // plane of one of its faces, so the slab does not clip the interval
+                continue;
+            }
+            if (n > f) {
+                std::swap(n, f);
+            }
+            t0 = (n > t0) ? n : t0;
+            t1 = (f < t1) ? f : t1;
+        }
+        return t0 <= t1;
+    }
+
+    static bool boxIntersectsPackedBounds(const AABox& box, const PackedRecord& r) {
+        for (int a = 0; a < 3; ++a) {
+            if ((box.low()[a] > r.value.high[a]) || (box.high()[a] < r.value.low[a])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static AABox packedBounds(const PackedRecord& r) {
+        return AABox(Vector3(r.value.low[0], r.value.low[1], r.value.low[2]),
+                     Vector3(r.value.high[0], r.value.high[1], r.value.high[2]));
+    }
+
+    /** Packed version of Node::getIntersectingMembers */
+    void getIntersectingMembersPacked(
+        const AABox&        box,
+        const Sphere&       sphere,
+        Array<T*>&          members,
+        bool                useSphere) const {
+
+        SmallArray<uint32, 64> stack;
+        stack.push(0);
+        while (stack.size() > 0) {
+            const uint32 n = stack.pop();
+            const PackedRecord& node = packedRecord[n];
+
+            for (uint32 v = n + 1; v <= n + node.node.numValues; ++v) {
+                const PackedRecord& r = packedRecord[v];
+                if (boxIntersectsPackedBounds(box, r) &&
+                    (! useSphere || packedBounds(r).intersects(sphere))) {
+                    members.append(const_cast<T*>(&packedValue(r.value.handle)));
+                }
+            }
+
+            // Push the high child first so that the low subtree is reported first,
+            // matching the order of the unpacked traversal.
+            const int axis = node.node.splitAxis;
+            if ((node.node.childFlags & PackedRecord::HIGH_CHILD) && (box.high()[axis] > node.node.splitLocation)) {
+                stack.push(node.node.highChild);
+            }
+            if ((node.node.childFlags & PackedRecord::LOW_CHILD) && (box.low()[axis] < node.node.splitLocation)) {
+                stack.push(n + 1 + node.node.numValues);
+            }
+        }
+    }
+
+    /** Packed version of getIntersectingMembers(const Array<Plane>&, ...) */
+    void getIntersectingMembersPacked(const Array<Plane>& plane, Array<T*>& members) const {
+        class Entry {
+        public:
+            uint32      node;
+            uint32      parentMask;
+            AABox       splitBounds;
+            Entry() {}
+            Entry(uint32 n, uint32 m, const AABox& b) : node(n), parentMask(m), splitBounds(b) {}
+        };
+
+        int dummy;
+        SmallArray<Entry, 32> stack;
+        stack.push(Entry(0, 0xFFFFFF, AABox::large()));
+        while (stack.size() > 0) {
+            const Entry e = stack.pop();
+            const PackedRecord& node = packedRecord[e.node];
+            const uint32 first = e.node + 1;
+
+            if (e.parentMask == 0) {
+                // None of these planes can cull anything; report the whole subtree
+                for (uint32 r = e.node; r < node.node.subtreeEnd; r += packedRecord[r].node.numValues + 1) {
+                    for (int v = int(packedRecord[r].node.numValues) - 1; v >= 0; --v) {
+                        members.append(const_cast<T*>(&packedValue(packedRecord[r + 1 + v].value.handle)));
+                    }
+                }
+                continue;
+            }
+
+            for (int v = int(node.node.numValues) - 1; v >= 0; --v) {
+                const PackedRecord& r = packedRecord[first + v];
+                if (! packedBounds(r).culledBy(plane, dummy, e.parentMask)) {
+                    members.append(const_cast<T*>(&packedValue(r.value.handle)));
+                }
+            }
+
+            AABox childBounds[2];
+            e.splitBounds.split(Vector3::Axis(node.node.splitAxis), node.node.splitLocation, childBounds[0], childBounds[1]);
+            const uint32 child[2] = {first + node.node.numValues, node.node.highChild};
+
+            for (int c = 1; c >= 0; --c) {
+                uint32 childMask = 0xFFFFFF;
+                if ((node.node.childFlags & (1 << c)) &&
+                    ! childBounds[c].culledBy(plane, dummy, e.parentMask, childMask)) {
+                    stack.push(Entry(child[c], childMask, childBounds[c]));
+                }
+            }
+        }
+    }
+
+    /** Packed version of Node::intersectRay.  Traverses front to back,
+        clipping the ray's parametric interval at each splitting plane.
+        If anyHit is true, returns as soon as the callback reduces distance. */
+    template<typename RayCallback>
+    void intersectRayPacked(
+        const Ray&          ray,
+        RayCallback&        intersectCallback,
+        float&              distance,
+        bool                intersectCallbackIsFast,
+        bool                anyHit = false) const {
+
+        const float maxDistance = distance;
+
+        class Entry {
+        public:
+            uint32      node;
+            float       tEnter;
+            float       tExit;
+            Entry() {}
+            Entry(uint32 n, float t0, float t1) : node(n), tEnter(t0), tExit(t1) {}
+        };
+
+        SmallArray<Entry, 64> stack;
+        stack.push(Entry(0, 0.0f, finf()));
+        while (stack.size() > 0) {
+            Entry e = stack.pop();
+            if (e.tEnter > distance) {
+                // Something closer was already found
+                continue;
+            }
+
+            while (true) {
+                const PackedRecord& node = packedRecord[e.node];
+                const uint32 first = e.node + 1;
+
+                for (uint32 v = first; v < first + node.node.numValues; ++v) {
+                    const PackedRecord& r = packedRecord[v];
+                    if (intersectCallbackIsFast || rayHitsPackedBounds(ray, r, distance)) {
+                        const T& value = packedValue(r.value.handle);
+                        intersectCallback(ray, value, distance);
+                        if (anyHit && (distance < maxDistance)) {
+                            return;
+                        }
+                    }
+                }
+
+                // Classify the children as in Node::intersectRay
+                const int   axis  = node.node.splitAxis;
+                const float split = node.node.splitLocation;
+                const float o     = ray.origin()[axis];
+                const float d     = ray.direction()[axis];
+
+                int nearChild = -1;
+                int farChild  = -1;
+                if (o < split) {
+                    nearChild = 0;
+                    if (d > 0) {
+                        farChild = 1;
+                    }
+                } else if (o > split) {
+                    nearChild = 1;
+                    if (d < 0) {
+                        farChild = 0;
+                    }
+                } else if (d < 0) {
+                    nearChild = 0;
+                } else if (d > 0) {
+                    nearChild = 1;
+                }
+
+                const uint32 child[2] = {first + node.node.numValues, node.node.highChild};
+                const bool   exists[2] = {(node.node.childFlags & PackedRecord::LOW_CHILD) != 0,
+                                          (node.node.childFlags & PackedRecord::HIGH_CHILD) != 0};
+
+                float tExitNear = e.tExit;
+                if (farChild != -1) {
+                    const float tSplit = (split - o) * ray.invDirection()[axis];
+                    if (exists[farChild] && (tSplit <= e.tExit) && (tSplit <= distance)) {
+                        stack.push(Entry(child[farChild], G3D::max(e.tEnter, tSplit), e.tExit));
+                    }
+                    if (tSplit < e.tEnter) {
+                        // The ray crossed the plane before entering this node
+                        nearChild = -1;
+                    }
+                    tExitNear = G3D::min(tExitNear, tSplit);
+                }
+
+                if ((nearChild == -1) || ! exists[nearChild]) {
+                    break;
+                }
+                e = Entry(child[nearChild], e.tEnter, tExitNear);
+            }
+        }
+    }
+
+    /** Forwards to a RayCallback until it reports an intersection, for
+        any-hit queries on the unpacked tree, which has no early exit. */
+    template<typename RayCallback>
+    class AnyHitCallback {
+    public:
+        RayCallback&        callback;
+        const float         maxDistance;
+
+        AnyHitCallback(RayCallback& c, float m) : callback(c), maxDistance(m) {}
+
+        void operator()(const Ray& ray, const T& value, float& distance) {
+            if (distance >= maxDistance) {
+                callback(ray, value, distance);
+            }
+        }
+    };
+
+    /** Implementation of intersectSegments() for a single segment */
+    template<typename RayCallback>
+    void intersectSegment(
+        const LineSegment&  segment,
+        RayCallback&        intersectCallback,
+        float&              distance,
+        bool                anyHit,
+        bool                intersectCallbackIsFast) const {
+
+        distance = finf();
+        const Point3  origin = segment.point(0);
+        const Vector3 delta  = segment.point(1) - origin;
+        const float   length = delta.length();
+        if ((! isPacked() && (root == NULL)) || ! (length > 0.0f)) {
+            return;
+        }
+
+        const Ray ray = Ray::fromOriginAndDirection(origin, delta / length);
+        float t = length;
+        if (isPacked()) {
+            intersectRayPacked(ray, intersectCallback, t, intersectCallbackIsFast, anyHit);
+        } else if (anyHit) {
+            AnyHitCallback<RayCallback> callback(intersectCallback, length);
+            root->intersectRay(ray, callback, t, intersectCallbackIsFast);
+        } else {
+            root->intersectRay(ray, intersectCallback, t, intersectCallbackIsFast);
+        }
+
+        if (t < length) {
+            distance = t;
+        }
+    }
+
+    /** Runs intersectSegment() for chunks of segments on a pool of threads.
+        Chunks are claimed dynamically so that threads that draw cheap
+        segments take more of them. */
+    template<typename RayCallback>
+    class SegmentWorker {
+    public:
+        enum {CHUNK_SIZE = 64};
+
+        const TreeType*             tree;
+        const Array<LineSegment>&   segment;
+        RayCallback&                intersectCallback;
+        Array<float>&               distance;
+        const bool                  anyHit;
+        const bool                  intersectCallbackIsFast;
+        AtomicInt32                 nextChunk;
+
+        SegmentWorker(const TreeType* t, const Array<LineSegment>& s, RayCallback& c, Array<float>& d, bool a, bool f) :
+            tree(t), segment(s), intersectCallback(c), distance(d), anyHit(a), intersectCallbackIsFast(f), nextChunk(0) {}
+
+        static int numChunks(int numSegments) {
+            return (numSegments + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        }
+
+        void run(int, int) {
+            for (int c = nextChunk.add(1); c < numChunks(segment.size()); c = nextChunk.add(1)) {
+                const int end = G3D::min((c + 1) * int(CHUNK_SIZE), segment.size());
+                for (int i = c * CHUNK_SIZE; i < end; ++i) {
+                    tree->intersectSegment(segment[i], intersectCallback, distance[i], anyHit, intersectCallbackIsFast);
+                }
+            }
+        }
+    };
+
+#ifdef G3D_AVX
+    typedef Float8 RayPacketFloat;
+#else
+    typedef Float4 RayPacketFloat;
+#endif
+
+    /** Adapts a callback of the form taken by intersectRayPacket() to the
+        form taken by intersectRay() for rays traced individually. */
+    template<typename RayPacketCallback>
+    class RayIndexCallback {
+    public:
+        RayPacketCallback&  callback;
+        int                 rayIndex;
+
+        RayIndexCallback(RayPacketCallback& c, int i) : callback(c), rayIndex(i) {}
+
+        void operator()(const Ray& ray, const T& value, float& distance) {
+            callback(rayIndex, ray, value, distance);
+        }
+    };
+
+    /** Direction octant of a ray, 0-7; rays in one octant share the sign of
+        every component of their inverse directions (1 / -0 = -inf). */
+    static int rayOctant(const Ray& ray) {
+        const Vector3& inv = ray.invDirection();
+        return int(inv.x < 0) | (int(inv.y < 0) << 1) | (int(inv.z < 0) << 2);
+    }
+
+    /** Traces individually the rays whose indices are in order[start, end) */
+    template<typename RayPacketCallback>
+    void intersectRaysSingly(
+        const Array<Ray>&   rays,
+        const int*          order,
+        int                 start,
+        int                 end,
+        RayPacketCallback&  intersectCallback,
+        Array<float>&       distance,
+        bool                intersectCallbackIsFast) const {
+
+        for (int i = start; i < end; ++i) {
+            const int r = order[i];
+            RayIndexCallback<RayPacketCallback> callback(intersectCallback, r);
+            intersectRayPacked(rays[r], callback, distance[r], intersectCallbackIsFast);
+        }
+    }
+
+    /**
+     Traverses the packed tree with up to RAY_PACKET_SIZE rays at once,
+     whose indices are index[0...count - 1].  All of the rays must have
+     the same rayOctant(), so that every ray in the packet visits the
+     children of a node in the same order.  Each lane carries its own
+     parametric interval and the packet descends into a child while any
+     lane's interval overlaps it.
+     */
+    template<typename RayPacketCallback>
+    void intersectRayPacketPacked(
+        const Array<Ray>&   rays,
+        const int*          index,
+        int                 count,
+        RayPacketCallback&  intersectCallback,
+        Array<float>&       distance,
+        bool                intersectCallbackIsFast) const {
+
+        typedef RayPacketFloat F;
+        enum {W = F::SIZE};
+        debugAssert(count > 0 && count <= W);
+
+        float origin[3][W];
+        float inv[3][W];
+        float dist[W];
+        for (int l = 0; l < W; ++l) {
+            // Unused lanes duplicate the last ray and are never active
+            const Ray& ray = rays[index[G3D::min(l, count - 1)]];
+            for (int a = 0; a < 3; ++a) {
+                origin[a][l] = ray.origin()[a];
+                inv[a][l]    = ray.invDirection()[a];
+            }
+            dist[l] = distance[index[G3D::min(l, count - 1)]];
+        }
+
+        const F O[3] = {F::load(origin[0]), F::load(origin[1]), F::load(origin[2])};
+        const F I[3] = {F::load(inv[0]), F::load(inv[1]), F::load(inv[2])};
+        const bool negative[3] = {inv[0][0] < 0, inv[1][0] < 0, inv[2][0] < 0};
+        F D = F::load(dist);
+
+        class Entry {
+        public:
+            uint32      node;
+
+            /** Bit l is set if lane l may intersect this node */
+            int         mask;
+            float       tEnter[W];
+            float       tExit[W];
+        };
+
+        SmallArray<Entry, 64> stack;
+        stack.resize(1);
+        stack[0].node = 0;
+        stack[0].mask = (1 << count) - 1;
+        F::zero().store(stack[0].tEnter);
+        D.store(stack[0].tExit);
+
+        while (stack.size() > 0) {
+            const Entry& top = stack[stack.size() - 1];
+            uint32 n    = top.node;
+            F      t0   = F::load(top.tEnter);
+            F      t1   = F::load(top.tExit);
+            int    mask = top.mask & (t0 <= D).movemask();
+            stack.popDiscard();
+
+            while (mask != 0) {
+                const PackedRecord& node = packedRecord[n];
+                const uint32 first = n + 1;
+
+                for (uint32 v = first; v < first + node.node.numValues; ++v) {
+                    const PackedRecord& r = packedRecord[v];
+                    int hit = mask;
+                    if (! intersectCallbackIsFast) {
+                        // Slab test against [0, distance]; the signs of the
+                        // directions are uniform, so no min/max is needed per axis.
+                        // A lane that lies in the plane of a face has a NaN
+                        // (0 * inf) plane distance; min() and max() then return
+                        // their second argument, so that face does not clip it.
+                        F b0 = F::zero();
+                        F b1 = D;
+                        for (int a = 0; a < 3; ++a) {
+                            const F lo((negative[a] ? r.value.high : r.value.low)[a]);
+                            const F hi((negative[a] ? r.value.low : r.value.high)[a]);
+                            b0 = max((lo - O[a]) * I[a], b0);
+                            b1 = min((hi - O[a]) * I[a], b1);
+                        }
+                        hit &= (b0 <= b1).movemask();
+                    }
+
+                    if (hit != 0) {
+                        const T& value = packedValue(r.value.handle);
+                        for (int l = 0; l < count; ++l) {
+                            if (hit & (1 << l)) {
+                                const int i = index[l];
+                                intersectCallback(i, rays[i], value, distance[i]);
+                                dist[l] = distance[i];
+                            }
+                        }
+                        D = F::load(dist);
+                    }
+                }
+
+                const int   axis   = node.node.splitAxis;
+                const F     tSplit = (F(node.node.splitLocation) - O[axis]) * I[axis];
+                const uint32 child[2] = {first + node.node.numValues, node.node.highChild};
+                const bool   exists[2] = {(node.node.childFlags & PackedRecord::LOW_CHILD) != 0,
+                                          (node.node.childFlags & PackedRecord::HIGH_CHILD) != 0};
+
+                // Rays travelling in the negative direction reach the high child first
+                const int nearChild = negative[axis] ? 1 : 0;
+                const int farChild  = 1 - nearChild;
+
+                // tSplit is NaN for a lane that lies in the split plane, which
+                // then visits both children over its whole interval
+                const F nearExit  = min(tSplit, t1);
+                const F farEnter  = max(tSplit, t0);
+
+                if (exists[farChild]) {
+                    const int farMask = mask & ((farEnter <= t1) & (farEnter <= D)).movemask();
+                    if (farMask != 0) {
+                        Entry& e = stack.next();
+                        e.node = child[farChild];
+                        e.mask = farMask;
+                        farEnter.store(e.tEnter);
+                        t1.store(e.tExit);
+                    }
+                }
+
+                if (! exists[nearChild]) {
+                    break;
+                }
+                mask &= ((t0 <= nearExit) & (t0 <= D)).movemask();
+                n  = child[nearChild];
+                t1 = nearExit;
+            }
+        }
+    }
+
    /**
     Wrapper for a Handle; used to create a memberTable that acts like Table<Handle, Node*> but
     stores only Handle* internally to avoid memory copies.
@@ -881,22 +2011,47 @@ protected:
 
     Node*                   root;
 
+    /** Read-only copy of the tree created by pack(); empty when not
+        packed or when mapped. */
+    Array<PackedRecord>     packed;
+
+    /** Handles referenced by value records in packed */
+    Array<Handle*>          packedHandle;
+
+    /** Records traversed by queries, the first of which is the root:
+        packed.getCArray() after pack(), memory owned by the caller after
+        mapPacked(), and NULL otherwise. */
+    const PackedRecord*     packedRecord;
+
+    /** Members referenced by value records after mapPacked(); NULL otherwise */
+    const T*                mappedValue;
+    int                     numMappedValues;
+
 public:
 
     /** To construct a balanced tree, insert the elements and then call
       KDTree::balance(). */
-    KDTree() : root(NULL) {}
+    KDTree() : root(NULL), packedRecord(NULL), mappedValue(NULL), numMappedValues(0) {}
 
 
-    KDTree(const KDTree& src) : root(NULL) {
+    KDTree(const KDTree& src) : root(NULL), packedRecord(NULL), mappedValue(NULL), numMappedValues(0) {
         *this = src;
     }
 
 
     KDTree& operator=(const KDTree& src) {
+        unpack();
         delete root;
         // Clone tree takes care of filling out the memberTable.
-        root = cloneTree(src.root);
+        root = (src.root != NULL) ? cloneTree(src.root) : NULL;
+        if (src.isMapped()) {
+            // Share the caller's memory
+            packedRecord    = src.packedRecord;
+            mappedValue     = src.mappedValue;
+            numMappedValues = src.numMappedValues;
+        } else if (src.isPacked()) {
+            pack();
+        }
         return *this;
     }
 
@@ -920,6 +2075,7 @@ public:
             ++cur;
         }
         memberTable.clear();
+        unpack();
 
         // Delete the tree structure itself
         delete root;
@@ -927,7 +2083,7 @@ public:
     }
 
     int size() const {
-        return memberTable.size();
+        return isMapped() ? numMappedValues : memberTable.size();
     }
 
     /**
@@ -942,6 +2098,7 @@ public:
         }
 
         Handle* h = new Handle(value);
+        unpack();
 
         if (root == NULL) {
             // This is the first node; create a root node
@@ -953,6 +2110,8 @@ public:
         // Insert into the node
         node->valueArray.append(h);
         node->boundsArray.append(h->bounds);
+        h->inserted = true;
+        ++node->numInserted;
         
         // Insert into the node table
         Member m(h);
@@ -964,6 +2123,7 @@ public:
         than inserting each element in turn.  You still need to balance
         the tree at the end.*/
     void insert(const Array<T>& valueArray) {
+        unpack();
         if (root == NULL) {
             // Optimized case for an empty tree; don't bother
             // searching or reallocating the root node's valueArray
@@ -976,11 +2136,13 @@ public:
                 // data structure as if we inserted each (i.e., order is reversed
                 // from array).
                 Handle* h = new Handle(valueArray[i]);
+                h->inserted = true;
                 int j = valueArray.size() - i - 1;
                 root->valueArray[j] = h;
                 root->boundsArray[j] = h->bounds;
                 memberTable.set(Member(h), root);
             }
+            root->numInserted = root->valueArray.size();
 
         } else {
             // Insert at appropriate tree depth.
@@ -1017,11 +2179,14 @@ public:
             "Tried to remove an element from a "
             "KDTree that was not present");
 
+        unpack();
+
         // Get the list of elements at the node
         Handle h(value);
         Member m(&h);
 
-        Array<Handle*>& list = memberTable[m]->valueArray;
+        Node* node = memberTable[m];
+        Array<Handle*>& list = node->valueArray;
 
         Handle* ptr = NULL;
 
@@ -1036,7 +2201,10 @@ public:
                 list.fastRemove(i);
 
                 // Remove the corresponding bounds
-                memberTable[m]->boundsArray.fastRemove(i);
+                node->boundsArray.fastRemove(i);
+                if (ptr->inserted) {
+                    --node->numInserted;
+                }
                 break;
             }
         }
@@ -1051,8 +2219,8 @@ public:
 
 
     /**
-     If the element is in the set, it is removed.
-     The element is then inserted.
+     If the element is in the set, replaces the stored copy with value and
+     moves it to match its new bounds; otherwise, inserts it.
 
      This is useful when the == and hashCode methods
      on <I>T</I> are independent of the bounds.  In
@@ -1060,12 +2228,99 @@ public:
      element for the first time and call update(v)
      again every time it moves to keep the tree 
      up to date.
+
+     A member that is still inside the region of its node is refit in
+     place, moving down into a child if it now fits inside one.  Only a
+     member that has left its node is reinserted from the root.  Neither
+     case changes the splitting planes, so objects that move far from
+     where they were when the tree was balanced accumulate in nodes that
+     were not built for them; see degradation() and rebalanceDegraded().
      */
     void update(const T& value) {
-        if (contains(value)) {
-            remove(value);
+        Handle h(value);
+        Node** nodePtr = memberTable.getPointer(Member(&h));
+        if (nodePtr == NULL) {
+            insert(value);
+            return;
+        }
+
+        unpack();
+
+        Node* node = *nodePtr;
+        int i = 0;
+        while (! (*node->valueArray[i] == h)) {
+            ++i;
+            debugAssertM(i < node->valueArray.size(), "KDTree member missing from its node");
+        }
+
+        Handle* handle = node->valueArray[i];
+        handle->value = value;
+        handle->updateBounds();
+
+        Node* target = ((node == root) || node->cellContains(handle->bounds)) ?
+            node->findDeepestContainingNode(handle->bounds) :
+            root->findDeepestContainingNode(handle->bounds);
+
+        if (target == node) {
+            node->boundsArray[i] = handle->bounds;
+        } else {
+            node->valueArray.fastRemove(i);
+            node->boundsArray.fastRemove(i);
+            target->valueArray.append(handle);
+            target->boundsArray.append(handle->bounds);
+            if (handle->inserted) {
+                --node->numInserted;
+            }
+            handle->inserted = true;
+            ++target->numInserted;
+            *nodePtr = target;
+        }
+    }
+
+
+    /**
+     Fraction of the members that insert() or update() placed into nodes
+     that were built without them, rather than balance() or
+     rebalanceDegraded() placing them.  Zero immediately after balance()
+     and one before the first balance().  Query
+     performance falls as this rises, because those members were not
+     considered when the splitting planes were chosen.  O(number of nodes).
+     */
+    float degradation() const {
+        if (root == NULL) {
+            return 0.0f;
         }
-        insert(value);
+        int numValues = 0;
+        int inserted = 0;
+        root->countInserted(numValues, inserted);
+        return (numValues == 0) ? 0.0f : float(inserted) / float(numValues);
+    }
+
+
+    /**
+     Rebuilds only the parts of the tree that degradation() reports are
+     out of date: every largest subtree in which more than maxDegradation
+     of the members were placed by insert() or update() is rebalanced from
+     its own members, keeping the splitting planes above it.  Much faster
+     than balance() when only a few regions contain moving objects.
+
+     Takes O(number of nodes * depth) to find the subtrees in addition to
+     the cost of rebuilding them.  The remaining parameters are as for
+     balance().
+
+     @return The number of subtrees rebuilt.
+     */
+    int rebalanceDegraded(float maxDegradation = 0.25f, int valuesPerNode = 5, int numMeanSplits = 3, SplitHeuristic heuristic = MEDIAN_SPLIT) {
+        if (root == NULL) {
+            return 0;
+        }
+
+        unpack();
+        const BuildSettings settings(valuesPerNode, heuristic);
+        Array<Handle*> temp;
+        int numRebuilt = 0;
+        root = rebalanceDegraded(root, maxDegradation, numMeanSplits, settings, temp, numRebuilt);
+        return numRebuilt;
     }
 
 
@@ -1088,14 +2343,26 @@ public:
      setting a number of <B>mean</B> (average) splits.  numMeanSplits = MAX_INT
      creates a full oct-tree, which tends to optimize peak performance at the expense of
      average performance.  It tends to have better clustering behavior when
-     members are not uniformly distributed.
+     members are not uniformly distributed.  Ignored by SAH_SPLIT.
+
+     @param heuristic MEDIAN_SPLIT (the default) uses numMeanSplits as described above.
+     SAH_SPLIT builds a higher quality tree for ray queries at greater cost; use
+     getStatistics() to compare the results for particular content.
+
+     @param maxThreads Maximum number of threads used to build the tree.  Large
+     trees are built by splitting the top levels on all threads and then
+     building the remaining subtrees concurrently.  The resulting tree is
+     identical for every thread count.  Trees with fewer than 8192 members
+     are always built on the calling thread.
      */
-    void balance(int valuesPerNode = 5, int numMeanSplits = 3) {
+    void balance(int valuesPerNode = 5, int numMeanSplits = 3, SplitHeuristic heuristic = MEDIAN_SPLIT, int maxThreads = GThread::NUM_CORES) {
         if (root == NULL) {
             // Tree is empty
             return;
         }
 
+        unpack();
+
         // Get all handles and delete the old tree structure
         Node* oldRoot = root;
         for (int c = 0; c < 2; ++c) {
@@ -1108,11 +2375,33 @@ public:
             }
         }
 
+        if (maxThreads == GThread::NUM_CORES) {
+            maxThreads = GThread::numCores();
+        }
+
+        BuildSettings settings(valuesPerNode, heuristic);
+        Array<BuildTask> deferred;
+        if ((maxThreads > 1) && (size() >= PARALLEL_TREE_SIZE)) {
+            // Subtrees of about 1/8 of a thread's share are small enough to balance the load
+            // and large enough to amortize the scheduling
+            settings.numThreads = maxThreads;
+            settings.deferred   = &deferred;
+            settings.taskSize   = G3D::max(size() / (8 * maxThreads), 1024);
+        }
+
         Array<Handle*> temp;
         // Make a new root.  Work with a copy of the value array because 
         // makeNode clears the source array as it progresses
         Array<Handle*> copy(oldRoot->valueArray);
-        root = makeNode(copy, valuesPerNode, numMeanSplits, temp);
+        for (int i = 0; i < copy.size(); ++i) {
+            copy[i]->inserted = false;
+        }
+        root = makeNode(copy, numMeanSplits, settings, temp);
+
+        if (deferred.size() > 0) {
+            BuildWorker worker(this, deferred, settings);
+            GThread::runConcurrently2D(Vector2int32(0, 0), Vector2int32(1, G3D::min(maxThreads, deferred.size())), &worker, &BuildWorker::run, maxThreads);
+        }
 
         // Throw away the old root node
         delete oldRoot;
@@ -1132,16 +2421,233 @@ public:
     }
 
 
+    /**
+     Builds a read-only copy of the tree in one contiguous array of
+     32-byte records with the bounds of each node's members stored
+     next to the node.  While the tree is packed, intersectRay and
+     getIntersectingMembers traverse that array instead of the
+     heap-allocated nodes, which is substantially faster for large
+     static trees (e.g., level geometry).
+
+     Call after balance().  Any method that modifies the tree
+     (insert, remove, update, balance, clear, deserializeStructure)
+     discards the packed copy, so call pack() again after the last
+     modification.  Costs O(n) time and 32 bytes per node and member.
+     */
+    void pack() {
+        unpack();
+        if (root != NULL) {
+            packedHandle.reserve(size());
+            packNode(root);
+            packedRecord = packed.getCArray();
+        }
+    }
+
+    /** True if pack() has been called since the tree was last modified,
+        or if the tree was loaded with mapPacked(). */
+    bool isPacked() const {
+        return packedRecord != NULL;
+    }
+
+    /** True if the tree was loaded with mapPacked() and has not been
+        modified since. */
+    bool isMapped() const {
+        return mappedValue != NULL;
+    }
+
+
+    /**
+     Writes the packed form of the tree and a copy of every member in a
+     position-independent layout that mapPacked() can query in place, for
+     example from a memory-mapped file:
+
+     <pre>
+       header         64 bytes: magic, version, byte order, counts, offsets
+       records        one 32-byte record per node and per member
+       values         the members as a raw array of T
+     </pre>
+
+     Sections begin at multiples of 64 bytes from the start of the header,
+     records refer to one another and to values by index, and the data
+     are in the byte order of the writer.  T must be trivially copy
+     constructible and destructible, and must not contain pointers.
+
+     The tree must be packed.
+     */
+    void serializePacked(BinaryOutput& bo) const {
+        static_assert(std::is_trivially_copy_constructible<T>::value && std::is_trivially_destructible<T>::value,
+                      "KDTree::serializePacked requires a T that can be copied bytewise");
+        alwaysAssertM(isPacked(), "Call pack() before serializePacked()");
+        alwaysAssertM(sizeof(PackedRecord) == 32 && sizeof(PackedHeader) == PACKED_ALIGNMENT, "Unexpected packed record layout");
+
+        const int numRecords = packedRecord[0].node.subtreeEnd;
+        const int numValues  = size();
+
+        PackedHeader header;
+        System::memset(&header, 0, sizeof(header));
+        System::memcpy(header.magic, "G3DKDTR", 8);
+        header.version      = PACKED_FORMAT_VERSION;
+        header.byteOrder    = PACKED_BYTE_ORDER;
+        header.recordSize   = sizeof(PackedRecord);
+        header.valueSize    = sizeof(T);
+        header.numRecords   = numRecords;
+        header.numValues    = numValues;
+        header.recordOffset = alignPacked(sizeof(PackedHeader));
+        header.valueOffset  = alignPacked(header.recordOffset + uint64(numRecords) * sizeof(PackedRecord));
+        header.totalSize    = header.valueOffset + uint64(numValues) * sizeof(T);
+
+        static const uint8 zero[PACKED_ALIGNMENT] = {0};
+        bo.writeBytes(&header, sizeof(header));
+        bo.writeBytes(zero, size_t(header.recordOffset - sizeof(header)));
+        bo.writeBytes(packedRecord, numRecords * sizeof(PackedRecord));
+        bo.writeBytes(zero, size_t(header.valueOffset - header.recordOffset - numRecords * sizeof(PackedRecord)));
+        if (isMapped()) {
+            bo.writeBytes(mappedValue, numValues * sizeof(T));
+        } else {
+            for (int v = 0; v < numValues; ++v) {
+                bo.writeBytes(&packedHandle[v]->value, sizeof(T));
+            }
+        }
+    }
+
+    /**
+     Clears the tree and makes it a read-only view of data written by
+     serializePacked(), without copying or parsing the records or members.
+     Loading therefore costs only the page faults for the parts of the tree
+     that are actually traversed when data is a memory-mapped file, and
+     processes that map the same file share its pages.
+
+     data must remain valid and unmodified until the tree is cleared or
+     destroyed, and must be aligned for T.  The header and the links
+     between records are validated once, in O(n) time, so that queries
+     never index outside of data; throws a const char* and leaves the
+     tree empty if they are inconsistent.  Bounds and split planes are
+     not checked.
+
+     A mapped tree supports size(), pack state queries, intersectRay(),
+     intersectRayPacket(), intersectSegments(), getIntersectingMembers()
+     and serializePacked().  Members returned by getIntersectingMembers()
+     point into data and must not be modified.  Iteration, contains() and
+     getPointer() see an empty tree, and inserting into or removing from
+     the tree discards the mapping.
+     */
+    void mapPacked(const void* data, size_t numBytes) {
+        static_assert(std::is_trivially_copy_constructible<T>::value && std::is_trivially_destructible<T>::value,
+                      "KDTree::mapPacked requires a T that can be copied bytewise");
+        clear();
+
+        const uint8* bytes = static_cast<const uint8*>(data);
+        const PackedHeader* header = static_cast<const PackedHeader*>(data);
+        if ((numBytes < sizeof(PackedHeader)) || (memcmp(header->magic, "G3DKDTR", 8) != 0)) {
+            throw "Not a packed KDTree";
+        }
+        if (header->version != PACKED_FORMAT_VERSION) {
+            throw "Unsupported packed KDTree version";
+        }
+        if (header->byteOrder != PACKED_BYTE_ORDER) {
+            throw "Packed KDTree was written with a different byte order";
+        }
+        if ((header->recordSize != sizeof(PackedRecord)) || (header->valueSize != sizeof(T))) {
+            throw "Packed KDTree was written for a different member type";
+        }
+        // Each count is below 2^32, so none of these sums can overflow
+        if ((header->numRecords == 0) || (header->totalSize > numBytes) ||
+            (header->recordOffset < sizeof(PackedHeader)) || (header->recordOffset > header->valueOffset) ||
+            (header->recordOffset + uint64(header->numRecords) * sizeof(PackedRecord) > header->valueOffset) ||
+            (header->valueOffset > header->totalSize) ||
+            (header->valueOffset + uint64(header->numValues) * sizeof(T) > header->totalSize)) {
+            throw "Truncated or corrupt packed KDTree";
+        }
+        if ((size_t(bytes + header->recordOffset) % alignof(PackedRecord) != 0) ||
+            (size_t(bytes + header->valueOffset) % alignof(T) != 0) ||
+            (size_t(bytes) % alignof(PackedHeader) != 0)) {
+            throw "Packed KDTree data is misaligned";
+        }
+
+        const PackedRecord* record = reinterpret_cast<const PackedRecord*>(bytes + header->recordOffset);
+        validatePacked(record, header->numRecords, header->numValues);
+
+        packedRecord    = record;
+        mappedValue     = reinterpret_cast<const T*>(bytes + header->valueOffset);
+        numMappedValues = header->numValues;
+    }
+
+    /** Maps the packed tree at the current position of bi, which must be
+        held in memory and outlive the mapping, and skips past it.
+        \sa mapPacked(const void*, size_t) */
+    void mapPacked(BinaryInput& bi) {
+        const uint8* data = bi.getCArray() + bi.getPosition();
+        mapPacked(data, size_t(bi.size() - bi.getPosition()));
+        bi.skip(reinterpret_cast<const PackedHeader*>(data)->totalSize);
+    }
+
+
     /** Clear, set the contents to the values in the array, and then balance */
-    void setContents(const Array<T>& array, int valuesPerNode = 5, int numMeanSplits = 3) {
+    void setContents(const Array<T>& array, int valuesPerNode = 5, int numMeanSplits = 3, SplitHeuristic heuristic = MEDIAN_SPLIT, int maxThreads = GThread::NUM_CORES) {
         clear();
         insert(array);
-        balance(valuesPerNode, numMeanSplits);
+        balance(valuesPerNode, numMeanSplits, heuristic, maxThreads);
+    }
+
+
+    /** Computes shape and quality metrics for the current tree in O(n) time. */
+    void getStatistics(Statistics& stats) const {
+        stats = Statistics();
+        if ((root == NULL) || (size() == 0)) {
+            return;
+        }
+
+        Array<Handle*> all;
+        root->getHandles(all);
+        const AABox& bounds = computeBounds(all, 0, all.size() - 1);
+        const float area = bounds.area();
+
+        float sumLeafDepth = 0;
+        int   sumLeafValues = 0;
+        accumulateStatistics(root, bounds, (area > 0.0f) ? (1.0f / area) : 0.0f, 0, stats, sumLeafDepth, sumLeafValues);
+
+        stats.averageLeafDepth     = sumLeafDepth / stats.numLeaves;
+        stats.averageValuesPerLeaf = float(sumLeafValues) / stats.numLeaves;
     }
 
 
 protected:
 
+    /** Helper for getStatistics.  @param region node's split bounds clipped to the content bounds */
+    static void accumulateStatistics(
+        const Node*     node,
+        const AABox&    region,
+        float           invRootArea,
+        int             depth,
+        Statistics&     stats,
+        float&          sumLeafDepth,
+        int&            sumLeafValues) {
+
+        const int numValues = node->valueArray.size();
+        ++stats.numNodes;
+        stats.maxDepth         = max(stats.maxDepth, depth);
+        stats.maxValuesPerNode = max(stats.maxValuesPerNode, numValues);
+
+        // With a degenerate (flat) root region, weight every node as if it were always visited
+        const float p = (invRootArea > 0.0f) ? (region.area() * invRootArea) : 1.0f;
+        stats.expectedCost += p * (sahTraversalCost() + numValues);
+
+        if (node->isLeaf()) {
+            ++stats.numLeaves;
+            sumLeafDepth  += depth;
+            sumLeafValues += numValues;
+        } else {
+            stats.numInteriorValues += numValues;
+            AABox childRegion[2];
+            region.split(node->splitAxis, node->splitLocation, childRegion[0], childRegion[1]);
+            for (int c = 0; c < 2; ++c) {
+                if (node->child[c] != NULL) {
+                    accumulateStatistics(node->child[c], childRegion[c], invRootArea, depth + 1, stats, sumLeafDepth, sumLeafValues);
+                }
+            }
+        }
+    }
+
     /**
      @param parentMask The mask that this node returned from culledBy.
      */
@@ -1194,16 +2700,16 @@ public:
       @param members The results are appended to this array.
      */
     void getIntersectingMembers(const Array<Plane>& plane, Array<T*>& members) const {
-        if (root == NULL) {
-            return;
+        if (isPacked()) {
+            getIntersectingMembersPacked(plane, members);
+        } else if (root != NULL) {
+            getIntersectingMembers(plane, members, root, 0xFFFFFF);
         }
-
-        getIntersectingMembers(plane, members, root, 0xFFFFFF);
     }
 
     void getIntersectingMembers(const Array<Plane>& plane, Array<T>& members) const {
         Array<T*> temp;
-        getIntersectingMembers(plane, temp, root, 0xFFFFFF);
+        getIntersectingMembers(plane, temp);
         for (int i = 0; i < temp.size(); ++i) {
             members.append(*temp[i]);
         }
@@ -1432,10 +2938,11 @@ public:
      See also KDTree::beginBoxIntersection.
      */
     void getIntersectingMembers(const AABox& box, Array<T*>& members) const {
-        if (root == NULL) {
-            return;
+        if (isPacked()) {
+            getIntersectingMembersPacked(box, Sphere(Vector3::zero(), 0), members, false);
+        } else if (root != NULL) {
+            root->getIntersectingMembers(box, Sphere(Vector3::zero(), 0), members, false);
         }
-        root->getIntersectingMembers(box, Sphere(Vector3::zero(), 0), members, false);
     }
 
     void getIntersectingMembers(const AABox& box, Array<T>& members) const {
@@ -1504,6 +3011,8 @@ public:
       tested before the intersectCallback is invoked.  If the
       intersect callback runs at the same speed or faster than
       AABox-ray intersection, set this to true.
+
+     Uses the packed form of the tree if pack() has been called.
      */
     template<typename RayCallback>
     void intersectRay(
@@ -1511,8 +3020,145 @@ public:
         RayCallback& intersectCallback, 
         float& distance,
         bool intersectCallbackIsFast = false) const {
-        
-        root->intersectRay(ray, intersectCallback, distance, intersectCallbackIsFast);
+
+        if (isPacked()) {
+            intersectRayPacked(ray, intersectCallback, distance, intersectCallbackIsFast);
+        } else {
+            root->intersectRay(ray, intersectCallback, distance, intersectCallbackIsFast);
+        }
+    }
+
+
+    /** Number of rays traversed together by intersectRayPacket(): 8 when
+        compiled with AVX enabled and 4 otherwise. */
+    enum {RAY_PACKET_SIZE = RayPacketFloat::SIZE};
+
+    /**
+     Finds the first intersection of each of many rays, tracing groups of
+     RAY_PACKET_SIZE rays through the tree together using SIMD slab tests.
+     Equivalent to calling intersectRay() once per ray, but much faster for
+     bursts of rays that are coherent, e.g., line-of-sight tests from one
+     point to many targets.
+
+     The rays are grouped by the signs of their directions so that every
+     packet visits nodes in the same order.  Groups too small to fill half
+     of a packet are traced one ray at a time.  If the tree is not packed,
+     every ray is traced individually with intersectRay().
+
+     @param intersectCallback Either a function or an instance of a class
+     with an overloaded operator() of the form:
+     <pre>
+         void callback(int rayIndex, const Ray& ray, const T& object, float& distance).
+     </pre>
+     where <code>ray == rays[rayIndex]</code> and <code>distance</code> is
+     that ray's current distance, to be updated exactly as for intersectRay().
+     Calls for different rays are interleaved.
+
+     @param distance One element per ray.  On input, the maximum distance to
+     search along each ray; on return, the distance to its first intersection.
+
+     @param intersectCallbackIsFast See intersectRay().
+     */
+    template<typename RayPacketCallback>
+    void intersectRayPacket(
+        const Array<Ray>&   rays,
+        RayPacketCallback&  intersectCallback,
+        Array<float>&       distance,
+        bool                intersectCallbackIsFast = false) const {
+
+        alwaysAssertM(distance.size() == rays.size(), "Need one distance per ray");
+        if (! isPacked()) {
+            if (root == NULL) {
+                return;
+            }
+            for (int r = 0; r < rays.size(); ++r) {
+                RayIndexCallback<RayPacketCallback> callback(intersectCallback, r);
+                root->intersectRay(rays[r], callback, distance[r], intersectCallbackIsFast);
+            }
+            return;
+        }
+
+        // Counting sort of the ray indices by octant
+        int start[9];
+        System::memset(start, 0, sizeof(start));
+        for (int r = 0; r < rays.size(); ++r) {
+            ++start[rayOctant(rays[r]) + 1];
+        }
+        for (int o = 1; o < 9; ++o) {
+            start[o] += start[o - 1];
+        }
+
+        Array<int> order;
+        order.resize(rays.size());
+        {
+            int next[8];
+            System::memcpy(next, start, sizeof(next));
+            for (int r = 0; r < rays.size(); ++r) {
+                order[next[rayOctant(rays[r])]++] = r;
+            }
+        }
+
+        for (int o = 0; o < 8; ++o) {
+            int i = start[o];
+            const int end = start[o + 1];
+            for (; i + RAY_PACKET_SIZE <= end; i += RAY_PACKET_SIZE) {
+                intersectRayPacketPacked(rays, order.getCArray() + i, RAY_PACKET_SIZE,
+                                         intersectCallback, distance, intersectCallbackIsFast);
+            }
+
+            if (end - i >= RAY_PACKET_SIZE / 2) {
+                intersectRayPacketPacked(rays, order.getCArray() + i, end - i,
+                                         intersectCallback, distance, intersectCallbackIsFast);
+            } else {
+                intersectRaysSingly(rays, order.getCArray(), i, end,
+                                    intersectCallback, distance, intersectCallbackIsFast);
+            }
+        }
+    }
+
+
+    /**
+     Intersects a batch of line segments with the tree, e.g., all of one
+     frame's line-of-sight tests, using up to maxThreads threads.
+
+     @param intersectCallback As for intersectRay().  The ray passed to it
+     starts at <code>segment[i].point(0)</code> and has unit direction
+     towards <code>segment[i].point(1)</code>.  The callback is invoked
+     concurrently from several threads and must be thread-safe.
+
+     @param distance Resized to segment.size().  On return, element i is
+     the distance from <code>segment[i].point(0)</code> to an intersection
+     before <code>segment[i].point(1)</code>, or finf() if there is none.
+
+     @param anyHit If true, the search along each segment stops at the
+     first intersection found, which need not be the closest.  Use this
+     when only hit or miss matters.
+
+     Most efficient when the tree is packed, which is also the only case in
+     which anyHit stops the traversal itself rather than just the callbacks.
+     */
+    template<typename RayCallback>
+    void intersectSegments(
+        const Array<LineSegment>&   segment,
+        RayCallback&                intersectCallback,
+        Array<float>&               distance,
+        bool                        anyHit = true,
+        bool                        intersectCallbackIsFast = false,
+        int                         maxThreads = GThread::NUM_CORES) const {
+
+        distance.resize(segment.size());
+        SegmentWorker<RayCallback> worker(this, segment, intersectCallback, distance, anyHit, intersectCallbackIsFast);
+
+        if (maxThreads == GThread::NUM_CORES) {
+            maxThreads = GThread::numCores();
+        }
+        const int numThreads = G3D::min(maxThreads, SegmentWorker<RayCallback>::numChunks(segment.size()));
+
+        if (numThreads <= 1) {
+            worker.run(0, 0);
+        } else {
+            GThread::runConcurrently2D(Vector2int32(0, 0), Vector2int32(1, numThreads), &worker, &SegmentWorker<RayCallback>::run, numThreads);
+        }
     }
 
 
@@ -1523,13 +3169,13 @@ public:
       @param members The results are appended to this array.
      */
     void getIntersectingMembers(const Sphere& sphere, Array<T*>& members) const {
-        if (root == NULL) {
-            return;
-        }
-
         AABox box;
         sphere.getBounds(box);
-        root->getIntersectingMembers(box, sphere, members, true);
+        if (isPacked()) {
+            getIntersectingMembersPacked(box, sphere, members, true);
+        } else if (root != NULL) {
+            root->getIntersectingMembers(box, sphere, members, true);
+        }
     }
 
     void getIntersectingMembers(const Sphere& sphere, Array<T>& members) const {
@@ -13,6 +13,7 @@
 
 #include "G3D/platform.h"
 #include "G3D/ReferenceCount.h"
+#include "G3D/System.h"
 
 namespace G3D {
 
@@ -89,6 +90,81 @@ public:
     static CRTMemoryManager::Ref create();
 };
 
+
+/**
+   \brief Default allocation policy for G3D::Array, G3D::Table, G3D::Set, and
+   G3D::SmallArray.
+
+   Allocates directly with System::malloc.  This class has no state, so
+   containers that use it pay no space or reference counting cost for
+   their allocator.
+
+   \sa MemoryManagerAllocator
+ */
+class SystemAllocator {
+public:
+
+    void* alloc(size_t s) const {
+        return System::malloc(s);
+    }
+
+    void free(void* ptr) const {
+        System::free(ptr);
+    }
+
+    /** Returns the default MemoryManager, which also uses System::malloc */
+    MemoryManager::Ref memoryManager() const {
+        return MemoryManager::create();
+    }
+
+    bool operator==(const SystemAllocator&) const {
+        return true;
+    }
+};
+
+
+/**
+   \brief Allocation policy that forwards to a MemoryManager chosen at
+   runtime.
+
+   Containers must be instantiated with this policy to support
+   clearAndSetMemoryManager(), e.g., 
+   <code>Array<Vector3, 10, MemoryManagerAllocator></code>.  Each
+   container then holds a reference to its MemoryManager.
+
+   \sa SystemAllocator
+ */
+class MemoryManagerAllocator {
+private:
+
+    MemoryManager::Ref  m_memoryManager;
+
+public:
+
+    /** Uses the default MemoryManager */
+    MemoryManagerAllocator() : m_memoryManager(MemoryManager::create()) {}
+
+    void* alloc(size_t s) const {
+        return m_memoryManager->alloc(s);
+    }
+
+    void free(void* ptr) const {
+        m_memoryManager->free(ptr);
+    }
+
+    const MemoryManager::Ref& memoryManager() const {
+        return m_memoryManager;
+    }
+
+    void setMemoryManager(const MemoryManager::Ref& m) {
+        m_memoryManager = m;
+    }
+
+    bool operator==(const MemoryManagerAllocator& other) const {
+        return m_memoryManager == other.m_memoryManager;
+    }
+};
+
 }
 
 #endif
@@ -21,6 +21,7 @@
 #include "G3D/AABox.h"
 #include "G3D/Sphere.h"
 #include "G3D/SmallArray.h"
+#include <algorithm>
 
 namespace G3D {
 
@@ -106,8 +107,9 @@ private:
     };
 
     /** One cell of the grid. */
-    typedef SmallArray<Entry, expectedCellSize> Cell;
-    typedef Table<Point3int32, Cell >           CellTable;
+    typedef SmallArray<Entry, expectedCellSize, MemoryManagerAllocator> Cell;
+    typedef Table<Point3int32, Cell, HashTrait<Point3int32>, 
+                  EqualsTrait<Point3int32>, MemoryManagerAllocator> CellTable;
 
     /** The cube of +/-1 along each dimension. Initialized by initOffsetArray.*/
     Vector3int32        m_offsetArray[3*3*3];
@@ -178,6 +180,22 @@ private:
 
 public:
 
+    /** A value found by kNearest() and its squared distance from the query point */
+    class Neighbor {
+    public:
+        /** Points into the grid; invalidated when the grid is modified */
+        const Value*        value;
+        float               squaredDistance;
+
+        Neighbor() : value(NULL), squaredDistance(finf()) {}
+        Neighbor(const Value* v, float d) : value(v), squaredDistance(d) {}
+
+        /** Orders by distance */
+        bool operator<(const Neighbor& other) const {
+            return squaredDistance < other.squaredDistance;
+        }
+    };
+
     /** \brief Compute the grid cell index of a real position. 
         This is used extensively internally by PointHashGrid.
         It is useful to calling code to determine when an object
@@ -213,6 +231,100 @@ protected:
         m_offsetArray[i] = temp;
     }
 
+    /** Adds v to heap[0...heapSize - 1], a max-heap of the (at most k) nearest
+        neighbors found so far.  Once the heap is full, lowers maxSquaredDistance
+        to that of its farthest member. */
+    static void addNeighbor(const Value* v, float squaredDistance, int k, Neighbor* heap, int& heapSize, float& maxSquaredDistance) {
+        if (heapSize == k) {
+            std::pop_heap(heap, heap + heapSize);
+            --heapSize;
+        }
+        heap[heapSize] = Neighbor(v, squaredDistance);
+        ++heapSize;
+        std::push_heap(heap, heap + heapSize);
+
+        if (heapSize == k) {
+            maxSquaredDistance = heap[0].squaredDistance;
+        }
+    }
+
+    /** Squared distance from point to the nearest point of the cell at cellCoord */
+    float squaredDistanceToCell(const Point3& point, const Point3int32& cellCoord) const {
+        float d = 0.0f;
+        for (int a = 0; a < 3; ++a) {
+            const float lo = float(cellCoord[a]) * m_cellWidth;
+            const float t = G3D::max(G3D::max(lo - point[a], point[a] - (lo + m_cellWidth)), 0.0f);
+            d += t * t;
+        }
+        return d;
+    }
+
+    /** Offers every value in the cell at cellCoord (if it exists and could
+        be near enough) to the heap. */
+    void findNearestInCell(const Point3& point, const Point3int32& cellCoord, int k, Neighbor* heap, int& heapSize, float& maxSquaredDistance) const {
+        if (squaredDistanceToCell(point, cellCoord) > maxSquaredDistance) {
+            return;
+        }
+
+        const Cell* cell = m_data.getPointer(cellCoord);
+        if (cell != NULL) {
+            for (int j = 0; j < cell->size(); ++j) {
+                const Entry& entry = (*cell)[j];
+                const float d = (point - entry.position).squaredLength();
+                if ((d < maxSquaredDistance) || ((d == maxSquaredDistance) && (heapSize < k))) {
+                    addNeighbor(&entry.value, d, k, heap, heapSize, maxSquaredDistance);
+                }
+            }
+        }
+    }
+
+    /** Searches shells of cells of increasing radius around the cell
+        containing point until the remaining shells are farther than the
+        current bound or contain no data.  Once a shell would contain more
+        cells than the grid has non-empty cells, it scans the remaining
+        non-empty cells directly instead. */
+    void findNearest(const Point3& point, int k, Neighbor* heap, int& heapSize, float& maxSquaredDistance) const {
+        Point3int32 center, lo, hi;
+        getCellCoord(point, center);
+        getCellCoord(m_bounds.low(), lo);
+        getCellCoord(m_bounds.high(), hi);
+
+        // Radius beyond which no cell contains data
+        int maxRadius = 0;
+        for (int a = 0; a < 3; ++a) {
+            maxRadius = G3D::max(maxRadius, G3D::max(center[a] - lo[a], hi[a] - center[a]));
+        }
+
+        for (int r = 0; r <= maxRadius; ++r) {
+            // Cells in shell r are at least r - 1 cells away along some axis
+            if ((r > 1) && (square(float(r - 1) * m_cellWidth) > maxSquaredDistance)) {
+                return;
+            }
+
+            const double shellSize = (r == 0) ? 1.0 : 24.0 * r * r + 2.0;
+            if (shellSize > double(m_data.size())) {
+                for (typename CellTable::Iterator it = m_data.begin(); it.isValid(); ++it) {
+                    const Point3int32& c = it->key;
+                    const int ring = G3D::max(G3D::max(iAbs(c.x - center.x), iAbs(c.y - center.y)), iAbs(c.z - center.z));
+                    if (ring >= r) {
+                        findNearestInCell(point, c, k, heap, heapSize, maxSquaredDistance);
+                    }
+                }
+                return;
+            }
+
+            for (int z = -r; z <= r; ++z) {
+                for (int y = -r; y <= r; ++y) {
+                    // Interior rows of the shell only contribute their two end cells
+                    const bool fullRow = (r == 0) || (iAbs(z) == r) || (iAbs(y) == r);
+                    for (int x = -r; x <= r; x += fullRow ? 1 : 2 * r) {
+                        findNearestInCell(point, center + Point3int32(x, y, z), k, heap, heapSize, maxSquaredDistance);
+                    }
+                }
+            }
+        }
+    }
+
 public:
 
     /** 
@@ -844,6 +956,48 @@ public:
     }
 
 
+    /**
+     Finds the k values nearest to point that are at most maxDistance
+     from it by searching shells of cells of increasing radius around
+     point, stopping when the next shell is farther than the kth nearest
+     value found so far.  Fastest when the kth nearest value is within a
+     few radiusHint() of point.
+
+     @param neighbors Set to the values found, nearest first.  Its
+     storage is reused, so passing the same array to every call avoids
+     allocation.  The pointers are invalidated when the grid is modified.
+     */
+    void kNearest(const Point3& point, int k, Array<Neighbor>& neighbors, float maxDistance = finf()) const {
+        k = G3D::min(k, m_size);
+        if (k <= 0) {
+            neighbors.fastClear();
+            return;
+        }
+
+        neighbors.resize(k, DONT_SHRINK_UNDERLYING_ARRAY);
+        int numFound = 0;
+        float maxSquaredDistance = square(maxDistance);
+        findNearest(point, k, neighbors.getCArray(), numFound, maxSquaredDistance);
+        std::sort_heap(neighbors.begin(), neighbors.begin() + numFound);
+        neighbors.resize(numFound, DONT_SHRINK_UNDERLYING_ARRAY);
+    }
+
+
+    /** Returns the value nearest to point if it is at most maxDistance from
+        point and NULL otherwise.  The pointer is invalidated when the grid is modified. */
+    const Value* nearest(const Point3& point, float maxDistance = finf()) const {
+        if (m_size == 0) {
+            return NULL;
+        }
+
+        Neighbor neighbor;
+        int numFound = 0;
+        float maxSquaredDistance = square(maxDistance);
+        findNearest(point, 1, &neighbor, numFound, maxSquaredDistance);
+        return neighbor.value;
+    }
+
+
     ///////////////////////////////////////////////////////////////////////////
     ///////////////////////////////////////////////////////////////////////////
 
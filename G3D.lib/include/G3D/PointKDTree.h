@@ -100,9 +100,54 @@ template<class T,
          class HashFunc     = HashTrait<T>, 
          class EqualsFunc   = EqualsTrait<T> > 
 class PointKDTree {
+public:
+
+    /** A member found by kNearest() and its squared distance from the query point */
+    class Neighbor {
+    public:
+        /** Points into the tree; invalidated when the tree is modified */
+        const T*            value;
+        float               squaredDistance;
+
+        Neighbor() : value(NULL), squaredDistance(finf()) {}
+        Neighbor(const T* v, float d) : value(v), squaredDistance(d) {}
+
+        /** Orders by distance */
+        bool operator<(const Neighbor& other) const {
+            return squaredDistance < other.squaredDistance;
+        }
+    };
+
 protected:
 #define TreeType PointKDTree<T, PositionFunc, HashFunc, EqualsFunc>
 
+    /** Adds v to heap[0...heapSize - 1], a max-heap of the (at most k) nearest
+        neighbors found so far.  Once the heap is full, lowers maxSquaredDistance
+        to that of its farthest member. */
+    static void addNeighbor(const T* v, float squaredDistance, int k, Neighbor* heap, int& heapSize, float& maxSquaredDistance) {
+        if (heapSize == k) {
+            std::pop_heap(heap, heap + heapSize);
+            --heapSize;
+        }
+        heap[heapSize] = Neighbor(v, squaredDistance);
+        ++heapSize;
+        std::push_heap(heap, heap + heapSize);
+
+        if (heapSize == k) {
+            maxSquaredDistance = heap[0].squaredDistance;
+        }
+    }
+
+    /** Squared distance from point to the nearest point of box; zero inside it */
+    static float squaredDistance(const Vector3& point, const AABox& box) {
+        float d = 0.0f;
+        for (int a = 0; a < 3; ++a) {
+            const float t = G3D::max(G3D::max(box.low()[a] - point[a], point[a] - box.high()[a]), 0.0f);
+            d += t * t;
+        }
+        return d;
+    }
+
     // Unlike the KDTree, the PointKDTree assumes that T elements are
     // small and keeps the handle and cached position together instead of
     // placing them in separate bounds arrays.  Also note that a copy of T
@@ -391,6 +436,29 @@ protected:
             }
         }
 
+        /** Branch-and-bound search for the k nearest members within
+            maxSquaredDistance of point, accumulated in heap by addNeighbor().
+            Visits the child on point's side of the splitting plane first and
+            skips any child whose region is farther than the current bound. */
+        void findNearest(const Vector3& point, int k, Neighbor* heap, int& heapSize, float& maxSquaredDistance) const {
+            const int N = valueArray.size();
+            const Handle* handleArray = valueArray.getCArray();
+            for (int v = 0; v < N; ++v) {
+                const float d = (point - handleArray[v].position()).squaredLength();
+                if ((d < maxSquaredDistance) || ((d == maxSquaredDistance) && (heapSize < k))) {
+                    addNeighbor(&handleArray[v].value, d, k, heap, heapSize, maxSquaredDistance);
+                }
+            }
+
+            const int nearChild = (point[splitAxis] < splitLocation) ? 0 : 1;
+            for (int i = 0; i < 2; ++i) {
+                const Node* c = child[nearChild ^ i];
+                if ((c != NULL) && (squaredDistance(point, c->splitBounds) <= maxSquaredDistance)) {
+                    c->findNearest(point, k, heap, heapSize, maxSquaredDistance);
+                }
+            }
+        }
+
         /**
          Recurse through the tree, assigning splitBounds fields.
          */
@@ -1084,6 +1152,45 @@ public:
     }
 
 
+    /**
+     Finds the k members nearest to point that are at most maxDistance
+     from it, using a bounded max-heap and pruning subtrees that are
+     farther than the kth nearest member found so far.
+
+     @param neighbors Set to the members found, nearest first.  Its
+     storage is reused, so passing the same array to every call avoids
+     allocation.  The pointers are invalidated when the tree is modified.
+     */
+    void kNearest(const Vector3& point, int k, Array<Neighbor>& neighbors, float maxDistance = finf()) const {
+        k = G3D::min(k, int(size()));
+        if ((root == NULL) || (k <= 0)) {
+            neighbors.fastClear();
+            return;
+        }
+
+        neighbors.resize(k, DONT_SHRINK_UNDERLYING_ARRAY);
+        int numFound = 0;
+        float maxSquaredDistance = square(maxDistance);
+        root->findNearest(point, k, neighbors.getCArray(), numFound, maxSquaredDistance);
+        std::sort_heap(neighbors.begin(), neighbors.begin() + numFound);
+        neighbors.resize(numFound, DONT_SHRINK_UNDERLYING_ARRAY);
+    }
+
+    /** Returns the member nearest to point if it is at most maxDistance from
+        point and NULL otherwise.  The pointer is invalidated when the tree is modified. */
+    const T* nearest(const Vector3& point, float maxDistance = finf()) const {
+        if (root == NULL) {
+            return NULL;
+        }
+
+        Neighbor neighbor;
+        int numFound = 0;
+        float maxSquaredDistance = square(maxDistance);
+        root->findNearest(point, 1, &neighbor, numFound, maxSquaredDistance);
+        return neighbor.value;
+    }
+
+
     /**
       Stores the locations of the splitting planes (the structure but not the content)
       so that the tree can be quickly rebuilt from a previous configuration without 
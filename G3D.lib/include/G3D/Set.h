@@ -30,17 +30,18 @@ namespace G3D {
  */
 // There is not copy constructor or assignment operator defined because
 // the default ones are correct for Set.
-template<class T, class HashFunc = HashTrait<T>, class EqualsFunc = EqualsTrait<T> > 
+template<class T, class HashFunc = HashTrait<T>, class EqualsFunc = EqualsTrait<T>, class Allocator = SystemAllocator> 
 class Set {
 
     /**
      If an object is a member, it is contained in
      this table.
      */
-    Table<T, bool, HashFunc, EqualsFunc> memberTable;
+    Table<T, bool, HashFunc, EqualsFunc, Allocator> memberTable;
 
 public:
 
+    /** Only available when Allocator is MemoryManagerAllocator */
     void clearAndSetMemoryManager(const MemoryManager::Ref& m) {
         memberTable.clearAndSetMemoryManager(m);
     }
@@ -112,13 +113,13 @@ public:
      */
     class Iterator {
     private:
-        friend class Set<T>;
+        friend class Set<T, HashFunc, EqualsFunc, Allocator>;
 
         // Note: this is a Table iterator, we are currently defining
         // Set iterator
-        typename Table<T, bool>::Iterator it;
+        typename Table<T, bool, HashFunc, EqualsFunc, Allocator>::Iterator it;
 
-        Iterator(const typename Table<T, bool>::Iterator& it) : it(it) {}
+        Iterator(const typename Table<T, bool, HashFunc, EqualsFunc, Allocator>::Iterator& it) : it(it) {}
 
     public:
         inline bool operator!=(const Iterator& other) const {
@@ -18,8 +18,9 @@ namespace G3D {
 
 /** Embeds \a N elements to reduce allocation time and increase 
     memory coherence when working with arrays of arrays.
-    Offers a limited subset of the functionality of G3D::Array.*/
-template<class T, int N>
+    Offers a limited subset of the functionality of G3D::Array.
+    \a Allocator is the allocation policy for the elements beyond \a N.*/
+template<class T, int N, class Allocator = SystemAllocator>
 class SmallArray {
 private:
     int                 m_size;
@@ -28,7 +29,7 @@ private:
     T                   m_embedded[N];
 
     /** Remaining elements */
-    Array<T>            m_rest;
+    Array<T, 10, Allocator> m_rest;
 
 public:
 
@@ -47,7 +48,8 @@ public:
         resize(0, shrinkIfNecessary);
     }
 
-    void clearAndSetMemoryManager(MemoryManager::Ref& m) {
+    /** Only available when Allocator is MemoryManagerAllocator */
+    void clearAndSetMemoryManager(const MemoryManager::Ref& m) {
         clear();
         m_rest.clearAndSetMemoryManager(m);
     }
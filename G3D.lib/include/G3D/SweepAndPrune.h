@@ -0,0 +1,276 @@
+/**
+  \file G3D/SweepAndPrune.h
+
+  Incremental broadphase that tracks overlapping pairs of boxes.
+
+  \created 2026-10-18
+  \edited  2026-10-18
+ */
+
+#ifndef G3D_SweepAndPrune_h
+#define G3D_SweepAndPrune_h
+
+#include "G3D/platform.h"
+#include "G3D/Array.h"
+#include "G3D/SmallArray.h"
+#include "G3D/AABox.h"
+#include "G3D/Vector3.h"
+
+namespace G3D {
+
+/**
+ \brief Maintains the set of pairs of boxes that overlap, and reports
+ the pairs that began or stopped overlapping since the last query.
+
+ Each box is a <i>proxy</i> identified by the integer returned from
+ insert().  The minimum and maximum of every proxy along each sorted
+ axis are kept in sorted arrays.  update() moves the two endpoints of a
+ proxy to their new positions with insertion sort.  Because objects
+ move little from one frame to the next, each endpoint usually passes
+ only a few others, so updating every proxy once per frame costs about
+ O(n) plus the number of pairs that change.  Every swap of a minimum
+ with a maximum marks a pair whose overlap may have changed;
+ getChangedPairs() tests those pairs and reports the real changes.
+
+ Overlap is only tested along the sorted axes.  For objects on terrain
+ it is often better to sort on X and Z and ignore Y, which also halves
+ the work done by update().
+
+ Proxies inserted since the last getChangedPairs() are added to the
+ sorted arrays all at once: one at a time by insertion sort when there
+ are few, or by re-sorting and sweeping when there are many, so that
+ populating a level does not cost O(n^2).
+
+ Example:
+ <pre>
+   SweepAndPrune broadphase((1 << Vector3::X_AXIS) | (1 << Vector3::Z_AXIS));
+   int id = broadphase.insert(creature->aggroBounds());
+   ...
+   // Every tick
+   broadphase.update(id, creature->aggroBounds());
+   ...
+   broadphase.getChangedPairs(entered, left);
+ </pre>
+
+ \sa DynamicAABBTree, KDTree
+ */
+class SweepAndPrune {
+public:
+
+    /** Two proxies whose boxes overlap.  first < second. */
+    class Pair {
+    public:
+        int         first;
+        int         second;
+
+        Pair() : first(-1), second(-1) {}
+
+        Pair(int a, int b) : first(min(a, b)), second(max(a, b)) {}
+
+        bool operator==(const Pair& other) const {
+            return (first == other.first) && (second == other.second);
+        }
+
+        bool operator!=(const Pair& other) const {
+            return ! (*this == other);
+        }
+
+        size_t hashCode() const {
+            return size_t(first) * 2654435761u + size_t(second);
+        }
+    };
+
+    enum {ALL_AXES = (1 << Vector3::X_AXIS) | (1 << Vector3::Y_AXIS) | (1 << Vector3::Z_AXIS)};
+
+private:
+
+    enum {NONE = -1};
+
+    enum State {
+        /** In the endpoint arrays */
+        ACTIVE,
+
+        /** Inserted since the last getChangedPairs() and not yet sorted */
+        PENDING,
+
+        /** Removed since the last getChangedPairs(); the ID cannot be reused
+            until its pairs have been reported as removed */
+        REMOVED,
+
+        FREE
+    };
+
+    /** Minimum or maximum of one proxy along one axis */
+    class Endpoint {
+    public:
+        float       value;
+
+        /** (proxy << 1) | isMax */
+        int         data;
+
+        Endpoint() : value(0), data(0) {}
+
+        Endpoint(float v, int proxy, bool isMax) : value(v), data((proxy << 1) | (isMax ? 1 : 0)) {}
+
+        int proxy() const {
+            return data >> 1;
+        }
+
+        bool isMax() const {
+            return (data & 1) != 0;
+        }
+
+        /** Sort order.  At equal values minima come first, so that boxes
+            that touch are considered to overlap. */
+        bool operator<(const Endpoint& other) const {
+            return (value < other.value) ||
+                ((value == other.value) && ! isMax() && other.isMax());
+        }
+    };
+
+    class Proxy {
+    public:
+        AABox               bounds;
+
+        State               state;
+
+        /** Proxies that this one currently overlaps */
+        SmallArray<int, 6>  neighbor;
+
+        /** Position in the active list during a sweep */
+        int                 activeIndex;
+
+        Proxy() : state(FREE), activeIndex(NONE) {}
+
+        bool hasNeighbor(int other) const;
+
+        void removeNeighbor(int other);
+    };
+
+    /** Bit i is set if axis i is sorted */
+    int                 m_axisMask;
+
+    int                 m_numAxes;
+
+    /** The sorted axes */
+    int                 m_axis[3];
+
+    /** Sorted endpoints along each entry of m_axis.  May contain endpoints
+        of REMOVED proxies, which are dropped by getChangedPairs(). */
+    Array<Endpoint>     m_endpoint[3];
+
+    /** Element 2 * id + isMax is the index of that endpoint of proxy id in
+        m_endpoint[a].  Kept apart from Proxy because every swap updates
+        it, and a compact array stays in cache. */
+    Array<int>          m_endpointIndex[3];
+
+    Array<Proxy>        m_proxy;
+
+    int                 m_size;
+
+    /** IDs that can be reused by insert() */
+    Array<int>          m_freeList;
+
+    /** IDs to move to m_freeList by the next getChangedPairs() */
+    Array<int>          m_removedList;
+
+    Array<int>          m_pendingList;
+
+    /** Pairs whose overlap may have changed, possibly with duplicates */
+    Array<Pair>         m_candidate;
+
+    /** True if a and b overlap on every sorted axis */
+    bool overlaps(const AABox& a, const AABox& b) const {
+        for (int i = 0; i < m_numAxes; ++i) {
+            const int axis = m_axis[i];
+            if ((a.low()[axis] > b.high()[axis]) || (b.low()[axis] > a.high()[axis])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** Records the pair (id, other) after their endpoints swapped on one
+        axis, if its overlap may have changed.  \a begins is true if the
+        swap made their intervals on that axis overlap. */
+    void addCandidate(const Proxy& proxy, int id, int other, bool begins) {
+        const Proxy& otherProxy = m_proxy[other];
+        if (otherProxy.state == REMOVED) {
+            // Its pairs were recorded by remove()
+            return;
+        }
+        if (begins ? overlaps(proxy.bounds, otherProxy.bounds) : proxy.hasNeighbor(other)) {
+            m_candidate.append(Pair(id, other));
+        }
+    }
+
+    /** Moves endpoint i on sorted axis a to its place after its value
+        changed, recording a candidate pair for every minimum/maximum swap. */
+    void sortEndpoint(int a, int i);
+
+    /** Adds the PENDING proxies to the endpoint arrays */
+    void insertPending();
+
+    /** Re-sorts every axis and finds all overlaps that involve a PENDING
+        proxy with one sweep */
+    void insertPendingBySorting();
+
+    /** Drops the endpoints of REMOVED proxies */
+    void compactEndpoints();
+
+    void resetEndpointIndices(int a);
+
+public:
+
+    /**
+     \param axisMask Bit Vector3::X_AXIS, Vector3::Y_AXIS and/or
+     Vector3::Z_AXIS set for each axis along which to sort and test
+     overlap.  The first sorted axis is used for the sweep when many
+     proxies are inserted at once, so it should be the axis along which
+     the boxes are most spread out.
+     */
+    explicit SweepAndPrune(int axisMask = ALL_AXES);
+
+    /** Removes all proxies.  No pairs are reported as removed. */
+    void clear();
+
+    /** Number of proxies */
+    int size() const {
+        return m_size;
+    }
+
+    /** Adds a box and returns its ID.  Its pairs are reported by the next
+        getChangedPairs(). */
+    int insert(const AABox& bounds);
+
+    /** Moves a box.  Amortized O(1) when the box moves a short distance
+        relative to the spacing of the other boxes. */
+    void update(int id, const AABox& bounds);
+
+    /** Removes a box.  Its pairs are reported as removed by the next
+        getChangedPairs(), after which the ID may be reused by insert(). */
+    void remove(int id);
+
+    const AABox& bounds(int id) const {
+        debugAssert(id >= 0 && id < m_proxy.size());
+        return m_proxy[id].bounds;
+    }
+
+    /**
+     Appends the pairs that began overlapping since the last call to
+     \a added and the pairs that stopped overlapping to \a removed.  A pair
+     that began and stopped overlapping between calls is not reported.
+     */
+    void getChangedPairs(Array<Pair>& added, Array<Pair>& removed);
+
+    /** Appends all overlapping pairs as of the last getChangedPairs() */
+    void getPairs(Array<Pair>& pairs) const;
+
+    /** Appends the IDs of the proxies that overlapped \a id as of the last
+        getChangedPairs() */
+    void getOverlapping(int id, Array<int>& overlapping) const;
+};
+
+} // namespace G3D
+
+#endif
@@ -245,7 +245,9 @@ public:
        
        The result must be freed with free.
        
-       Threadsafe on Win32.
+       Threadsafe.  Each thread keeps a small cache of free buffers
+       that it exchanges with the shared pool in batches, so
+       concurrent allocations rarely contend for a lock.
        
        @sa calloc realloc OutOfMemoryCallback free
     */
@@ -260,7 +262,11 @@ public:
 
     /** Returns a string describing how well System::malloc is using
         its internal pooled storage.  "heap" memory was slow to
-        allocate; the other data sizes are comparatively fast.*/
+        allocate; the other data sizes are comparatively fast.  Also
+        reports how many allocations were served from per-thread
+        caches and how often those caches were refilled from and
+        flushed to the shared pool.  Counts from other threads are
+        included after at most a few hundred of their allocations. */
     static std::string mallocPerformance();
     static void resetMallocPerformanceCounters();
 
@@ -273,7 +279,7 @@ public:
     /**
      Free data allocated with System::malloc.
 
-     Threadsafe on Win32.
+     Threadsafe.
      */
     static void free(void* p);
 
@@ -297,6 +303,13 @@ public:
         one on some processors.  Guaranteed to have the same behavior as memset
         in all cases. */
     static void memset(void* dst, uint8 value, size_t numBytes);
+
+    /** Copies \a numElements values that are each \a elementSize bytes
+        (1, 2, 4, or 8) from \a src to \a dst, reversing the byte order of
+        each.  Used for reading and writing arrays in the opposite endian.
+        Uses SSE2 when available.  \a dst and \a src may be identical but
+        must not otherwise overlap. */
+    static void memcpyFlipEndian(void* dst, const void* src, size_t elementSize, size_t numElements);
     
     /**
      Returns the fully qualified filename for the currently running executable.
@@ -96,9 +96,13 @@ namespace G3D {
   Periodically check that debugGetLoad() is low (> 0.1).  When it gets near
   1.0 your hash function is badly designed and maps too many inputs to
   the same output.
+
+  The Allocator template parameter is the allocation policy for nodes and
+  buckets; see G3D::SystemAllocator and G3D::MemoryManagerAllocator.  Only
+  tables that use MemoryManagerAllocator support clearAndSetMemoryManager().
  */
-template<class Key, class Value, class HashFunc = HashTrait<Key>, class EqualsFunc = EqualsTrait<Key> > 
-class Table {
+template<class Key, class Value, class HashFunc = HashTrait<Key>, class EqualsFunc = EqualsTrait<Key>, class Allocator = SystemAllocator> 
+class Table : private Allocator {
 public:
 
     /**
@@ -117,7 +121,7 @@ public:
 
 private:
 
-    typedef Table<Key, Value, HashFunc, EqualsFunc> ThisType;
+    typedef Table<Key, Value, HashFunc, EqualsFunc, Allocator> ThisType;
 
     /**
      Linked list nodes used internally by HashTable.
@@ -143,25 +147,25 @@ private:
 
     public:
 
-        static Node* create(const Key& k, const Value& v, size_t h, Node* n, MemoryManager::Ref& mm) {
-            Node* node = (Node*)mm->alloc(sizeof(Node));
+        static Node* create(const Key& k, const Value& v, size_t h, Node* n, const Allocator& mm) {
+            Node* node = (Node*)mm.alloc(sizeof(Node));
             return new (node) Node(k, v, h, n);
         }
 
-        static Node* create(const Key& k, size_t hashCode, Node* n, MemoryManager::Ref& mm) {
-            Node* node = (Node*)mm->alloc(sizeof(Node));
+        static Node* create(const Key& k, size_t hashCode, Node* n, const Allocator& mm) {
+            Node* node = (Node*)mm.alloc(sizeof(Node));
             return new (node) Node(k, hashCode, n);
         }
 
-        static void destroy(Node* n, MemoryManager::Ref& mm) {
+        static void destroy(Node* n, const Allocator& mm) {
             n->~Node();
-            mm->free(n);
+            mm.free(n);
         }
 
         /**
         Clones a whole chain;
         */
-        Node* clone(MemoryManager::Ref& mm) {
+        Node* clone(const Allocator& mm) {
            return create(this->entry.key, this->entry.value, hashCode, (next == NULL) ? NULL : next->clone(mm), mm);
         }
     };
@@ -196,14 +200,22 @@ private:
      */
     size_t              m_numBuckets;
 
-    MemoryManager::Ref  m_memoryManager;
+    /** The allocation policy is a private base class so that a stateless
+        policy takes no space */
+    Allocator& allocator() {
+        return *this;
+    }
+
+    const Allocator& allocator() const {
+        return *this;
+    }
 
     void* alloc(size_t s) const {
-        return m_memoryManager->alloc(s);
+        return allocator().alloc(s);
     }
 
     void free(void* p) const {
-        return m_memoryManager->free(p);
+        return allocator().free(p);
     }
 
     /**
@@ -262,7 +274,7 @@ private:
 
         for (size_t b = 0; b < m_numBuckets; ++b) {
             if (h.m_bucket[b] != NULL) {
-                m_bucket[b] = h.m_bucket[b]->clone(m_memoryManager);
+                m_bucket[b] = h.m_bucket[b]->clone(allocator());
             } else {
                 m_bucket[b] = NULL;
             }
@@ -281,7 +293,7 @@ private:
             Node* node = m_bucket[b];
             while (node != NULL) {
                 Node* next = node->next;
-                Node::destroy(node, m_memoryManager);
+                Node::destroy(node, allocator());
                 node = next;
             }
             m_bucket[b] = NULL;
@@ -295,21 +307,21 @@ private:
 public:
 
     /**
-     Creates an empty hash table using the default MemoryManager.
+     Creates an empty hash table using a default-constructed Allocator.
      */
     Table() : m_bucket(NULL) {
-        m_memoryManager = MemoryManager::create();
         m_numBuckets = 0;
         m_size       = 0;
         m_bucket     = NULL;
         checkIntegrity();
     }
 
-    /** Changes the internal memory manager to m */
+    /** Changes the internal memory manager to m. Only available when
+        Allocator is MemoryManagerAllocator. */
     void clearAndSetMemoryManager(const MemoryManager::Ref& m) {
         clear();
         debugAssert(m_bucket == NULL);
-        m_memoryManager = m;
+        allocator().setMemoryManager(m);
     }
 
     /** 
@@ -332,9 +344,8 @@ public:
         freeMemory();
     }
 
-    /** Uses the default memory manager */
+    /** Uses a default-constructed Allocator */
     Table(const ThisType& h) {
-        m_memoryManager = MemoryManager::create();
         m_numBuckets = 0;
         m_size = 0;
         m_bucket = NULL;
@@ -415,7 +426,7 @@ public:
      */
     class Iterator {
     private:
-        friend class Table<Key, Value, HashFunc, EqualsFunc>;
+        friend class Table<Key, Value, HashFunc, EqualsFunc, Allocator>;
 
         /**
          Bucket index.
@@ -637,7 +648,7 @@ private:
                   removedValue = n->entry.value;
               }
               // Delete the node
-              Node::destroy(n, m_memoryManager);
+              Node::destroy(n, allocator());
               --m_size;
 
               //checkIntegrity();
@@ -784,7 +795,7 @@ public:
 
         // No m_bucket, so this must be the first
         if (n == NULL) {
-            m_bucket[b] = Node::create(key, code, NULL, m_memoryManager);
+            m_bucket[b] = Node::create(key, code, NULL, allocator());
             ++m_size;
             created = true;
             //checkIntegrity();
@@ -843,7 +854,7 @@ public:
 
         // Not found; insert at the head.
         b = code % m_numBuckets;
-        m_bucket[b] = Node::create(key, code, m_bucket[b], m_memoryManager);
+        m_bucket[b] = Node::create(key, code, m_bucket[b], allocator());
         ++m_size;
         created = true;
 
@@ -0,0 +1,306 @@
+/**
+  \file G3D/TriangleBlock.h
+
+  Groups of triangles laid out for testing against a ray with SIMD.
+
+  \created 2026-10-18
+  \edited  2026-10-18
+ */
+
+#ifndef G3D_TriangleBlock_h
+#define G3D_TriangleBlock_h
+
+#include "G3D/platform.h"
+#include "G3D/Array.h"
+#include "G3D/Vector3.h"
+#include "G3D/Triangle.h"
+#include "G3D/Ray.h"
+#include "G3D/FastRay.h"
+#include "G3D/Float4.h"
+#include "G3D/Float8.h"
+#include "G3D/Vector3xN.h"
+
+namespace G3D {
+
+/**
+ \brief Float::SIZE triangles stored as structure-of-arrays vertices and
+ edges, for one-ray-against-many intersection tests.
+
+ intersect() performs the same one-sided Moller-Trumbore test as
+ Ray::intersectionTime(vert0, vert1, vert2) on every triangle of the
+ block at once and returns the closest hit.  The edges are precomputed
+ when the block is built, so a leaf of a spatial data structure can
+ store its triangles as an Array of blocks and test them with one call
+ per block instead of one per triangle.
+
+ Lanes past count() hold degenerate triangles that are never hit.
+
+ The data are kept as plain float arrays and read with unaligned loads,
+ so blocks may be stored in Array and other containers that do not
+ guarantee SIMD alignment.
+
+ <pre>
+   Array<TriangleBlock4> blocks;
+   TriangleBlock4::pack(triangles, blocks);
+   ...
+   float distance = maxDistance;
+   int   hit = -1;
+   float w0, w1, w2;
+   for (int b = 0; b < blocks.size(); ++b) {
+       const int i = blocks[b].intersect(ray, distance, w0, w1, w2);
+       if (i != -1) {
+           hit = b * TriangleBlock4::SIZE + i;
+       }
+   }
+ </pre>
+
+ \sa TriangleBlock4, TriangleBlock8, Triangle, Ray
+ */
+template<class Float>
+class TriangleBlockN {
+public:
+    enum {SIZE = Float::SIZE};
+
+private:
+
+    typedef Vector3xN<Float> Vector3N;
+
+    /** Component-major: m_vertex0[axis][lane] */
+    float           m_vertex0[3][SIZE];
+    float           m_edge01[3][SIZE];
+    float           m_edge02[3][SIZE];
+
+    int             m_count;
+
+    static Vector3N load(const float data[3][SIZE]) {
+        return Vector3N(Float::load(data[0]), Float::load(data[1]), Float::load(data[2]));
+    }
+
+    static void store(float data[3][SIZE], int i, const Vector3& v) {
+        data[0][i] = v.x;
+        data[1][i] = v.y;
+        data[2][i] = v.z;
+    }
+
+    /** Computes the hit mask, distances, and barycentrics of every lane.
+        Only lanes hit at distances in [minDistance, maxDistance) are set in
+        the returned mask. */
+    Float intersectLanes(const Point3& rayOrigin, const Vector3& rayDirection, float minDistance,
+                         float maxDistance, Float& t, Float& u, Float& v) const {
+        static const float EPSILON = 0.000001f;
+
+        const Vector3N direction(rayDirection);
+        const Vector3N edge01 = load(m_edge01);
+        const Vector3N edge02 = load(m_edge02);
+
+        // If the determinant is near zero, the ray lies in the plane of the
+        // triangle; if it is negative, the ray hits the back face
+        const Vector3N p = direction.cross(edge02);
+        const Float det = edge01.dot(p);
+
+        const Vector3N s = Vector3N(rayOrigin) - load(m_vertex0);
+        u = s.dot(p);
+
+        const Vector3N q = s.cross(edge01);
+        v = direction.dot(q);
+        t = edge02.dot(q);
+
+        const Float zero = Float::zero();
+        Float hit = (det >= Float(EPSILON)) &
+            (u >= zero) & (u <= det) &
+            (v >= zero) & (u + v <= det) &
+            (t >= Float(minDistance) * det);
+
+        if (! hit.any()) {
+            return hit;
+        }
+
+        const Float invDet = Float(1.0f) / det;
+        t = t * invDet;
+        u = u * invDet;
+        v = v * invDet;
+
+        return hit & (t < Float(maxDistance));
+    }
+
+    int intersect(const Point3& origin, const Vector3& direction, float minDistance,
+                  float& distance, float& w0, float& w1, float& w2) const {
+        Float t, u, v;
+        const Float hit = intersectLanes(origin, direction, minDistance, distance, t, u, v);
+        const int i = closestLane(hit, t);
+        if (i != -1) {
+            distance = t[i];
+            w1 = u[i];
+            w2 = v[i];
+            w0 = 1.0f - w1 - w2;
+        }
+        return i;
+    }
+
+    /** Index of the set lane of hit with the smallest t, or -1 */
+    static int closestLane(const Float& hit, const Float& t) {
+        int mask = hit.movemask();
+        if (mask == 0) {
+            return -1;
+        }
+
+        float time[SIZE];
+        t.store(time);
+
+        int best = -1;
+        float bestTime = finf();
+        for (int i = 0; mask != 0; ++i, mask >>= 1) {
+            if ((mask & 1) && (time[i] < bestTime)) {
+                bestTime = time[i];
+                best = i;
+            }
+        }
+        return best;
+    }
+
+public:
+
+    /** An empty block */
+    TriangleBlockN() : m_count(0) {
+        for (int a = 0; a < 3; ++a) {
+            for (int i = 0; i < SIZE; ++i) {
+                m_vertex0[a][i] = 0.0f;
+                m_edge01[a][i]  = 0.0f;
+                m_edge02[a][i]  = 0.0f;
+            }
+        }
+    }
+
+    /** Number of triangles in the block */
+    int count() const {
+        return m_count;
+    }
+
+    bool full() const {
+        return m_count == SIZE;
+    }
+
+    /** Sets lane i, which must be less than or equal to count() */
+    void set(int i, const Point3& v0, const Point3& v1, const Point3& v2) {
+        debugAssert(i >= 0 && i <= m_count && i < SIZE);
+        store(m_vertex0, i, v0);
+        store(m_edge01, i, v1 - v0);
+        store(m_edge02, i, v2 - v0);
+        m_count = G3D::max(m_count, i + 1);
+    }
+
+    void set(int i, const Triangle& triangle) {
+        set(i, triangle.vertex(0), triangle.vertex(1), triangle.vertex(2));
+    }
+
+    /** Adds a triangle to the end of a block that is not full() */
+    void append(const Point3& v0, const Point3& v1, const Point3& v2) {
+        debugAssertM(! full(), "TriangleBlock is full");
+        set(m_count, v0, v1, v2);
+    }
+
+    void append(const Triangle& triangle) {
+        append(triangle.vertex(0), triangle.vertex(1), triangle.vertex(2));
+    }
+
+    /** Vertex j of triangle i */
+    Point3 vertex(int i, int j) const {
+        debugAssert(i >= 0 && i < m_count && j >= 0 && j < 3);
+        const Point3 v0(m_vertex0[0][i], m_vertex0[1][i], m_vertex0[2][i]);
+        switch (j) {
+        case 0:
+            return v0;
+        case 1:
+            return v0 + Vector3(m_edge01[0][i], m_edge01[1][i], m_edge01[2][i]);
+        default:
+            return v0 + Vector3(m_edge02[0][i], m_edge02[1][i], m_edge02[2][i]);
+        }
+    }
+
+    /**
+     Finds the closest front-face hit of \a ray that is closer than \a
+     distance.  On a hit, sets \a distance and returns the index of the
+     triangle within the block; otherwise returns -1 and leaves \a
+     distance unchanged.  Pass finf() as the distance to find any hit.
+     */
+    int intersect(const Ray& ray, float& distance) const {
+        float w0, w1, w2;
+        return intersect(ray.origin(), ray.direction(), 0.0f, distance, w0, w1, w2);
+    }
+
+    /**
+     Like intersect(ray, distance), and also sets the weights of
+     vertices 0, 1, and 2 at the hit point, as
+     Ray::intersectionTime(vert0, vert1, vert2, w0, w1, w2) does.
+     */
+    int intersect(const Ray& ray, float& distance, float& w0, float& w1, float& w2) const {
+        return intersect(ray.origin(), ray.direction(), 0.0f, distance, w0, w1, w2);
+    }
+
+    /**
+     Finds the closest hit of \a ray within its distance interval.  On a
+     hit, shortens the interval to end at the hit, so that testing
+     further blocks with the same ray finds only closer hits, and
+     returns the index of the triangle within the block; otherwise
+     returns -1.
+     */
+    int intersect(FastRay& ray, float& w0, float& w1, float& w2) const {
+        float distance = ray.maxDistance();
+        const int i = intersect(ray.origin(), ray.direction(), ray.minDistance(), distance, w0, w1, w2);
+        if (i != -1) {
+            ray.setMaxDistance(distance);
+        }
+        return i;
+    }
+
+    int intersect(FastRay& ray) const {
+        float w0, w1, w2;
+        return intersect(ray, w0, w1, w2);
+    }
+
+    /** True if \a ray hits any triangle closer than \a distance.  Cheaper
+        than intersect() for shadow and line-of-sight tests. */
+    bool intersectsAny(const Ray& ray, float distance) const {
+        Float t, u, v;
+        return intersectLanes(ray.origin(), ray.direction(), 0.0f, distance, t, u, v).any();
+    }
+
+    /** True if \a ray hits any triangle within its distance interval */
+    bool intersectsAny(const FastRay& ray) const {
+        Float t, u, v;
+        return intersectLanes(ray.origin(), ray.direction(), ray.minDistance(), ray.maxDistance(), t, u, v).any();
+    }
+
+    /** Appends blocks holding \a triangles in order, so that triangle i
+        is lane i % SIZE of block i / SIZE. */
+    static void pack(const Array<Triangle>& triangles, Array<TriangleBlockN>& blocks) {
+        for (int i = 0; i < triangles.size(); ++i) {
+            if ((i % SIZE) == 0) {
+                blocks.append(TriangleBlockN());
+            }
+            blocks.last().append(triangles[i]);
+        }
+    }
+
+    /** Appends blocks holding the indexed triangles (index[3i], index[3i + 1],
+        index[3i + 2]), in order. */
+    static void pack(const Array<Point3>& vertex, const Array<int>& index, Array<TriangleBlockN>& blocks) {
+        debugAssert(index.size() % 3 == 0);
+        for (int i = 0; i < index.size(); i += 3) {
+            if (((i / 3) % SIZE) == 0) {
+                blocks.append(TriangleBlockN());
+            }
+            blocks.last().append(vertex[index[i]], vertex[index[i + 1]], vertex[index[i + 2]]);
+        }
+    }
+};
+
+/** Four triangles tested with SSE.  \sa TriangleBlockN */
+typedef TriangleBlockN<Float4> TriangleBlock4;
+
+/** Eight triangles tested with AVX.  \sa TriangleBlockN */
+typedef TriangleBlockN<Float8> TriangleBlock8;
+
+} // namespace G3D
+
+#endif
@@ -0,0 +1,298 @@
+/**
+  \file G3D/Vector3xN.h
+
+  Structure-of-arrays vectors that hold several Vector3s in SIMD registers.
+
+  \created 2026-10-18
+  \edited  2026-10-18
+ */
+
+#ifndef G3D_Vector3xN_h
+#define G3D_Vector3xN_h
+
+#include "G3D/platform.h"
+#include "G3D/Vector3.h"
+#include "G3D/Array.h"
+#include "G3D/Float4.h"
+#include "G3D/Float8.h"
+
+#ifdef G3D_AVX
+#   include <immintrin.h>
+#endif
+
+namespace G3D {
+
+namespace _internal {
+
+static_assert(sizeof(Vector3) == 3 * sizeof(float), "Vector3 must be three packed floats");
+
+/** Transposes SIZE consecutive Vector3s into lanes.  Unaligned. */
+inline void loadVector3s(const Vector3* v, Float4& x, Float4& y, Float4& z) {
+#   ifdef G3D_SSE2
+        // a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+        const float* p = &v[0].x;
+        const __m128 a = _mm_loadu_ps(p);
+        const __m128 b = _mm_loadu_ps(p + 4);
+        const __m128 c = _mm_loadu_ps(p + 8);
+
+        const __m128 bc = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));   // x2 x2 x3 x3
+        x = _mm_shuffle_ps(a, bc, _MM_SHUFFLE(2, 0, 3, 0));
+
+        const __m128 ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));   // y0 y0 y1 y1
+        const __m128 cb = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));   // y2 y2 y3 y3
+        y = _mm_shuffle_ps(ab, cb, _MM_SHUFFLE(2, 0, 2, 0));
+
+        const __m128 az = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));   // z0 z0 z1 z1
+        z = _mm_shuffle_ps(az, c, _MM_SHUFFLE(3, 0, 2, 0));
+#   else
+        x = Float4(v[0].x, v[1].x, v[2].x, v[3].x);
+        y = Float4(v[0].y, v[1].y, v[2].y, v[3].y);
+        z = Float4(v[0].z, v[1].z, v[2].z, v[3].z);
+#   endif
+}
+
+/** Inverse of loadVector3s() */
+inline void storeVector3s(Vector3* v, const Float4& x, const Float4& y, const Float4& z) {
+#   ifdef G3D_SSE2
+        float* p = &v[0].x;
+        const __m128 xy0 = _mm_shuffle_ps(x.v, y.v, _MM_SHUFFLE(0, 0, 0, 0));  // x0 x0 y0 y0
+        const __m128 zx0 = _mm_shuffle_ps(z.v, x.v, _MM_SHUFFLE(1, 1, 0, 0));  // z0 z0 x1 x1
+        _mm_storeu_ps(p, _mm_shuffle_ps(xy0, zx0, _MM_SHUFFLE(2, 0, 2, 0)));
+
+        const __m128 yz1 = _mm_shuffle_ps(y.v, z.v, _MM_SHUFFLE(1, 1, 1, 1));  // y1 y1 z1 z1
+        const __m128 xy2 = _mm_shuffle_ps(x.v, y.v, _MM_SHUFFLE(2, 2, 2, 2));  // x2 x2 y2 y2
+        _mm_storeu_ps(p + 4, _mm_shuffle_ps(yz1, xy2, _MM_SHUFFLE(2, 0, 2, 0)));
+
+        const __m128 zx3 = _mm_shuffle_ps(z.v, x.v, _MM_SHUFFLE(3, 3, 2, 2));  // z2 z2 x3 x3
+        const __m128 yz3 = _mm_shuffle_ps(y.v, z.v, _MM_SHUFFLE(3, 3, 3, 3));  // y3 y3 z3 z3
+        _mm_storeu_ps(p + 8, _mm_shuffle_ps(zx3, yz3, _MM_SHUFFLE(2, 0, 2, 0)));
+#   else
+        for (int i = 0; i < 4; ++i) {
+            v[i] = Vector3(x[i], y[i], z[i]);
+        }
+#   endif
+}
+
+inline void loadVector3s(const Vector3* v, Float8& x, Float8& y, Float8& z) {
+    Float4 x0, y0, z0, x1, y1, z1;
+    loadVector3s(v, x0, y0, z0);
+    loadVector3s(v + 4, x1, y1, z1);
+#   ifdef G3D_AVX
+        x = _mm256_insertf128_ps(_mm256_castps128_ps256(x0.v), x1.v, 1);
+        y = _mm256_insertf128_ps(_mm256_castps128_ps256(y0.v), y1.v, 1);
+        z = _mm256_insertf128_ps(_mm256_castps128_ps256(z0.v), z1.v, 1);
+#   else
+        x = Float8(x0, x1);
+        y = Float8(y0, y1);
+        z = Float8(z0, z1);
+#   endif
+}
+
+inline void storeVector3s(Vector3* v, const Float8& x, const Float8& y, const Float8& z) {
+#   ifdef G3D_AVX
+        storeVector3s(v,
+            Float4(_mm256_castps256_ps128(x.v)),
+            Float4(_mm256_castps256_ps128(y.v)),
+            Float4(_mm256_castps256_ps128(z.v)));
+        storeVector3s(v + 4,
+            Float4(_mm256_extractf128_ps(x.v, 1)),
+            Float4(_mm256_extractf128_ps(y.v, 1)),
+            Float4(_mm256_extractf128_ps(z.v, 1)));
+#   else
+        storeVector3s(v, x.lo, y.lo, z.lo);
+        storeVector3s(v + 4, x.hi, y.hi, z.hi);
+#   endif
+}
+
+// Forwarders so that Vector3xN's min() and max() members can reach the
+// lane-wise friends of Float4 and Float8 by argument-dependent lookup
+template<class F> inline F laneMin(const F& a, const F& b) { return min(a, b); }
+template<class F> inline F laneMax(const F& a, const F& b) { return max(a, b); }
+template<class F> inline F laneSelect(const F& m, const F& a, const F& b) { return select(m, a, b); }
+
+} // namespace _internal
+
+
+/**
+ \brief Float::SIZE Vector3s stored as one SIMD vector per axis.
+
+ Lets kernels such as distance checks, transforms and culling process
+ four (Vector3x4) or eight (Vector3x8) points per instruction.  Write
+ the kernel once as a template over the Vector3xN type to run it at
+ either width.  The methods mirror those of Vector3 but operate on every
+ lane, and comparisons produce Float masks for select().
+
+ Use load() and store() to convert between lanes and Array<Vector3>;
+ they handle a partial final group at the end of the array.
+
+ <pre>
+   // Flags the points within radius of center
+   const Vector3x4 c(center);
+   const Float4 r2(square(radius));
+   for (int i = 0; i < points.size(); i += Vector3x4::SIZE) {
+       const Vector3x4 p = Vector3x4::load(points, i);
+       const int inside = ((p - c).squaredLength() <= r2).movemask();
+       ...
+   }
+ </pre>
+
+ \sa Vector3x4, Vector3x8, Float4, Float8
+ */
+template<class Float>
+class Vector3xN {
+public:
+    enum {SIZE = Float::SIZE};
+
+    Float           x;
+    Float           y;
+    Float           z;
+
+    /** Uninitialized */
+    Vector3xN() {}
+
+    Vector3xN(const Float& x, const Float& y, const Float& z) : x(x), y(y), z(z) {}
+
+    /** Broadcasts v to every lane */
+    explicit Vector3xN(const Vector3& v) : x(v.x), y(v.y), z(v.z) {}
+
+    static Vector3xN zero() {
+        return Vector3xN(Float::zero(), Float::zero(), Float::zero());
+    }
+
+    /** Reads SIZE consecutive Vector3s */
+    static Vector3xN load(const Vector3* v) {
+        Vector3xN r;
+        _internal::loadVector3s(v, r.x, r.y, r.z);
+        return r;
+    }
+
+    /** Reads the first count (at most SIZE) Vector3s and fills the remaining
+        lanes with the last of them, so that padding lanes produce the same
+        results as a real element rather than zeros or NaNs. */
+    static Vector3xN load(const Vector3* v, int count) {
+        debugAssert(count > 0);
+        if (count >= SIZE) {
+            return load(v);
+        }
+        Vector3 temp[SIZE];
+        for (int i = 0; i < SIZE; ++i) {
+            temp[i] = v[G3D::min(i, count - 1)];
+        }
+        return load(temp);
+    }
+
+    /** Reads the SIZE elements of a starting at index start, or as many as
+        remain. */
+    static Vector3xN load(const Array<Vector3>& a, int start) {
+        debugAssert(start >= 0 && start < a.size());
+        return load(a.getCArray() + start, a.size() - start);
+    }
+
+    /** Writes SIZE consecutive Vector3s */
+    void store(Vector3* v) const {
+        _internal::storeVector3s(v, x, y, z);
+    }
+
+    /** Writes the first count (at most SIZE) lanes */
+    void store(Vector3* v, int count) const {
+        if (count >= SIZE) {
+            store(v);
+            return;
+        }
+        Vector3 temp[SIZE];
+        store(temp);
+        for (int i = 0; i < count; ++i) {
+            v[i] = temp[i];
+        }
+    }
+
+    /** Writes to a starting at index start, stopping at the end of a */
+    void store(Array<Vector3>& a, int start) const {
+        debugAssert(start >= 0 && start < a.size());
+        store(a.getCArray() + start, a.size() - start);
+    }
+
+    /** Extracts lane i */
+    Vector3 operator[](int i) const {
+        return Vector3(x[i], y[i], z[i]);
+    }
+
+    Vector3xN operator+(const Vector3xN& v) const { return Vector3xN(x + v.x, y + v.y, z + v.z); }
+    Vector3xN operator-(const Vector3xN& v) const { return Vector3xN(x - v.x, y - v.y, z - v.z); }
+    Vector3xN operator*(const Vector3xN& v) const { return Vector3xN(x * v.x, y * v.y, z * v.z); }
+    Vector3xN operator/(const Vector3xN& v) const { return Vector3xN(x / v.x, y / v.y, z / v.z); }
+    Vector3xN operator*(const Float& s) const { return Vector3xN(x * s, y * s, z * s); }
+    Vector3xN operator/(const Float& s) const { return *this * (Float(1.0f) / s); }
+    Vector3xN operator-() const { return Vector3xN(-x, -y, -z); }
+
+    friend Vector3xN operator*(const Float& s, const Vector3xN& v) { return v * s; }
+
+    Vector3xN& operator+=(const Vector3xN& v) { return *this = *this + v; }
+    Vector3xN& operator-=(const Vector3xN& v) { return *this = *this - v; }
+    Vector3xN& operator*=(const Vector3xN& v) { return *this = *this * v; }
+    Vector3xN& operator*=(const Float& s) { return *this = *this * s; }
+
+    Float dot(const Vector3xN& v) const {
+        return x * v.x + y * v.y + z * v.z;
+    }
+
+    Vector3xN cross(const Vector3xN& v) const {
+        return Vector3xN(y * v.z - z * v.y,
+                         z * v.x - x * v.z,
+                         x * v.y - y * v.x);
+    }
+
+    Float squaredLength() const {
+        return dot(*this);
+    }
+
+    Float length() const {
+        return squaredLength().sqrt();
+    }
+
+    /** Unit-length version of each lane.  NaN for zero-length lanes. */
+    Vector3xN direction() const {
+        return *this / length();
+    }
+
+    /** Like direction(), using an approximate reciprocal square root
+        refined by one Newton-Raphson step (about 22 bits). */
+    Vector3xN fastDirection() const {
+        const Float s = squaredLength();
+        Float r = s.rsqrt();
+        r = r * (Float(1.5f) - Float(0.5f) * s * r * r);
+        return *this * r;
+    }
+
+    /** Lane-wise minimum of each component */
+    Vector3xN min(const Vector3xN& v) const {
+        return Vector3xN(_internal::laneMin(x, v.x), _internal::laneMin(y, v.y), _internal::laneMin(z, v.z));
+    }
+
+    /** Lane-wise maximum of each component */
+    Vector3xN max(const Vector3xN& v) const {
+        return Vector3xN(_internal::laneMax(x, v.x), _internal::laneMax(y, v.y), _internal::laneMax(z, v.z));
+    }
+
+    /** Returns the lanes of a where mask is set and the lanes of b elsewhere */
+    friend Vector3xN select(const Float& mask, const Vector3xN& a, const Vector3xN& b) {
+        return Vector3xN(_internal::laneSelect(mask, a.x, b.x),
+                         _internal::laneSelect(mask, a.y, b.y),
+                         _internal::laneSelect(mask, a.z, b.z));
+    }
+
+    /** Mask of the lanes where every component is equal */
+    Float operator==(const Vector3xN& v) const {
+        return (x == v.x) & (y == v.y) & (z == v.z);
+    }
+};
+
+/** Four Vector3s in SSE registers.  \sa Vector3xN */
+typedef Vector3xN<Float4> Vector3x4;
+
+/** Eight Vector3s in AVX registers (two SSE registers each without AVX).  \sa Vector3xN */
+typedef Vector3xN<Float8> Vector3x8;
+
+} // namespace G3D
+
+#endif
@@ -99,6 +99,15 @@ These control the version of Winsock used by G3D.
 #    define G3D_32BIT
 #endif
 
+/** \def G3D_SSE2 Defined when the compiler is allowed to emit SSE2 instructions (all x86-64 targets). */
+/** \def G3D_AVX  Defined when the compiler is allowed to emit AVX instructions. */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#    define G3D_SSE2
+#endif
+#if defined(__AVX__)
+#    define G3D_AVX
+#endif
+
 // Verify that the supported compilers are being used and that this is a known
 // processor.
 
@@ -38,7 +38,8 @@ void categorizeByDerivedType(const Array<PointerType>& all, Array< Array<Pointer
     // all over the place during resizing.
     derivedArray.reserve(all.size());
 
-    Table<std::type_info *const, int> typeInfoToIndex;
+    Table<std::type_info *const, int, HashTrait<std::type_info *const>,
+          EqualsTrait<std::type_info *const>, MemoryManagerAllocator> typeInfoToIndex;
     // Allocate the table elements in a memory area that can be cleared all at once
     // without invoking destructors.
     typeInfoToIndex.clearAndSetMemoryManager(AreaMemoryManager::create(100 * 1024));
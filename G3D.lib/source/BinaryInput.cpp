@@ -5,7 +5,7 @@
  Copyright 2001-2013, Morgan McGuire.  All rights reserved.
 
  \created 2001-08-09
- \edited  2013-01-03
+ \edited  2026-10-18
 
 
   <PRE>
@@ -38,16 +38,25 @@
 #include "G3D/fileutils.h"
 #include "G3D/Log.h"
 #include "G3D/FileSystem.h"
+#include "G3D/AABox.h"
+#include "G3D/Vector3int16.h"
+#include "G3D/GThread.h"
+#include "G3D/AtomicInt32.h"
 #include <zlib.h>
-#if _HAVE_ZIP /* G3DFIX: Use ZIP-library only if defined */
-    #include <zip.h>
-#endif
 #include <cstring>
+#include <climits>
+#ifndef G3D_WINDOWS
+#   include <sys/mman.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
 
 namespace G3D {
 
 const bool BinaryInput::NO_COPY = false;
 
+const char* const BinaryInput::COMPRESSED_CHUNKS_MAGIC = "G3DZCHNK";
+
 
 /** Helper used by the constructors for decompression */
 static uint32 readUInt32FromBuffer(const uint8* data, bool swapBytes) {
@@ -64,6 +73,83 @@ static uint32 readUInt32FromBuffer(const uint8* data, bool swapBytes) {
 }
 
 
+static uint64 readUInt64FromBuffer(const uint8* data, bool swapBytes) {
+    uint8 out[8];
+    for (int i = 0; i < 8; ++i) {
+        out[i] = swapBytes ? data[7 - i] : data[i];
+    }
+    return *((uint64*)out);
+}
+
+
+/** Parses the fixed-size part of the header described by
+    BinaryInput::COMPRESSED_CHUNKS_MAGIC, and returns false if \a data
+    does not begin with it. */
+static bool readChunkHeader(const uint8* data, int64 dataLen, bool swapBytes,
+                            int64& chunkSize, int& numChunks, int64& length) {
+    if ((dataLen < 24) || (memcmp(data, BinaryInput::COMPRESSED_CHUNKS_MAGIC, 8) != 0)) {
+        return false;
+    }
+
+    chunkSize = readUInt32FromBuffer(data + 8, swapBytes);
+    numChunks = (int)readUInt32FromBuffer(data + 12, swapBytes);
+    length    = (int64)readUInt64FromBuffer(data + 16, swapBytes);
+
+    // The chunk count is bounded so that the index size, 8 * (numChunks + 1)
+    // bytes, fits in an int
+    if ((chunkSize <= 0) || (numChunks < 0) || (numChunks >= INT_MAX / 8) || (length < 0) ||
+        ((length + chunkSize - 1) / chunkSize != numChunks)) {
+        throw "Compressed chunk header is corrupted";
+    }
+    return true;
+}
+
+
+/** Reads and validates the n + 1 chunk offsets that follow the header */
+static void readChunkOffsets(const uint8* data, int numChunks, int64 dataLen, bool swapBytes, Array<int64>& offset) {
+    offset.resize(numChunks + 1);
+    for (int c = 0; c <= numChunks; ++c) {
+        offset[c] = (int64)readUInt64FromBuffer(data + 8 * c, swapBytes);
+        if ((offset[c] > dataLen) || ((c > 0) && (offset[c] < offset[c - 1]))) {
+            throw "Compressed chunk index is corrupted";
+        }
+    }
+}
+
+
+namespace _internal {
+
+/** Decompresses one chunk per call, for BinaryInput::decompressAllChunks() */
+class ChunkDecompressor {
+public:
+    const uint8*        src;
+    const Array<int64>& offset;
+    uint8*              dst;
+    int64               chunkSize;
+    int64               length;
+
+    /** Index of a corrupt chunk, or -1.  Set by whichever worker thread
+        first finds one. */
+    AtomicInt32         corruptChunk;
+
+    ChunkDecompressor(const uint8* src, const Array<int64>& offset, uint8* dst, int64 chunkSize, int64 length) :
+        src(src), offset(offset), dst(dst), chunkSize(chunkSize), length(length), corruptChunk(-1) {}
+
+    void decompressChunk(int x, int c) {
+        (void)x;
+        const int64 start = c * chunkSize;
+        const int64 n = G3D::min(chunkSize, length - start);
+        uLongf L = (uLongf)n;
+        const int result = uncompress(dst + start, &L, src + offset[c], (uLong)(offset[c + 1] - offset[c]));
+        if ((result != Z_OK) || ((int64)L != n)) {
+            corruptChunk.compareAndSet(-1, c);
+        }
+    }
+};
+
+} // namespace _internal
+
+
 BinaryInput::BinaryInput(
     const uint8*        data,
     int64               dataLen,
@@ -76,13 +162,19 @@ BinaryInput::BinaryInput(
     m_beginEndBits(0),
     m_alreadyRead(0),
     m_bufferLength(0),
-    m_pos(0) {
+    m_pos(0),
+    m_memoryMapped(false),
+    m_chunkSize(0),
+    m_bufferCapacity(0) {
 
     m_freeBuffer = copyMemory || compressed;
 
     setEndian(dataEndian);
 
-    if (compressed) {
+    if (compressed && (dataLen >= 8) && (memcmp(data, COMPRESSED_CHUNKS_MAGIC, 8) == 0)) {
+        m_buffer = NULL;
+        decompressAllChunks(data, dataLen);
+    } else if (compressed) {
         // Read the decompressed size from the first 4 bytes
         m_length = readUInt32FromBuffer(data, m_swapBytes);
 
@@ -114,7 +206,8 @@ BinaryInput::BinaryInput(
 BinaryInput::BinaryInput
 (const std::string&  filename,
  G3DEndian           fileEndian,
- bool                compressed) :
+ bool                compressed,
+ FileAccess          access) :
     m_filename(filename),
     m_bitPos(0),
     m_bitString(0),
@@ -124,7 +217,10 @@ BinaryInput::BinaryInput
     m_bufferLength(0),
     m_buffer(NULL),
     m_pos(0),
-    m_freeBuffer(true) {
+    m_freeBuffer(true),
+    m_memoryMapped(false),
+    m_chunkSize(0),
+    m_bufferCapacity(0) {
 
     setEndian(fileEndian);
 
@@ -137,26 +233,18 @@ BinaryInput::BinaryInput
 
         // Zipfiles require Unix-style slashes
         std::string internalFile = FilePath::canonicalize(m_filename.substr(zipfile.length() + 1));
-        struct zip* z = zip_open(zipfile.c_str(), ZIP_CHECKCONS, NULL);
-        {
-            struct zip_stat info;
-            zip_stat_init( &info );    // TODO: Docs unclear if zip_stat_init is required.
-            zip_stat(z, internalFile.c_str(), ZIP_FL_NOCASE, &info);
-            m_bufferLength = m_length = info.size;
-            // sets machines up to use MMX, if they want
-            m_buffer = reinterpret_cast<uint8*>(System::alignedMalloc(m_length, 16));
-            struct zip_file* zf = zip_fopen( z, internalFile.c_str(), ZIP_FL_NOCASE );
-            if (zf == NULL) {
-                throw std::string("\"") + internalFile + "\" inside \"" + zipfile + "\" could not be opened.";
-            } else {
-                const int64 bytesRead = zip_fread( zf, m_buffer, m_length );
-                debugAssertM(bytesRead == m_length,
-                             internalFile + " was corrupt because it unzipped to the wrong size.");
-                (void)bytesRead;
-                zip_fclose( zf );
-            }
+        const int64 length = FileSystem::zipEntrySize(zipfile, internalFile);
+        if (length == -1) {
+            throw std::string("\"") + internalFile + "\" inside \"" + zipfile + "\" could not be opened.";
+        }
+        m_bufferLength = m_length = length;
+        // sets machines up to use MMX, if they want
+        m_buffer = reinterpret_cast<uint8*>(System::alignedMalloc(m_length, 16));
+        if (! FileSystem::readZipEntry(zipfile, internalFile, m_buffer, m_length)) {
+            System::alignedFree(m_buffer);
+            m_buffer = NULL;
+            throw std::string("\"") + internalFile + "\" inside \"" + zipfile + "\" was corrupt because it unzipped to the wrong size.";
         }
-        zip_close( z );
 
         if (compressed) {
             decompress();
@@ -169,6 +257,16 @@ BinaryInput::BinaryInput
     // Figure out how big the file is and verify that it exists.
     m_length = FileSystem::size(m_filename);
 
+    // Chunked files are decompressed as they are read
+    if (compressed && (m_length > 0) && openChunks()) {
+        return;
+    }
+
+    // Zero-length files cannot be mapped
+    if (! compressed && (access != COPY_TO_MEMORY) && (m_length > 0) && mapFile(access)) {
+        return;
+    }
+
     // Read the file into memory
     FILE* file = FileSystem::fopen(m_filename.c_str(), "rb");
 
@@ -218,13 +316,72 @@ BinaryInput::BinaryInput
 
 BinaryInput::~BinaryInput() {
 
-    if (m_freeBuffer) {
+    if (m_memoryMapped) {
+#       ifdef G3D_WINDOWS
+            UnmapViewOfFile(m_buffer);
+#       else
+            munmap(m_buffer, (size_t)m_length);
+#       endif
+    } else if (m_freeBuffer) {
         System::alignedFree(m_buffer);
     }
     m_buffer = NULL;
 }
 
 
+bool BinaryInput::mapFile(FileAccess access) {
+    if ((int64)(size_t)m_length != m_length) {
+        // Too large for the address space of a 32-bit process
+        return false;
+    }
+
+    const std::string& filename = FilePath::canonicalize(FilePath::expandEnvironmentVariables(m_filename));
+    void* data = NULL;
+
+#   ifdef G3D_WINDOWS
+        const HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+            (access == MEMORY_MAP_SEQUENTIAL) ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        // The view keeps the mapping, and the mapping keeps the file, open
+        const HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(file);
+        if (mapping == NULL) {
+            return false;
+        }
+        data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, (SIZE_T)m_length);
+        CloseHandle(mapping);
+        if (data == NULL) {
+            return false;
+        }
+#   else
+        const int file = ::open(filename.c_str(), O_RDONLY);
+        if (file == -1) {
+            return false;
+        }
+
+        // The mapping keeps the file open
+        data = mmap(NULL, (size_t)m_length, PROT_READ, MAP_PRIVATE, file, 0);
+        ::close(file);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        (void)madvise(data, (size_t)m_length, (access == MEMORY_MAP_SEQUENTIAL) ? MADV_SEQUENTIAL : MADV_RANDOM);
+#   endif
+
+    FileSystem::markFileUsed(m_filename);
+
+    // The pages are read-only; BinaryInput never writes to its buffer
+    m_buffer       = reinterpret_cast<uint8*>(data);
+    m_bufferLength = m_length;
+    m_freeBuffer   = false;
+    m_memoryMapped = true;
+    return true;
+}
+
+
 std::string BinaryInput::readFixedLengthString(int numBytes) {
     Array<char> str;
     str.resize(numBytes + 1);
@@ -240,6 +397,18 @@ std::string BinaryInput::readFixedLengthString(int numBytes) {
 
 
 void BinaryInput::decompress() {
+    if ((m_length >= 8) && (memcmp(m_buffer, COMPRESSED_CHUNKS_MAGIC, 8) == 0)) {
+        uint8* tempBuffer = m_buffer;
+        try {
+            decompressAllChunks(tempBuffer, m_length);
+        } catch (...) {
+            System::alignedFree(tempBuffer);
+            throw;
+        }
+        System::alignedFree(tempBuffer);
+        return;
+    }
+
     // Decompress
     // Use the existing buffer as the source, allocate
     // a new buffer to use as the destination.
@@ -269,6 +438,149 @@ void BinaryInput::decompress() {
 }
 
 
+void BinaryInput::decompressAllChunks(const uint8* data, int64 dataLen) {
+    int64 chunkSize, length;
+    int numChunks;
+    readChunkHeader(data, dataLen, m_swapBytes, chunkSize, numChunks, length);
+    if (dataLen < 24 + 8 * ((int64)numChunks + 1)) {
+        throw "Compressed chunk index is truncated";
+    }
+
+    Array<int64> offset;
+    readChunkOffsets(data + 24, numChunks, dataLen, m_swapBytes, offset);
+
+    m_buffer = (uint8*)System::alignedMalloc(G3D::max<int64>(length, 1), 16);
+    if (m_buffer == NULL) {
+        throw "Not enough memory to load compressed file. (3)";
+    }
+    m_length = length;
+    m_bufferLength = length;
+
+    // Chunks are independent, so decompress them in parallel
+    _internal::ChunkDecompressor decompressor(data, offset, m_buffer, chunkSize, length);
+    GThread::runConcurrently2D(Vector2int32(0, 0), Vector2int32(1, numChunks), &decompressor,
+                               &_internal::ChunkDecompressor::decompressChunk);
+
+    const int c = decompressor.corruptChunk.value();
+    if (c != -1) {
+        System::alignedFree(m_buffer);
+        m_buffer = NULL;
+        m_length = 0;
+        m_bufferLength = 0;
+        throw format("BinaryInput/zlib detected corruption in chunk %d of \"%s\"", c, m_filename.c_str());
+    }
+}
+
+
+bool BinaryInput::openChunks() {
+    FILE* file = FileSystem::fopen(m_filename.c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+
+    int64 chunkSize, length;
+    int numChunks;
+    uint8 header[24];
+    bool chunked;
+    try {
+        chunked = (fread(header, 1, 24, file) == 24) &&
+            readChunkHeader(header, m_length, m_swapBytes, chunkSize, numChunks, length);
+    } catch (...) {
+        FileSystem::fclose(file);
+        throw;
+    }
+
+    if (! chunked) {
+        // Not chunked; the caller will read and decompress the whole file
+        FileSystem::fclose(file);
+        return false;
+    }
+
+    const int64 indexSize = 8 * ((int64)numChunks + 1);
+    if (24 + indexSize > m_length) {
+        FileSystem::fclose(file);
+        throw format("Compressed chunk index is truncated in \"%s\"", m_filename.c_str());
+    }
+
+    Array<uint8> index;
+    index.resize((size_t)indexSize);
+    const size_t count = fread(index.getCArray(), 1, index.size(), file);
+    FileSystem::fclose(file);
+    file = NULL;
+    if (count != (size_t)index.size()) {
+        throw format("Compressed chunk index is truncated in \"%s\"", m_filename.c_str());
+    }
+    readChunkOffsets(index.getCArray(), numChunks, m_length, m_swapBytes, m_chunkOffset);
+
+    // Nothing is loaded until the first read
+    m_chunkSize    = chunkSize;
+    m_length       = length;
+    m_buffer       = NULL;
+    m_bufferLength = 0;
+    m_alreadyRead  = 0;
+    m_pos          = 0;
+    return true;
+}
+
+
+void BinaryInput::loadChunks(int64 startPosition, int64 minLength) {
+    const int64 absPos = m_alreadyRead + m_pos;
+    const int numChunks = m_chunkOffset.size() - 1;
+    if (numChunks == 0) {
+        return;
+    }
+
+    // The chunks that overlap [startPosition, startPosition + minLength)
+    const int first = iClamp((int)(startPosition / m_chunkSize), 0, numChunks - 1);
+    const int last  = iClamp((int)((startPosition + G3D::max<int64>(minLength, 1) - 1) / m_chunkSize), first, numChunks - 1);
+
+    m_alreadyRead  = first * m_chunkSize;
+    m_bufferLength = G3D::min(m_length, (last + 1) * m_chunkSize) - m_alreadyRead;
+    if (m_bufferCapacity < m_bufferLength) {
+        System::alignedFree(m_buffer);
+        m_buffer = (uint8*)System::alignedMalloc(m_bufferLength, 16);
+        if (m_buffer == NULL) {
+            throw "Tried to read a larger memory chunk than could fit in memory. (3)";
+        }
+        m_bufferCapacity = m_bufferLength;
+    }
+
+    // Read all of the compressed chunks at once
+    const int64 compressedStart = m_chunkOffset[first];
+    m_compressedChunks.resize((size_t)(m_chunkOffset[last + 1] - compressedStart), false);
+
+    FILE* file = fopen(m_filename.c_str(), "rb");
+    if (file == NULL) {
+        throw format("File not found: \"%s\"", m_filename.c_str());
+    }
+#   ifdef G3D_WINDOWS
+        int ret = _fseeki64(file, compressedStart, SEEK_SET);
+#   else
+        int ret = fseeko(file, (off_t)compressedStart, SEEK_SET);
+#   endif
+    const size_t count = (ret == 0) ? fread(m_compressedChunks.getCArray(), 1, m_compressedChunks.size(), file) : 0;
+    fclose(file);
+    file = NULL;
+    if (count != (size_t)m_compressedChunks.size()) {
+        throw format("Could not read compressed chunks from \"%s\"", m_filename.c_str());
+    }
+
+    for (int c = first; c <= last; ++c) {
+        const int64 start = (c - first) * m_chunkSize;
+        const int64 n = G3D::min(m_chunkSize, m_bufferLength - start);
+        uLongf L = (uLongf)n;
+        const int result = uncompress(m_buffer + start, &L,
+                                      m_compressedChunks.getCArray() + (m_chunkOffset[c] - compressedStart),
+                                      (uLong)(m_chunkOffset[c + 1] - m_chunkOffset[c]));
+        if ((result != Z_OK) || ((int64)L != n)) {
+            throw format("BinaryInput/zlib detected corruption in chunk %d of \"%s\"", c, m_filename.c_str());
+        }
+    }
+
+    m_pos = absPos - m_alreadyRead;
+}
+
+
 void BinaryInput::setEndian(G3DEndian e) {
     m_fileEndian = e;
     m_swapBytes = (m_fileEndian != System::machineEndian());
@@ -276,9 +588,19 @@ void BinaryInput::setEndian(G3DEndian e) {
 
 
 void BinaryInput::loadIntoMemory(int64 startPosition, int64 minLength) {
+    if (m_memoryMapped) {
+        // The whole file is already mapped, so this is a read past its end
+        throw format("Read past end of memory-mapped file \"%s\"", m_filename.c_str());
+    }
+
     // Load the next section of the file
     debugAssertM(m_filename != "<memory>", "Read past end of file.");
 
+    if (m_chunkSize > 0) {
+        loadChunks(startPosition, minLength);
+        return;
+    }
+
     int64 absPos = m_alreadyRead + m_pos;
 
     if (m_bufferLength < minLength) {
@@ -630,9 +952,9 @@ IMPLEMENT_READER(Int8,    int8)
 #define IMPLEMENT_READER(ucase, lcase)\
 void BinaryInput::read##ucase(lcase* out, int64 n) {\
     if (m_swapBytes) {\
-        for (int64 i = 0; i < n; ++i) {\
-            out[i] = read##ucase();\
-        }\
+        prepareToRead(sizeof(lcase) * n);\
+        System::memcpyFlipEndian(out, m_buffer + m_pos, sizeof(lcase), (size_t)n);\
+        m_pos += sizeof(lcase) * n;\
     } else {\
         readBytes(out, sizeof(lcase) * n);\
     }\
@@ -650,5 +972,48 @@ IMPLEMENT_READER(Float64, float64)
 
 #undef IMPLEMENT_READER
 
-} // namespace G3D
 
+void BinaryInput::readVector3(Array<Vector3>& out, int64 n) {
+    out.resize(n);
+    readFloat32(reinterpret_cast<float32*>(out.getCArray()), 3 * n);
+}
+
+
+void BinaryInput::readVector3int16(Array<Vector3int16>& out, int64 n) {
+    static_assert(sizeof(Vector3int16) == 3 * sizeof(int16), "Vector3int16 must be three packed int16s");
+    out.resize(n);
+    readInt16(reinterpret_cast<int16*>(out.getCArray()), 3 * n);
+}
+
+
+void BinaryInput::readAABox(Array<AABox>& out, int64 n) {
+    // AABox is lo followed by hi, with no other per-instance data
+    static_assert(sizeof(AABox) == 6 * sizeof(float32), "AABox must be six packed floats");
+    out.resize(n);
+    readFloat32(reinterpret_cast<float32*>(out.getCArray()), 6 * n);
+}
+
+
+void BinaryInput::readIndex16(Array<int>& out, int64 n) {
+    out.resize(n);
+    prepareToRead(2 * n);
+
+    const uint8* src = m_buffer + m_pos;
+    int* dst = out.getCArray();
+    if (m_swapBytes) {
+        for (int64 i = 0; i < n; ++i) {
+            uint16 u;
+            memcpy(&u, src + 2 * i, 2);
+            dst[i] = flipEndian16(u);
+        }
+    } else {
+        for (int64 i = 0; i < n; ++i) {
+            uint16 u;
+            memcpy(&u, src + 2 * i, 2);
+            dst[i] = u;
+        }
+    }
+    m_pos += 2 * n;
+}
+
+} // namespace G3D
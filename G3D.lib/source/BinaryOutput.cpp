@@ -5,7 +5,7 @@
  Copyright 2002-2011, Morgan McGuire, All rights reserved.
 
  @created 2002-02-20
- @edited  2010-03-17
+ @edited  2026-10-18
  */
 
 #include "G3D/platform.h"
@@ -14,9 +14,15 @@
 #include "G3D/FileSystem.h"
 #include "G3D/stringutils.h"
 #include "G3D/Array.h"
+#include "G3D/AABox.h"
+#include "G3D/Vector3int16.h"
 #include <zlib.h>
 #include "G3D/Log.h"
+#include "G3D/GThread.h"
+#include "G3D/GMutex.h"
+#include "G3D/Queue.h"
 #include <cstring>
+#include <condition_variable>
 
 #ifdef G3D_LINUX
 #    include <errno.h>
@@ -31,6 +37,209 @@
 
 namespace G3D {
 
+namespace _internal {
+
+/** Appends the chunks of a streaming BinaryOutput to its file on a
+    background thread.  See BinaryOutput::startBackgroundWriter(). */
+class BinaryOutputWriter : public GThread {
+private:
+
+    class Chunk {
+    public:
+        uint8*      data;
+        size_t      length;
+        size_t      capacity;
+
+        Chunk() : data(NULL), length(0), capacity(0) {}
+        Chunk(uint8* d, size_t L, size_t c) : data(d), length(L), capacity(c) {}
+    };
+
+    /** Protects m_pending, m_free, and m_done */
+    GMutex                      m_mutex;
+
+    /** Signaled when a chunk is queued, written, or m_done is set */
+    std::condition_variable_any m_changed;
+
+    Queue<Chunk>                m_pending;
+
+    /** Written chunks of exactly m_chunkSize bytes, for reuse */
+    Array<Chunk>                m_free;
+
+    bool                        m_done;
+
+    /** Written only by the thread, and read by others only after it completes */
+    bool                        m_ok;
+
+    int                         m_errno;
+
+    FILE*                       m_file;
+
+    const size_t                m_chunkSize;
+
+    const int                   m_maxQueuedChunks;
+
+    void recycle(const Chunk& chunk) {
+        if (chunk.capacity == m_chunkSize) {
+            m_free.append(chunk);
+        } else {
+            System::free(chunk.data);
+        }
+    }
+
+protected:
+
+    virtual void threadMain() {
+        while (true) {
+            Chunk chunk;
+            {
+                std::unique_lock<GMutex> lock(m_mutex);
+                while (m_pending.empty() && ! m_done) {
+                    m_changed.wait(lock);
+                }
+                if (m_pending.empty()) {
+                    break;
+                }
+                chunk = m_pending.popFront();
+            }
+            m_changed.notify_all();
+
+            // After an error, keep draining the queue so that the writer never blocks
+            if (m_ok && (fwrite(chunk.data, 1, chunk.length, m_file) != chunk.length)) {
+                m_ok = false;
+                m_errno = errno;
+            }
+
+            {
+                std::unique_lock<GMutex> lock(m_mutex);
+                recycle(chunk);
+            }
+            m_changed.notify_all();
+        }
+
+        if ((fflush(m_file) != 0) && m_ok) {
+            m_ok = false;
+            m_errno = errno;
+        }
+        FileSystem::fclose(m_file);
+        m_file = NULL;
+    }
+
+public:
+
+    /** \param file Open for writing; closed by the thread when it finishes */
+    BinaryOutputWriter(FILE* file, size_t chunkSize, int maxQueuedChunks) :
+        GThread("BinaryOutputWriter"), m_done(false), m_ok(true), m_errno(0), m_file(file),
+        m_chunkSize(chunkSize), m_maxQueuedChunks(maxQueuedChunks) {}
+
+    ~BinaryOutputWriter() {
+        debugAssert(m_pending.empty());
+        for (int i = 0; i < m_free.size(); ++i) {
+            System::free(m_free[i].data);
+        }
+    }
+
+    size_t chunkSize() const {
+        return m_chunkSize;
+    }
+
+    /** Returns a buffer of at least \a minCapacity bytes, reusing a written chunk if possible */
+    uint8* allocate(size_t minCapacity, size_t& capacity) {
+        capacity = G3D::max(m_chunkSize, minCapacity);
+        if (capacity == m_chunkSize) {
+            GMutexLock lock(&m_mutex);
+            if (m_free.size() > 0) {
+                return m_free.pop().data;
+            }
+        }
+        return (uint8*)System::malloc(capacity);
+    }
+
+    /** Queues the first \a length bytes of \a data, which was returned by
+        allocate() and now belongs to the writer.  Blocks while the queue
+        is full. */
+    void write(uint8* data, size_t length, size_t capacity) {
+        {
+            std::unique_lock<GMutex> lock(m_mutex);
+            debugAssert(! m_done);
+            while (m_pending.size() >= m_maxQueuedChunks) {
+                m_changed.wait(lock);
+            }
+            m_pending.pushBack(Chunk(data, length, capacity));
+        }
+        m_changed.notify_all();
+    }
+
+    /** Returns a buffer from allocate() without writing it */
+    void release(uint8* data, size_t capacity) {
+        GMutexLock lock(&m_mutex);
+        recycle(Chunk(data, 0, capacity));
+    }
+
+    /** Writes the queued chunks, closes the file, and stops the thread.
+        Returns false if any write failed. */
+    bool finish(int& error) {
+        {
+            GMutexLock lock(&m_mutex);
+            m_done = true;
+        }
+        m_changed.notify_all();
+        waitForCompletion();
+        error = m_errno;
+        return m_ok;
+    }
+};
+
+
+/** Compresses one chunk of a BinaryOutput's buffer per call, for
+    BinaryOutput::compressChunks() */
+class ChunkCompressor {
+public:
+    const uint8*    src;
+    size_t          srcLength;
+    size_t          chunkSize;
+    int             level;
+
+    /** Compressed data and length of each chunk, allocated with System::malloc */
+    Array<uint8*>   data;
+    Array<size_t>   length;
+
+    ChunkCompressor(const uint8* src, size_t srcLength, size_t chunkSize, int level) :
+        src(src), srcLength(srcLength), chunkSize(chunkSize), level(level) {
+
+        const int numChunks = (int)((srcLength + chunkSize - 1) / chunkSize);
+        data.resize(numChunks);
+        length.resize(numChunks);
+    }
+
+    void compressChunk(int x, int c) {
+        (void)x;
+        const size_t start = c * chunkSize;
+        const size_t n = G3D::min(chunkSize, srcLength - start);
+
+        uLongf compressedSize = compressBound((uLong)n);
+        data[c] = (uint8*)System::malloc(compressedSize);
+        const int result = compress2(data[c], &compressedSize, src + start, (uLong)n, level);
+        debugAssert(result == Z_OK); (void)result;
+        length[c] = compressedSize;
+    }
+};
+
+} // namespace _internal
+
+
+/** Creates the directory that will hold \a filename if it does not exist */
+static void createParentDirectory(const std::string& filename) {
+    std::string root, base, ext, path;
+    Array<std::string> pathArray;
+    parseFilename(filename, root, pathArray, base, ext);
+
+    path = root + stringJoin(pathArray, '/');
+    if (! FileSystem::exists(path, false)) {
+        FileSystem::createDirectory(path);
+    }
+}
+
+
 void BinaryOutput::writeBool8(const std::vector<bool>& out, int n) {
     for (int i = 0; i < n; ++i) {
         writeBool8(out[i]);
@@ -89,8 +298,10 @@ IMPLEMENT_WRITER(Int8,    int8)
 #define IMPLEMENT_WRITER(ucase, lcase)\
 void BinaryOutput::write##ucase(const lcase* out, int n) {\
     if (m_swapBytes) {\
-        for (int i = 0; i < n; ++i) {\
-            write##ucase(out[i]);\
+        if (n > 0) {\
+            reserveBytes(sizeof(lcase) * n);\
+            System::memcpyFlipEndian(m_buffer + m_pos, out, sizeof(lcase), n);\
+            m_pos += sizeof(lcase) * n;\
         }\
     } else {\
         writeBytes((const void*)out, sizeof(lcase) * n);\
@@ -113,6 +324,12 @@ IMPLEMENT_WRITER(Float64, float64)
 void BinaryOutput::reallocBuffer(size_t bytes, size_t oldBufferLen) {
     //debugPrintf("reallocBuffer(%d, %d)\n", bytes, oldBufferLen);
 
+    if (streaming()) {
+        m_bufferLen = oldBufferLen;
+        streamChunk(bytes);
+        return;
+    }
+
     size_t newBufferLen = (int)(m_bufferLen * 1.5) + 100;
     uint8* newBuffer = NULL;
 
@@ -198,6 +415,61 @@ void BinaryOutput::reserveBytesWhenOutOfMemory(size_t bytes) {
 }
 
 
+void BinaryOutput::streamChunk(size_t bytes) {
+    // Bytes past m_pos were written before seeking backwards; they move
+    // to the front of the new chunk.  This is the only copy, and it is
+    // empty when writing sequentially.
+    const size_t tail = m_bufferLen - (size_t)m_pos;
+
+    size_t capacity;
+    uint8* newBuffer = m_writer->allocate(G3D::max(tail, bytes), capacity);
+    if (tail > 0) {
+        System::memcpy(newBuffer, m_buffer + m_pos, tail);
+    }
+
+    if (m_pos > 0) {
+        m_writer->write(m_buffer, (size_t)m_pos, m_maxBufferLen);
+    } else if (m_buffer != NULL) {
+        m_writer->release(m_buffer, m_maxBufferLen);
+    }
+
+    m_alreadyWritten += m_pos;
+    m_buffer       = newBuffer;
+    m_maxBufferLen = capacity;
+    m_bufferLen    = G3D::max(tail, bytes);
+    m_pos          = 0;
+}
+
+
+void BinaryOutput::startBackgroundWriter(size_t chunkSize, int maxQueuedChunks) {
+    alwaysAssertM(m_filename != "<memory>", "Cannot stream a memory BinaryOutput to disk");
+    alwaysAssertM((m_bufferLen == 0) && (m_alreadyWritten == 0) && ! m_committed,
+                  "startBackgroundWriter must be called before anything is written");
+    alwaysAssertM(! streaming(), "startBackgroundWriter called twice");
+    debugAssert((chunkSize > 0) && (maxQueuedChunks > 0));
+
+    System::free(m_buffer);
+    m_buffer = NULL;
+    m_maxBufferLen = 0;
+
+    createParentDirectory(m_filename);
+    FILE* file = FileSystem::fopen(m_filename.c_str(), "wb");
+    if (file == NULL) {
+        logPrintf("Error %d while trying to open \"%s\"\n", errno, m_filename.c_str());
+        m_ok = false;
+        return;
+    }
+
+    m_writer.reset(new _internal::BinaryOutputWriter(file, chunkSize, maxQueuedChunks));
+    if (! m_writer->start()) {
+        m_writer.reset();
+        FileSystem::fclose(file);
+        logPrintf("Could not start the writer thread for \"%s\"\n", m_filename.c_str());
+        m_ok = false;
+    }
+}
+
+
 BinaryOutput::BinaryOutput() {
     m_alreadyWritten = 0;
     m_swapBytes = false;
@@ -254,6 +526,13 @@ void BinaryOutput::reset() {
 
 
 BinaryOutput::~BinaryOutput() {
+    if (streaming()) {
+        // Not committed; finish the chunks that were already queued and drop the rest
+        int error;
+        m_writer->finish(error);
+        m_writer.reset();
+    }
+
     debugAssert((m_buffer == NULL) || isValidHeapPointer(m_buffer));
     System::free(m_buffer);
     m_buffer = NULL;
@@ -274,6 +553,9 @@ bool BinaryOutput::ok() const {
 
 
 void BinaryOutput::compress(int level) {
+    if (streaming()) {
+        throw "Cannot compress a file that is being streamed to disk.";
+    }
     if (m_alreadyWritten > 0) {
         throw "Cannot compress huge files (part of this file has already been written to disk).";
     }
@@ -319,6 +601,46 @@ void BinaryOutput::compress(int level) {
 }
 
 
+void BinaryOutput::compressChunks(int level, int chunkSize, int maxThreads) {
+    if (streaming()) {
+        throw "Cannot compress a file that is being streamed to disk.";
+    }
+    if (m_alreadyWritten > 0) {
+        throw "Cannot compress huge files (part of this file has already been written to disk).";
+    }
+    debugAssertM(! m_committed, "Cannot compress after committing.");
+    alwaysAssertM(chunkSize > 0, "Chunk size must be positive");
+
+    const size_t uncompressedLength = m_bufferLen;
+    _internal::ChunkCompressor compressor(m_buffer, uncompressedLength, chunkSize, iClamp(level, 0, 9));
+    const int numChunks = compressor.data.size();
+    GThread::runConcurrently2D(Vector2int32(0, 0), Vector2int32(1, numChunks), &compressor,
+                               &_internal::ChunkCompressor::compressChunk, maxThreads);
+
+    // The original data is no longer needed, so rewrite the buffer in
+    // place.  See BinaryInput::COMPRESSED_CHUNKS_MAGIC for the format.
+    m_pos = 0;
+    m_bufferLen = 0;
+
+    writeBytes(BinaryInput::COMPRESSED_CHUNKS_MAGIC, 8);
+    writeUInt32((uint32)chunkSize);
+    writeUInt32((uint32)numChunks);
+    writeUInt64((uint64)uncompressedLength);
+
+    uint64 offset = 24 + 8 * (uint64)(numChunks + 1);
+    for (int c = 0; c < numChunks; ++c) {
+        writeUInt64(offset);
+        offset += compressor.length[c];
+    }
+    writeUInt64(offset);
+
+    for (int c = 0; c < numChunks; ++c) {
+        writeBytes(compressor.data[c], compressor.length[c]);
+        System::free(compressor.data[c]);
+    }
+}
+
+
 void BinaryOutput::commit(bool flush) {
     debugAssertM(! m_committed, "Cannot commit twice");
     m_committed = true;
@@ -328,16 +650,31 @@ void BinaryOutput::commit(bool flush) {
         return;
     }
 
-    // Make sure the directory exists.
-    std::string root, base, ext, path;
-    Array<std::string> pathArray;
-    parseFilename(m_filename, root, pathArray, base, ext);
-
-    path = root + stringJoin(pathArray, '/');
-    if (! FileSystem::exists(path, false)) {
-        FileSystem::createDirectory(path);
+    if (streaming()) {
+        if (m_bufferLen > 0) {
+            m_writer->write(m_buffer, m_bufferLen, m_maxBufferLen);
+        } else if (m_buffer != NULL) {
+            m_writer->release(m_buffer, m_maxBufferLen);
+        }
+        m_alreadyWritten += m_bufferLen;
+        m_buffer = NULL;
+        m_bufferLen = 0;
+        m_maxBufferLen = 0;
+        m_pos = 0;
+
+        int error = 0;
+        if (! m_writer->finish(error)) {
+            logPrintf("Error %d while writing \"%s\"\n", error, m_filename.c_str());
+            m_ok = false;
+        }
+        m_writer.reset();
+        debugAssertM(m_ok, std::string("Could not write to '") + m_filename + "'");
+        return;
     }
 
+    // Make sure the directory exists.
+    createParentDirectory(m_filename);
+
     const char* mode = (m_alreadyWritten > 0) ? "ab" : "wb";
 
     alwaysAssertM(m_filename != "<memory>", "Writing to memory file");
@@ -370,6 +707,7 @@ void BinaryOutput::commit(bool flush) {
 void BinaryOutput::commit(
     uint8*                  out) {
     debugAssertM(! m_committed, "Cannot commit twice");
+    alwaysAssertM(! streaming(), "Cannot commit a streamed file to memory");
     m_committed = true;
 
     System::memcpy(out, m_buffer, m_bufferLen);
@@ -508,6 +846,47 @@ void BinaryOutput::writeColor3(const Color3& v) {
 }
 
 
+void BinaryOutput::writeVector3(const Array<Vector3>& v, int n) {
+    debugAssert(n <= v.size());
+    writeFloat32(reinterpret_cast<const float32*>(v.getCArray()), 3 * n);
+}
+
+
+void BinaryOutput::writeVector3int16(const Array<Vector3int16>& v, int n) {
+    debugAssert(n <= v.size());
+    static_assert(sizeof(Vector3int16) == 3 * sizeof(int16), "Vector3int16 must be three packed int16s");
+    writeInt16(reinterpret_cast<const int16*>(v.getCArray()), 3 * n);
+}
+
+
+void BinaryOutput::writeAABox(const Array<AABox>& b, int n) {
+    // AABox is lo followed by hi, with no other per-instance data
+    debugAssert(n <= b.size());
+    static_assert(sizeof(AABox) == 6 * sizeof(float32), "AABox must be six packed floats");
+    writeFloat32(reinterpret_cast<const float32*>(b.getCArray()), 6 * n);
+}
+
+
+void BinaryOutput::writeIndex16(const Array<int>& index, int n) {
+    debugAssert(n <= index.size());
+    if (n <= 0) {
+        return;
+    }
+
+    reserveBytes(2 * n);
+    uint8* dst = m_buffer + m_pos;
+    for (int i = 0; i < n; ++i) {
+        debugAssertM((index[i] >= 0) && (index[i] < 65536), "Index does not fit in 16 bits");
+        uint16 u = (uint16)index[i];
+        if (m_swapBytes) {
+            u = flipEndian16(u);
+        }
+        memcpy(dst + 2 * i, &u, 2);
+    }
+    m_pos += 2 * n;
+}
+
+
 void BinaryOutput::beginBits() {
     debugAssertM(m_beginEndBits == 0, "Already in beginBits...endBits");
     m_bitString = 0x00;
@@ -0,0 +1,288 @@
+/**
+  \file G3D.lib/source/CompactMesh.cpp
+
+  \created 2026-10-18
+  \edited  2026-10-18
+*/
+
+#include "G3D/CompactMesh.h"
+#include "G3D/CollisionDetection.h"
+#include "G3D/TriangleBlock.h"
+
+namespace G3D {
+
+CompactMesh::CompactMesh() : m_format(FULL_PRECISION), m_numVertices(0), m_numTriangles(0),
+    m_bounds(Point3::zero()), m_step(Vector3::zero()) {
+}
+
+
+CompactMesh::CompactMesh(const Array<Point3>& vertex, const Array<int>& index, VertexFormat format) {
+    set(vertex, index, format);
+}
+
+
+void CompactMesh::clear() {
+    m_format = FULL_PRECISION;
+    m_vertex.clear();
+    m_quantizedVertex.clear();
+    m_index16.clear();
+    m_index32.clear();
+    m_cluster.clear();
+    m_numVertices = 0;
+    m_numTriangles = 0;
+    m_bounds = AABox(Point3::zero());
+    m_step = Vector3::zero();
+}
+
+
+void CompactMesh::set(const Array<Point3>& vertex, const Array<int>& index, VertexFormat format) {
+    alwaysAssertM(index.size() % 3 == 0, "CompactMesh requires three indices per triangle");
+    clear();
+
+    m_format = format;
+    m_numVertices = vertex.size();
+    m_numTriangles = index.size() / 3;
+
+    if (m_numVertices > 0) {
+        Point3 low = vertex[0];
+        Point3 high = vertex[0];
+        for (int v = 1; v < m_numVertices; ++v) {
+            low = low.min(vertex[v]);
+            high = high.max(vertex[v]);
+        }
+        m_bounds = AABox(low, high);
+    }
+
+    if (m_format == QUANTIZED) {
+        m_step = m_bounds.extent() / 65535.0f;
+        const Vector3 invStep(
+            (m_step.x > 0.0f) ? 1.0f / m_step.x : 0.0f,
+            (m_step.y > 0.0f) ? 1.0f / m_step.y : 0.0f,
+            (m_step.z > 0.0f) ? 1.0f / m_step.z : 0.0f);
+
+        m_quantizedVertex.resize(m_numVertices);
+        for (int v = 0; v < m_numVertices; ++v) {
+            const Vector3 q = (vertex[v] - m_bounds.low()) * invStep;
+            m_quantizedVertex[v] = Vector3int16(
+                int16(iClamp(iRound(q.x), 0, 65535) - 32768),
+                int16(iClamp(iRound(q.y), 0, 65535) - 32768),
+                int16(iClamp(iRound(q.z), 0, 65535) - 32768));
+        }
+    } else {
+        m_vertex = vertex;
+    }
+
+    if (m_numVertices <= 65536) {
+        m_index16.resize(index.size());
+        for (int i = 0; i < index.size(); ++i) {
+            debugAssert(index[i] >= 0 && index[i] < m_numVertices);
+            m_index16[i] = uint16(index[i]);
+        }
+    } else {
+        m_index32.resize(index.size());
+        for (int i = 0; i < index.size(); ++i) {
+            debugAssert(index[i] >= 0 && index[i] < m_numVertices);
+            m_index32[i] = uint32(index[i]);
+        }
+    }
+
+    computeClusters();
+}
+
+
+void CompactMesh::computeClusters() {
+    const int numClusters = (m_numTriangles + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    m_cluster.resize((numClusters + AABoxBlock8::SIZE - 1) / AABoxBlock8::SIZE);
+
+    for (int c = 0; c < numClusters; ++c) {
+        const int end = G3D::min(m_numTriangles, (c + 1) * CLUSTER_SIZE);
+        Point3 low = vertex(index(c * CLUSTER_SIZE, 0));
+        Point3 high = low;
+        for (int t = c * CLUSTER_SIZE; t < end; ++t) {
+            for (int i = 0; i < 3; ++i) {
+                const Point3& v = vertex(index(t, i));
+                low = low.min(v);
+                high = high.max(v);
+            }
+        }
+
+        // Bounds are computed from the decoded vertices, so they enclose the
+        // triangles that the queries actually test
+        m_cluster[c / AABoxBlock8::SIZE].append(AABox(low, high));
+    }
+}
+
+
+size_t CompactMesh::sizeInBytes() const {
+    return m_vertex.size() * sizeof(Point3) +
+        m_quantizedVertex.size() * sizeof(Vector3int16) +
+        m_index16.size() * sizeof(uint16) +
+        m_index32.size() * sizeof(uint32) +
+        m_cluster.size() * sizeof(AABoxBlock8);
+}
+
+
+int CompactMesh::intersectCluster(int c, FastRay& ray, float& w0, float& w1, float& w2) const {
+    TriangleBlock8 block;
+    const int first = c * CLUSTER_SIZE;
+    const int end = G3D::min(m_numTriangles, first + CLUSTER_SIZE);
+    for (int t = first; t < end; ++t) {
+        Point3 v0, v1, v2;
+        getTriangle(t, v0, v1, v2);
+        block.append(v0, v1, v2);
+    }
+
+    const int i = block.intersect(ray, w0, w1, w2);
+    return (i == -1) ? -1 : first + i;
+}
+
+
+bool CompactMesh::intersectsAnyInCluster(int c, const FastRay& ray) const {
+    TriangleBlock8 block;
+    const int first = c * CLUSTER_SIZE;
+    const int end = G3D::min(m_numTriangles, first + CLUSTER_SIZE);
+    for (int t = first; t < end; ++t) {
+        Point3 v0, v1, v2;
+        getTriangle(t, v0, v1, v2);
+        block.append(v0, v1, v2);
+    }
+    return block.intersectsAny(ray);
+}
+
+
+int CompactMesh::intersect(FastRay& ray, float& w0, float& w1, float& w2) const {
+    const Vector3N origin(ray.origin());
+    const Vector3N invDirection(ray.invDirection());
+
+    int hit = -1;
+    for (int b = 0; b < m_cluster.size(); ++b) {
+        Float8 enter, exit;
+        int mask = m_cluster[b].intersect(origin, invDirection, ray.minDistance(), ray.maxDistance(), enter, exit);
+        for (int i = 0; mask != 0; ++i, mask >>= 1) {
+            // The ray may have been shortened by a hit in an earlier cluster
+            if ((mask & 1) && (enter[i] <= ray.maxDistance())) {
+                const int t = intersectCluster(b * AABoxBlock8::SIZE + i, ray, w0, w1, w2);
+                if (t != -1) {
+                    hit = t;
+                }
+            }
+        }
+    }
+    return hit;
+}
+
+
+int CompactMesh::intersect(const Ray& ray, float& distance, float& w0, float& w1, float& w2) const {
+    FastRay fastRay(ray);
+    fastRay.setMaxDistance(distance);
+    const int t = intersect(fastRay, w0, w1, w2);
+    if (t != -1) {
+        distance = fastRay.maxDistance();
+    }
+    return t;
+}
+
+
+bool CompactMesh::intersectsAny(const FastRay& ray) const {
+    const Vector3N origin(ray.origin());
+    const Vector3N invDirection(ray.invDirection());
+
+    for (int b = 0; b < m_cluster.size(); ++b) {
+        Float8 enter, exit;
+        int mask = m_cluster[b].intersect(origin, invDirection, ray.minDistance(), ray.maxDistance(), enter, exit);
+        for (int i = 0; mask != 0; ++i, mask >>= 1) {
+            if ((mask & 1) && intersectsAnyInCluster(b * AABoxBlock8::SIZE + i, ray)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+template<class Callback>
+void CompactMesh::forEachTriangleNear(const AABox& box, Callback& callback) const {
+    const int numClusters = (m_numTriangles + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    for (int c = 0; c < numClusters; ++c) {
+        if (! m_cluster[c / AABoxBlock8::SIZE].bounds(c % AABoxBlock8::SIZE).intersects(box)) {
+            continue;
+        }
+
+        const int end = G3D::min(m_numTriangles, (c + 1) * CLUSTER_SIZE);
+        for (int t = c * CLUSTER_SIZE; t < end; ++t) {
+            Point3 v0, v1, v2;
+            getTriangle(t, v0, v1, v2);
+            const AABox triangleBounds(v0.min(v1).min(v2), v0.max(v1).max(v2));
+            if (triangleBounds.intersects(box) && ! callback(t, v0, v1, v2)) {
+                return;
+            }
+        }
+    }
+}
+
+
+namespace _internal {
+
+/** Collects the triangles that touch a sphere; optionally stops at the first */
+class CompactMeshSphereCallback {
+public:
+    const Sphere&   sphere;
+    Array<int>*     result;
+    bool            found;
+
+    CompactMeshSphereCallback(const Sphere& s, Array<int>* r) : sphere(s), result(r), found(false) {}
+
+    bool operator()(int t, const Point3& v0, const Point3& v1, const Point3& v2) {
+        if (CollisionDetection::fixedSolidSphereIntersectsFixedTriangle(sphere, Triangle(v0, v1, v2))) {
+            found = true;
+            if (result == NULL) {
+                return false;
+            }
+            result->append(t);
+        }
+        return true;
+    }
+};
+
+
+class CompactMeshBoxCallback {
+public:
+    const AABox&    box;
+    Array<int>&     result;
+
+    CompactMeshBoxCallback(const AABox& b, Array<int>& r) : box(b), result(r) {}
+
+    bool operator()(int t, const Point3& v0, const Point3& v1, const Point3& v2) {
+        if (CollisionDetection::fixedSolidBoxIntersectsFixedTriangle(box, Triangle(v0, v1, v2))) {
+            result.append(t);
+        }
+        return true;
+    }
+};
+
+} // namespace _internal
+
+
+void CompactMesh::getIntersectingTriangles(const Sphere& sphere, Array<int>& triangles) const {
+    AABox sphereBounds;
+    sphere.getBounds(sphereBounds);
+    _internal::CompactMeshSphereCallback callback(sphere, &triangles);
+    forEachTriangleNear(sphereBounds, callback);
+}
+
+
+void CompactMesh::getIntersectingTriangles(const AABox& box, Array<int>& triangles) const {
+    _internal::CompactMeshBoxCallback callback(box, triangles);
+    forEachTriangleNear(box, callback);
+}
+
+
+bool CompactMesh::intersects(const Sphere& sphere) const {
+    AABox sphereBounds;
+    sphere.getBounds(sphereBounds);
+    _internal::CompactMeshSphereCallback callback(sphere, NULL);
+    forEachTriangleNear(sphereBounds, callback);
+    return callback.found;
+}
+
+} // namespace G3D
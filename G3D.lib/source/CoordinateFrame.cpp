@@ -28,6 +28,8 @@
 #include "G3D/stringutils.h"
 #include "G3D/PhysicsFrame.h"
 #include "G3D/UprightFrame.h"
+#include "G3D/Float4.h"
+#include "G3D/Vector3xN.h"
 #include "G3D/Frustum.h"
 
 namespace G3D {
@@ -290,20 +292,46 @@ Capsule CoordinateFrame::toWorldSpace(const Capsule& c) const {
 }
 
 
-void CoordinateFrame::toWorldSpace(const AABox& b, AABox& result) const {
-    if (b.isEmpty()) {
+/** Rotation with each element replaced by its absolute value */
+static Matrix3 absoluteValue(const Matrix3& m) {
+    Matrix3 a;
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            a[r][c] = fabsf(m[r][c]);
+        }
+    }
+    return a;
+}
+
+
+/** The world-space bounds of a box are centered at the transformed center
+    and extend by |R| times the half-extent (Arvo, Graphics Gems), which
+    gives the same result as bounding the eight transformed corners. */
+static void boundsToWorldSpace(const CoordinateFrame& cframe, const Matrix3& absRotation, const AABox& b, AABox& result) {
+    // x - x is zero for finite x and NaN for infinite or NaN x, so this
+    // tests for a box that is neither empty nor infinite without the
+    // out-of-line calls in isEmpty() and isFinite()
+    const Vector3 z = (b.low() - b.low()) + (b.high() - b.high());
+    if ((z.x == 0.0f) && (z.y == 0.0f) && (z.z == 0.0f)) {
+        const Point3  center = cframe.pointToWorldSpace((b.low() + b.high()) * 0.5f);
+        const Vector3 halfExtent = absRotation * ((b.high() - b.low()) * 0.5f);
+        result = AABox(center - halfExtent, center + halfExtent);
+    } else if (b.isEmpty()) {
         result = b;
-    } else if (! b.isFinite()) {
+    } else {
         // We can't combine infinite elements under a matrix
         // multiplication: if the computation performs inf-inf we'll
         // get NaN.  So treat the box as infinite in all directions.
         result = AABox::inf();
-    } else {
-        toWorldSpace(Box(b)).getBounds(result);
     }
 }
 
 
+void CoordinateFrame::toWorldSpace(const AABox& b, AABox& result) const {
+    boundsToWorldSpace(*this, absoluteValue(rotation), b, result);
+}
+
+
 Box CoordinateFrame::toWorldSpace(const AABox& b) const {
     Box b2(b);
     return toWorldSpace(b2);
@@ -435,56 +463,69 @@ CoordinateFrame CoordinateFrame::lerp(
 } 
 
 
-void CoordinateFrame::pointToWorldSpace(const Array<Vector3>& v, Array<Vector3>& vout) const {
+/** vout[i] = m * (v[i] + pre) + t, four points at a time.  v and vout may
+    be the same array.  \a pre is added before the rotation so that
+    inverse transforms do not cancel large terms, as R^T v - R^T t does. */
+static void transformArray(const Matrix3& m, const Vector3& t, const Array<Vector3>& v, Array<Vector3>& vout,
+                           const Vector3& pre = Vector3::zero()) {
     vout.resize(v.size());
 
-    for (int i = 0; i < v.size(); ++i) {
-        vout[i] = pointToWorldSpace(v[i]);
+    const Float4 m00(m[0][0]), m01(m[0][1]), m02(m[0][2]);
+    const Float4 m10(m[1][0]), m11(m[1][1]), m12(m[1][2]);
+    const Float4 m20(m[2][0]), m21(m[2][1]), m22(m[2][2]);
+    const Vector3x4 translation(t);
+    const Vector3x4 preTranslation(pre);
+
+    const Vector3* src = v.getCArray();
+    Vector3* dst = vout.getCArray();
+    const int n = v.size();
+    for (int i = 0; i < n; i += Vector3x4::SIZE) {
+        const int count = min(n - i, int(Vector3x4::SIZE));
+        const Vector3x4 p = Vector3x4::load(src + i, count) + preTranslation;
+        const Vector3x4 r(m00 * p.x + m01 * p.y + m02 * p.z,
+                          m10 * p.x + m11 * p.y + m12 * p.z,
+                          m20 * p.x + m21 * p.y + m22 * p.z);
+        (r + translation).store(dst + i, count);
     }
 }
 
 
-void CoordinateFrame::normalToWorldSpace(const Array<Vector3>& v, Array<Vector3>& vout) const  {
-    vout.resize(v.size());
+void CoordinateFrame::pointToWorldSpace(const Array<Vector3>& v, Array<Vector3>& vout) const {
+    transformArray(rotation, translation, v, vout);
+}
 
-    for (int i = 0; i < v.size(); ++i) {
-        vout[i] = normalToWorldSpace(v[i]);
-    }
+
+void CoordinateFrame::normalToWorldSpace(const Array<Vector3>& v, Array<Vector3>& vout) const  {
+    transformArray(rotation, Vector3::zero(), v, vout);
 }
 
 
 void CoordinateFrame::vectorToWorldSpace(const Array<Vector3>& v, Array<Vector3>& vout) const {
-    vout.resize(v.size());
-
-    for (int i = v.size() - 1; i >= 0; --i) {
-        vout[i] = vectorToWorldSpace(v[i]);
-    }
+    transformArray(rotation, Vector3::zero(), v, vout);
 }
 
 
 void CoordinateFrame::pointToObjectSpace(const Array<Vector3>& v, Array<Vector3>& vout) const {
-    vout.resize(v.size());
-
-    for (int i = v.size() - 1; i >= 0; --i) {
-        vout[i] = pointToObjectSpace(v[i]);
-    }
+    // R^T (v - t), subtracting first as the scalar pointToObjectSpace does
+    transformArray(rotation.transpose(), Vector3::zero(), v, vout, -translation);
 }
 
 
 void CoordinateFrame::normalToObjectSpace(const Array<Vector3>& v, Array<Vector3>& vout) const {
-    vout.resize(v.size());
-
-    for (int i = v.size() - 1; i >= 0; --i) {
-        vout[i] = normalToObjectSpace(v[i]);
-    }
+    transformArray(rotation.transpose(), Vector3::zero(), v, vout);
 }
 
 
 void CoordinateFrame::vectorToObjectSpace(const Array<Vector3>& v, Array<Vector3>& vout) const {
-    vout.resize(v.size());
+    transformArray(rotation.transpose(), Vector3::zero(), v, vout);
+}
+
 
-    for (int i = v.size() - 1; i >= 0; --i) {
-        vout[i] = vectorToObjectSpace(v[i]);
+void CoordinateFrame::toWorldSpace(const Array<AABox>& b, Array<AABox>& result) const {
+    result.resize(b.size());
+    const Matrix3 absRotation = absoluteValue(rotation);
+    for (int i = 0; i < b.size(); ++i) {
+        boundsToWorldSpace(*this, absRotation, b[i], result[i]);
     }
 }
 
@@ -46,6 +46,269 @@ static FileSystem* common = NULL;
 
 GMutex FileSystem::mutex;
 
+#if _HAVE_ZIP /* G3DFIX: Use ZIP-library only if defined */
+namespace _internal {
+
+/**
+ An open zipfile with a hashed index of its central directory.
+
+ A libzip handle may only be used by one thread at a time, so each read
+ borrows a handle from m_idle and opens another one when all are busy.
+ Only the first handle is opened with a consistency check.
+ */
+class ZipArchive {
+private:
+
+    std::string                 m_filename;
+
+    /** Lowercase entry name to entry number */
+    Table<std::string, int>     m_index;
+
+    /** Entry names as stored in the zipfile */
+    Array<std::string>          m_name;
+
+    /** Uncompressed entry sizes */
+    Array<int64>                m_size;
+
+    /** Modification time and length of the zipfile when it was indexed */
+    time_t                      m_modified;
+    int64                       m_length;
+
+    /** Protects m_idle */
+    GMutex                      m_mutex;
+
+    /** Open handles not currently in use by any thread */
+    Array<struct zip*>          m_idle;
+
+    ZipArchive(const std::string& filename, time_t modified, int64 length) :
+        m_filename(filename), m_modified(modified), m_length(length) {}
+
+    struct zip* acquire() {
+        {
+            GMutexLock lock(&m_mutex);
+            if (m_idle.size() > 0) {
+                return m_idle.pop();
+            }
+        }
+        return zip_open(m_filename.c_str(), 0, NULL);
+    }
+
+    void release(struct zip* z) {
+        GMutexLock lock(&m_mutex);
+        m_idle.append(z);
+    }
+
+public:
+
+    /** Returns NULL if \a filename is not a readable zipfile */
+    static shared_ptr<ZipArchive> create(const std::string& filename, time_t modified, int64 length) {
+        struct zip* z = zip_open(filename.c_str(), ZIP_CHECKCONS, NULL);
+        if (z == NULL) {
+            return shared_ptr<ZipArchive>();
+        }
+
+        shared_ptr<ZipArchive> archive(new ZipArchive(filename, modified, length));
+
+        const int count = zip_get_num_files(z);
+        archive->m_name.resize(count);
+        archive->m_size.resize(count);
+        for (int i = 0; i < count; ++i) {
+            struct zip_stat info;
+            zip_stat_init(&info);
+            zip_stat_index(z, i, 0, &info);
+            archive->m_name[i] = info.name;
+            archive->m_size[i] = info.size;
+
+            // Match the first entry, as zip_name_locate does
+            const std::string& key = toLower(archive->m_name[i]);
+            if (! archive->m_index.containsKey(key)) {
+                archive->m_index.set(key, i);
+            }
+        }
+
+        archive->m_idle.append(z);
+        return archive;
+    }
+
+    ~ZipArchive() {
+        for (int i = 0; i < m_idle.size(); ++i) {
+            zip_close(m_idle[i]);
+        }
+    }
+
+    /** True if the zipfile has not changed on disk since it was indexed */
+    bool current(time_t modified, int64 length) const {
+        return (modified == m_modified) && (length == m_length);
+    }
+
+    /** Entry number of \a name (case insensitive), or -1 */
+    int find(const std::string& name) const {
+        const int* e = m_index.getPointer(toLower(name));
+        return (e == NULL) ? -1 : *e;
+    }
+
+    int64 size(int e) const {
+        return m_size[e];
+    }
+
+    const Array<std::string>& names() const {
+        return m_name;
+    }
+
+    /** Safe to call from multiple threads */
+    bool read(int e, void* dst, int64 numBytes) {
+        struct zip* z = acquire();
+        if (z == NULL) {
+            return false;
+        }
+
+        int64 total = 0;
+        struct zip_file* zf = zip_fopen_index(z, e, 0);
+        if (zf != NULL) {
+            while (total < numBytes) {
+                const int64 n = zip_fread(zf, static_cast<uint8*>(dst) + total, numBytes - total);
+                if (n <= 0) {
+                    break;
+                }
+                total += n;
+            }
+            zip_fclose(zf);
+        }
+
+        release(z);
+        return (zf != NULL) && (total == numBytes);
+    }
+};
+
+
+/** Zipfiles that have been opened, keyed by resolved path (lowercase on Windows) */
+class ZipCache {
+public:
+    GMutex                                          mutex;
+    Table<std::string, shared_ptr<ZipArchive> >     table;
+};
+
+} // namespace _internal
+
+
+static _internal::ZipCache& zipCache() {
+    static _internal::ZipCache c;
+    return c;
+}
+
+
+static std::string zipCacheKey(const std::string& zipfile) {
+    const std::string& key = FilePath::canonicalize(FilePath::removeTrailingSlash(FileSystem::resolve(zipfile)));
+#   ifdef G3D_WINDOWS
+        return toLower(key);
+#   else
+        return key;
+#   endif
+}
+
+
+/** Returns the cached archive for \a zipfile, opening it if it is not cached
+    or has changed on disk.  Returns NULL if it cannot be opened. */
+static shared_ptr<_internal::ZipArchive> zipArchive(const std::string& zipfile) {
+    // Resolve before taking the cache lock, since resolve() takes FileSystem::mutex
+    const std::string& key = zipCacheKey(zipfile);
+
+    struct _stat st;
+    const bool found = (_stat(key.c_str(), &st) != -1);
+
+    _internal::ZipCache& cache = zipCache();
+    GMutexLock lock(&cache.mutex);
+
+    if (! found) {
+        cache.table.remove(key);
+        return shared_ptr<_internal::ZipArchive>();
+    }
+
+    shared_ptr<_internal::ZipArchive>* cached = cache.table.getPointer(key);
+    if ((cached != NULL) && (*cached)->current(st.st_mtime, st.st_size)) {
+        return *cached;
+    }
+
+    const shared_ptr<_internal::ZipArchive>& archive = _internal::ZipArchive::create(key, st.st_mtime, st.st_size);
+    if (notNull(archive)) {
+        cache.table.set(key, archive);
+    } else {
+        cache.table.remove(key);
+    }
+    return archive;
+}
+
+
+/** Closes cached zipfiles at or below \a prefix, which is in the form produced by
+    zipCacheKey.  "" closes all of them.  Threads that are reading from an evicted
+    zipfile keep it open until they finish. */
+static void clearZipCache(const std::string& prefix) {
+    _internal::ZipCache& cache = zipCache();
+    GMutexLock lock(&cache.mutex);
+
+    if (prefix == "") {
+        cache.table.clear();
+    } else {
+        const std::string& prefixSlash = prefix + "/";
+        Array<std::string> keys;
+        cache.table.getKeys(keys);
+        for (int k = 0; k < keys.size(); ++k) {
+            if ((keys[k] == prefix) || beginsWith(keys[k], prefixSlash)) {
+                cache.table.remove(keys[k]);
+            }
+        }
+    }
+}
+#endif
+
+
+int64 FileSystem::zipEntrySize(const std::string& zipfile, const std::string& entry) {
+#if _HAVE_ZIP /* G3DFIX: Use ZIP-library only if defined */
+    const shared_ptr<_internal::ZipArchive>& archive = zipArchive(zipfile);
+    if (isNull(archive)) {
+        return -1;
+    }
+    const int e = archive->find(FilePath::canonicalize(entry));
+    return (e == -1) ? -1 : archive->size(e);
+#else
+    (void)zipfile;
+    (void)entry;
+    return -1;
+#endif
+}
+
+
+bool FileSystem::readZipEntry(const std::string& zipfile, const std::string& entry, void* dst, int64 numBytes) {
+#if _HAVE_ZIP /* G3DFIX: Use ZIP-library only if defined */
+    const shared_ptr<_internal::ZipArchive>& archive = zipArchive(zipfile);
+    if (isNull(archive)) {
+        return false;
+    }
+    const int e = archive->find(FilePath::canonicalize(entry));
+    return (e != -1) && archive->read(e, dst, numBytes);
+#else
+    (void)zipfile;
+    (void)entry;
+    (void)dst;
+    (void)numBytes;
+    return false;
+#endif
+}
+
+
+void FileSystem::getZipEntries(const std::string& zipfile, Array<std::string>& names) {
+#if _HAVE_ZIP /* G3DFIX: Use ZIP-library only if defined */
+    const shared_ptr<_internal::ZipArchive>& archive = zipArchive(zipfile);
+    if (notNull(archive)) {
+        names.append(archive->names());
+    }
+#else
+    (void)zipfile;
+    (void)names;
+#endif
+}
+
+
 FileSystem& FileSystem::instance() {
     init();
     return *common;
@@ -64,6 +327,9 @@ void FileSystem::cleanup() {
         delete common;
         common = NULL;
     }
+#   if _HAVE_ZIP /* G3DFIX: Use ZIP-library only if defined */
+        clearZipCache("");
+#   endif
 }
 
 FileSystem::FileSystem() : m_cacheLifetime(10) {}
@@ -88,18 +354,13 @@ bool FileSystem::Dir::contains(const std::string& f, bool caseSensitive) const {
 void FileSystem::Dir::computeZipListing(const std::string& zipfile, const std::string& _pathInsideZipfile) {
 #if _HAVE_ZIP /* G3DFIX: Use ZIP-library only if defined */
     const std::string& pathInsideZipfile = FilePath::canonicalize(_pathInsideZipfile);
-    struct zip* z = zip_open( FilePath::removeTrailingSlash(zipfile).c_str(), ZIP_CHECKCONS, NULL );
-    debugAssert(z);
+    Array<std::string> entry;
+    getZipEntries(FilePath::removeTrailingSlash(zipfile), entry);
 
-    int count = zip_get_num_files( z );
     Set<std::string> alreadyAdded;
-    for (int i = 0; i < count; ++i) {
-        struct zip_stat info;
-        zip_stat_init( &info );    // TODO: Docs unclear if zip_stat_init is required.
-        zip_stat_index( z, i, ZIP_FL_NOCASE, &info );
-
+    for (int i = 0; i < entry.size(); ++i) {
         // Fully-qualified name of a file inside zipfile
-        std::string name = FilePath::canonicalize(info.name);
+        std::string name = FilePath::canonicalize(entry[i]);
 
         if (beginsWith(name, pathInsideZipfile)) {
             // We found something inside the directory we were looking for,
@@ -134,9 +395,6 @@ void FileSystem::Dir::computeZipListing(const std::string& zipfile, const std::s
             }
         }
     }
-
-    zip_close(z);
-    z = NULL;
 #endif
 }
 
@@ -336,6 +594,9 @@ void FileSystem::_clearCache(const std::string& _path) {
 
     if ((path == "") || FilePath::isRoot(path)) {
         m_cache.clear();
+#       if _HAVE_ZIP /* G3DFIX: Use ZIP-library only if defined */
+            clearZipCache("");
+#       endif
     } else {
         Array<std::string> keys;
         m_cache.getKeys(keys);
@@ -354,6 +615,11 @@ void FileSystem::_clearCache(const std::string& _path) {
                 m_cache.remove(keys[k]);
             }
         }
+
+#       if _HAVE_ZIP /* G3DFIX: Use ZIP-library only if defined */
+            // Zipfiles that were rewritten must be reopened
+            clearZipCache(prefix);
+#       endif
     }
 }
 
@@ -584,19 +850,8 @@ int64 FileSystem::_size(const std::string& _filename) {
 #if _HAVE_ZIP /* G3DFIX: Use ZIP-library only if defined */
         std::string zip, contents;
         if (zipfileExists(filename, zip, contents)) {
-            int64 requiredMem;
-
-            struct zip *z = zip_open( zip.c_str(), ZIP_CHECKCONS, NULL );
-            debugAssertM(z != NULL, zip + ": zip open failed.");
-            {
-                struct zip_stat info;
-                zip_stat_init( &info );    // Docs unclear if zip_stat_init is required.
-                int success = zip_stat( z, contents.c_str(), ZIP_FL_NOCASE, &info );
-                (void) success;
-                debugAssertM(success == 0, zip + ": " + contents + ": zip stat failed.");
-                requiredMem = info.size;
-            }
-            zip_close(z);
+            const int64 requiredMem = zipEntrySize(zip, contents);
+            debugAssertM(requiredMem != -1, zip + ": " + contents + ": zip stat failed.");
             return requiredMem;
         } else {
 #endif
@@ -174,17 +174,23 @@ bool GThread::completed() const {
 
 
 void GThread::waitForCompletion() {
-    if (m_status == STATUS_COMPLETED) {
-        // Must be done
-        return;
-    }
-
 #   ifdef G3D_WINDOWS
+        if (m_status == STATUS_COMPLETED) {
+            // Must be done
+            return;
+        }
+
         debugAssert(m_event);
         ::WaitForSingleObject(m_event, INFINITE);
 #   else
-        debugAssert(m_handle);
-        pthread_join(m_handle, NULL);
+        // Join even if the thread has already completed, so that its
+        // resources are released
+        if (m_handle) {
+            pthread_join(m_handle, NULL);
+
+            // system-independent clear of handle
+            System::memset(&m_handle, 0, sizeof(m_handle));
+        }
 #   endif
 }
 
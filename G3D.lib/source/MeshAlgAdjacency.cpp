@@ -36,7 +36,7 @@ public:
     /** We expect at most 6 edges per vertex; that matches a typical regular grid mesh */
     typedef SmallArray<Edge, 6> EdgeArray;
 
-    typedef Array< EdgeArray > ET;
+    typedef Array< EdgeArray, 10, MemoryManagerAllocator > ET;
 
 private:
     
@@ -0,0 +1,357 @@
+/**
+  \file G3D.lib/source/SweepAndPrune.cpp
+
+  \created 2026-10-18
+  \edited  2026-10-18
+*/
+
+#include "G3D/SweepAndPrune.h"
+#include "G3D/g3dmath.h"
+#include <algorithm>
+
+namespace G3D {
+
+bool SweepAndPrune::Proxy::hasNeighbor(int other) const {
+    for (int i = 0; i < neighbor.size(); ++i) {
+        if (neighbor[i] == other) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void SweepAndPrune::Proxy::removeNeighbor(int other) {
+    for (int i = 0; i < neighbor.size(); ++i) {
+        if (neighbor[i] == other) {
+            neighbor.fastRemove(i);
+            return;
+        }
+    }
+}
+
+
+SweepAndPrune::SweepAndPrune(int axisMask) : m_axisMask(axisMask), m_numAxes(0), m_size(0) {
+    alwaysAssertM((axisMask & ALL_AXES) != 0 && (axisMask & ~ALL_AXES) == 0,
+                  "SweepAndPrune needs at least one of the X, Y, and Z axes");
+    for (int axis = 0; axis < 3; ++axis) {
+        if (axisMask & (1 << axis)) {
+            m_axis[m_numAxes] = axis;
+            ++m_numAxes;
+        }
+    }
+}
+
+
+void SweepAndPrune::clear() {
+    for (int a = 0; a < 3; ++a) {
+        m_endpoint[a].clear();
+        m_endpointIndex[a].clear();
+    }
+    m_proxy.clear();
+    m_freeList.clear();
+    m_removedList.clear();
+    m_pendingList.clear();
+    m_candidate.clear();
+    m_size = 0;
+}
+
+
+int SweepAndPrune::insert(const AABox& bounds) {
+    debugAssertM(! bounds.isEmpty(), "Cannot insert empty bounds into SweepAndPrune");
+
+    int id;
+    if (m_freeList.size() > 0) {
+        id = m_freeList.pop();
+    } else {
+        id = m_proxy.size();
+        m_proxy.next();
+        for (int a = 0; a < m_numAxes; ++a) {
+            m_endpointIndex[a].append(NONE, NONE);
+        }
+    }
+
+    Proxy& proxy = m_proxy[id];
+    proxy.bounds = bounds;
+    proxy.state = PENDING;
+    proxy.neighbor.clear();
+    m_pendingList.append(id);
+    ++m_size;
+
+    return id;
+}
+
+
+void SweepAndPrune::remove(int id) {
+    debugAssert(id >= 0 && id < m_proxy.size());
+    Proxy& proxy = m_proxy[id];
+    debugAssertM((proxy.state == ACTIVE) || (proxy.state == PENDING),
+                 "Tried to remove a proxy that is not in the SweepAndPrune");
+
+    if (proxy.state == ACTIVE) {
+        for (int i = 0; i < proxy.neighbor.size(); ++i) {
+            m_candidate.append(Pair(id, proxy.neighbor[i]));
+        }
+    }
+
+    // The ID is held until getChangedPairs() so that pairs reported as
+    // removed cannot be confused with pairs of a new proxy
+    proxy.state = REMOVED;
+    m_removedList.append(id);
+    --m_size;
+}
+
+
+void SweepAndPrune::update(int id, const AABox& bounds) {
+    debugAssert(id >= 0 && id < m_proxy.size());
+    Proxy& proxy = m_proxy[id];
+    debugAssertM((proxy.state == ACTIVE) || (proxy.state == PENDING),
+                 "Tried to update a proxy that is not in the SweepAndPrune");
+    debugAssertM(! bounds.isEmpty(), "Cannot move a proxy to empty bounds");
+
+    proxy.bounds = bounds;
+    if (proxy.state == PENDING) {
+        return;
+    }
+
+    for (int a = 0; a < m_numAxes; ++a) {
+        const int axis = m_axis[a];
+        Array<Endpoint>& endpoint = m_endpoint[a];
+        int* index = m_endpointIndex[a].getCArray() + 2 * id;
+        const int lo = index[0];
+        const int hi = index[1];
+
+        // Move the endpoint on the leading side first so that the minimum
+        // and maximum never pass each other
+        const bool maxFirst = bounds.high()[axis] > endpoint[hi].value;
+        endpoint[lo].value = bounds.low()[axis];
+        endpoint[hi].value = bounds.high()[axis];
+
+        if (maxFirst) {
+            sortEndpoint(a, hi);
+            sortEndpoint(a, index[0]);
+        } else {
+            sortEndpoint(a, lo);
+            sortEndpoint(a, index[1]);
+        }
+    }
+}
+
+
+void SweepAndPrune::sortEndpoint(int a, int i) {
+    Array<Endpoint>& endpoint = m_endpoint[a];
+    int* index = m_endpointIndex[a].getCArray();
+    const Endpoint e = endpoint[i];
+    const int id = e.proxy();
+    const bool isMax = e.isMax();
+    const Proxy& proxy = m_proxy[id];
+
+    // Overlap along this axis changes only when a minimum passes a
+    // maximum.  The pair is a candidate if it now overlaps on every axis
+    // or if it overlapped at the last getChangedPairs().  The last swap of
+    // any pair whose overlap changes passes this test, because the moving
+    // proxy already has its new bounds.
+    while ((i > 0) && (e < endpoint[i - 1])) {
+        const Endpoint& f = endpoint[i - 1];
+        if (f.isMax() != isMax) {
+            addCandidate(proxy, id, f.proxy(), ! isMax);
+        }
+        endpoint[i] = f;
+        index[f.data] = i;
+        --i;
+    }
+
+    while ((i < endpoint.size() - 1) && (endpoint[i + 1] < e)) {
+        const Endpoint& f = endpoint[i + 1];
+        if (f.isMax() != isMax) {
+            addCandidate(proxy, id, f.proxy(), isMax);
+        }
+        endpoint[i] = f;
+        index[f.data] = i;
+        ++i;
+    }
+
+    endpoint[i] = e;
+    index[e.data] = i;
+}
+
+
+void SweepAndPrune::resetEndpointIndices(int a) {
+    const Array<Endpoint>& endpoint = m_endpoint[a];
+    int* index = m_endpointIndex[a].getCArray();
+    for (int i = 0; i < endpoint.size(); ++i) {
+        index[endpoint[i].data] = i;
+    }
+}
+
+
+void SweepAndPrune::compactEndpoints() {
+    for (int a = 0; a < m_numAxes; ++a) {
+        Array<Endpoint>& endpoint = m_endpoint[a];
+        int j = 0;
+        for (int i = 0; i < endpoint.size(); ++i) {
+            if (m_proxy[endpoint[i].proxy()].state != REMOVED) {
+                endpoint[j] = endpoint[i];
+                ++j;
+            }
+        }
+        endpoint.resize(j, DONT_SHRINK_UNDERLYING_ARRAY);
+        resetEndpointIndices(a);
+    }
+}
+
+
+void SweepAndPrune::insertPending() {
+    // Skip proxies that were removed before they were ever sorted
+    int k = 0;
+    for (int i = 0; i < m_pendingList.size(); ++i) {
+        if (m_proxy[m_pendingList[i]].state == PENDING) {
+            m_pendingList[k] = m_pendingList[i];
+            ++k;
+        }
+    }
+    m_pendingList.resize(k, DONT_SHRINK_UNDERLYING_ARRAY);
+    if (k == 0) {
+        return;
+    }
+
+    // Inserting one at a time moves each new endpoint past about half of
+    // the others; re-sorting costs O(m log m) for m endpoints in total.
+    const float n = float(m_endpoint[0].size());
+    const float m = n + 2.0f * float(k);
+    if (float(k) * (n + float(k)) > 2.0f * m * log2(m + 2.0f)) {
+        insertPendingBySorting();
+        return;
+    }
+
+    for (int p = 0; p < m_pendingList.size(); ++p) {
+        const int id = m_pendingList[p];
+        Proxy& proxy = m_proxy[id];
+        for (int a = 0; a < m_numAxes; ++a) {
+            Array<Endpoint>& endpoint = m_endpoint[a];
+            const int axis = m_axis[a];
+
+            // Start past the end of the array, where the new proxy overlaps
+            // nothing, and slide the endpoints down into place
+            endpoint.append(Endpoint(proxy.bounds.low()[axis], id, false),
+                            Endpoint(proxy.bounds.high()[axis], id, true));
+            const int last = endpoint.size() - 1;
+            sortEndpoint(a, last - 1);
+            sortEndpoint(a, last);
+        }
+        proxy.state = ACTIVE;
+    }
+    m_pendingList.fastClear();
+}
+
+
+void SweepAndPrune::insertPendingBySorting() {
+    for (int a = 0; a < m_numAxes; ++a) {
+        Array<Endpoint>& endpoint = m_endpoint[a];
+        const int axis = m_axis[a];
+        for (int p = 0; p < m_pendingList.size(); ++p) {
+            const int id = m_pendingList[p];
+            const AABox& bounds = m_proxy[id].bounds;
+            endpoint.append(Endpoint(bounds.low()[axis], id, false),
+                            Endpoint(bounds.high()[axis], id, true));
+        }
+        std::sort(endpoint.begin(), endpoint.end());
+        resetEndpointIndices(a);
+    }
+
+    // Sweep along the first axis, keeping the proxies whose intervals
+    // contain the sweep position in an unordered active list
+    Array<int> active;
+    const Array<Endpoint>& endpoint = m_endpoint[0];
+    for (int i = 0; i < endpoint.size(); ++i) {
+        const Endpoint& e = endpoint[i];
+        const int id = e.proxy();
+        Proxy& proxy = m_proxy[id];
+
+        if (e.isMax()) {
+            const int j = proxy.activeIndex;
+            const int last = active.last();
+            active[j] = last;
+            m_proxy[last].activeIndex = j;
+            active.popDiscard();
+            proxy.activeIndex = NONE;
+        } else {
+            const bool isNew = (proxy.state == PENDING);
+            for (int j = 0; j < active.size(); ++j) {
+                const Proxy& other = m_proxy[active[j]];
+                if ((isNew || (other.state == PENDING)) && overlaps(proxy.bounds, other.bounds)) {
+                    m_candidate.append(Pair(id, active[j]));
+                }
+            }
+            proxy.activeIndex = active.size();
+            active.append(id);
+        }
+    }
+
+    for (int p = 0; p < m_pendingList.size(); ++p) {
+        m_proxy[m_pendingList[p]].state = ACTIVE;
+    }
+    m_pendingList.fastClear();
+}
+
+
+void SweepAndPrune::getChangedPairs(Array<Pair>& added, Array<Pair>& removed) {
+    if (m_removedList.size() > 0) {
+        compactEndpoints();
+    }
+    insertPending();
+
+    // A pair may appear several times; after the first, its recorded
+    // state agrees with its bounds and nothing more is reported
+    for (int c = 0; c < m_candidate.size(); ++c) {
+        const Pair& pair = m_candidate[c];
+        Proxy& a = m_proxy[pair.first];
+        Proxy& b = m_proxy[pair.second];
+
+        const bool wasOverlapping = a.hasNeighbor(pair.second);
+        const bool isOverlapping = (a.state == ACTIVE) && (b.state == ACTIVE) &&
+            overlaps(a.bounds, b.bounds);
+
+        if (wasOverlapping && ! isOverlapping) {
+            a.removeNeighbor(pair.second);
+            b.removeNeighbor(pair.first);
+            removed.append(pair);
+        } else if (isOverlapping && ! wasOverlapping) {
+            a.neighbor.append(pair.second);
+            b.neighbor.append(pair.first);
+            added.append(pair);
+        }
+    }
+    m_candidate.fastClear();
+
+    for (int i = 0; i < m_removedList.size(); ++i) {
+        const int id = m_removedList[i];
+        m_proxy[id].state = FREE;
+        m_proxy[id].neighbor.clear();
+        m_freeList.append(id);
+    }
+    m_removedList.fastClear();
+}
+
+
+void SweepAndPrune::getPairs(Array<Pair>& pairs) const {
+    for (int id = 0; id < m_proxy.size(); ++id) {
+        const Proxy& proxy = m_proxy[id];
+        for (int i = 0; i < proxy.neighbor.size(); ++i) {
+            if (id < proxy.neighbor[i]) {
+                pairs.append(Pair(id, proxy.neighbor[i]));
+            }
+        }
+    }
+}
+
+
+void SweepAndPrune::getOverlapping(int id, Array<int>& overlapping) const {
+    debugAssert(id >= 0 && id < m_proxy.size());
+    const Proxy& proxy = m_proxy[id];
+    for (int i = 0; i < proxy.neighbor.size(); ++i) {
+        overlapping.append(proxy.neighbor[i]);
+    }
+}
+
+} // namespace G3D
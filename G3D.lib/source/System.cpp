@@ -32,11 +32,16 @@
 
 #include <cstring>
 #include <cstdio>
+#include <new>
 
 // Uncomment the following line to turn off G3D::System memory
 // allocation and use the operating system's malloc.
 //#define NO_BUFFERPOOL
 
+// Uncomment the following line to make every thread allocate directly
+// from the shared (locked) buffer pool instead of a per-thread cache.
+//#define NO_MALLOC_THREAD_CACHE
+
 #include <cstdlib>
 
 #ifdef G3D_WINDOWS
@@ -79,6 +84,9 @@
 
 // SIMM include
 #include <xmmintrin.h>
+#ifdef G3D_SSE2
+#   include <emmintrin.h>
+#endif
 
 
 namespace G3D {
@@ -708,6 +716,48 @@ void System::memset(void* dst, uint8 value, size_t numBytes) {
 }
 
 
+void System::memcpyFlipEndian(void* dst, const void* src, size_t elementSize, size_t numElements) {
+    debugAssert((elementSize == 1) || (elementSize == 2) || (elementSize == 4) || (elementSize == 8));
+    const size_t numBytes = elementSize * numElements;
+    const uint8* s = (const uint8*)src;
+    uint8*       d = (uint8*)dst;
+
+    if (elementSize == 1) {
+        if (d != s) {
+            ::memcpy(d, s, numBytes);
+        }
+        return;
+    }
+
+    size_t i = 0;
+#ifdef G3D_SSE2
+    // Reverse the 16-bit words within each element with shuffles, then swap
+    // the two bytes of every word with shifts.  16 bytes is a whole number
+    // of elements, so the scalar loop below starts on an element boundary.
+    for (; i + 16 <= numBytes; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(s + i));
+        if (elementSize == 4) {
+            x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+            x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+        } else if (elementSize == 8) {
+            x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+            x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+        }
+        x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+        _mm_storeu_si128((__m128i*)(d + i), x);
+    }
+#endif
+
+    for (; i < numBytes; i += elementSize) {
+        uint8 element[8];
+        ::memcpy(element, s + i, elementSize);
+        for (size_t b = 0; b < elementSize; ++b) {
+            d[i + b] = element[elementSize - 1 - b];
+        }
+    }
+}
+
+
 /** Removes the 'd' that icompile / Morgan's VC convention appends. */
 static std::string computeAppName(const std::string& start) {
     if (start.size() < 2) {
@@ -987,6 +1037,24 @@ public:
      */
     enum {maxTinyBuffers = 250000, maxSmallBuffers = 40000, maxMedBuffers = 5000};
 
+    /** 
+       Small and medium buffers are rounded up to one of these
+       power-of-two size classes (2x, 4x, ... 32x tinyBufferSize, the
+       last of which is medBufferSize) so that every block on a free
+       list can satisfy every request for its class.
+     */
+    enum {numSizeClasses = 5};
+
+    /** Bytes that one thread may hold in each of its cache bins before
+        half of the bin is returned to the shared pool. */
+    enum {threadCacheBytesPerBin = 32 * 1024};
+
+    enum {maxThreadCacheBinSize = threadCacheBytesPerBin / tinyBufferSize};
+
+    /** Number of mallocs after which a thread adds its counters to the
+        shared ones even if it has not needed the shared pool. */
+    enum {threadCachePublishInterval = 256};
+
 private:
 
     /** Pointer given to the program.  Unless in the tiny heap, the user size of the block is stored right in front of the pointer as a uint32.*/
@@ -995,19 +1063,52 @@ private:
     /** Actual block allocated on the heap */
     typedef void* RealPtr;
 
-    class MemBlock {
-    public:
-        UserPtr     ptr;
-        size_t      bytes;
+public:
 
-        inline MemBlock() : ptr(NULL), bytes(0) {}
-        inline MemBlock(UserPtr p, size_t b) : ptr(p), bytes(b) {}
+    /** 
+      Per-thread free lists in front of the shared pool, so that most
+      System::malloc and System::free calls never touch m_lock.  Blocks
+      move between a ThreadCache and the shared pool in batches of half
+      a bin, and everything is returned to the shared pool when the
+      thread exits.
+     */
+    class ThreadCache {
+    public:
+        enum {numBins = numSizeClasses + 1};
+
+        /** Bin 0 holds tiny heap buffers; bin c + 1 holds blocks of sizeClassBytes(c). */
+        UserPtr     bin[numBins][maxThreadCacheBinSize];
+        int         binSize[numBins];
+
+        /** Counters that have not been added to the BufferPool's yet */
+        int         totalMallocs;
+        int         mallocsFromTinyPool;
+        int         mallocsFromSmallPool;
+        int         mallocsFromMedPool;
+        int         mallocsFromThreadCache;
+
+        /** BufferPool::counterEpoch when the counters were last
+            published; counters from before a reset are discarded. */
+        int         counterEpoch;
+
+        ThreadCache() : totalMallocs(0), mallocsFromTinyPool(0), mallocsFromSmallPool(0),
+            mallocsFromMedPool(0), mallocsFromThreadCache(0), counterEpoch(0) {
+            for (int b = 0; b < numBins; ++b) {
+                binSize[b] = 0;
+            }
+        }
     };
 
-    MemBlock smallPool[maxSmallBuffers];
-    int smallPoolSize;
+private:
 
-    MemBlock medPool[maxMedBuffers];
+    /** Free lists of small and medium blocks, one per size class.  Every
+        block in classPool[c] is exactly sizeClassBytes(c) bytes long. */
+    UserPtr* classPool[numSizeClasses];
+    int classPoolSize[numSizeClasses];
+
+    /** Total number of blocks in the small and medium size classes, 
+        limited by maxSmallBuffers and maxMedBuffers */
+    int smallPoolSize;
     int medPoolSize;
 
     /** The tiny pool is a single block of storage into which all tiny
@@ -1022,6 +1123,9 @@ private:
 
     Spinlock            m_lock;
 
+    /** Incremented by resetCounters() */
+    int                 counterEpoch;
+
     void lock() {
         m_lock.lock();
     }
@@ -1030,6 +1134,46 @@ private:
         m_lock.unlock();
     }
 
+    static size_t sizeClassBytes(int c) {
+        return size_t(tinyBufferSize) << (c + 1);
+    }
+
+    static bool isSmallClass(int c) {
+        return sizeClassBytes(c) <= size_t(smallBufferSize);
+    }
+
+    /** Smallest size class that holds \a bytes, or -1 if it is larger than medBufferSize */
+    static int sizeClassForMalloc(size_t bytes) {
+        for (int c = 0; c < numSizeClasses; ++c) {
+            if (bytes <= sizeClassBytes(c)) {
+                return c;
+            }
+        }
+        return -1;
+    }
+
+    /** Size class of a pooled block of \a bytes, or -1 if the block
+        was allocated directly from the heap */
+    static int sizeClassForFree(size_t bytes) {
+        if (bytes > size_t(medBufferSize)) {
+            return -1;
+        }
+        for (int c = numSizeClasses - 1; c >= 0; --c) {
+            if (bytes >= sizeClassBytes(c)) {
+                return c;
+            }
+        }
+        return -1;
+    }
+
+    static int binCapacity(int b) {
+        if (b == 0) {
+            return maxThreadCacheBinSize;
+        } else {
+            return max(4, int(threadCacheBytesPerBin / sizeClassBytes(b - 1)));
+        }
+    }
+
     /** 
      Malloc out of the tiny heap. Returns NULL if allocation failed.
      */
@@ -1091,42 +1235,277 @@ private:
 
     }
 
-    void flushPool(MemBlock* pool, int& poolSize) {
-        for (int i = 0; i < poolSize; ++i) {
-            bytesAllocated -= USERSIZE_TO_REALSIZE(pool[i].bytes);
-            ::free(USERPTR_TO_REALPTR(pool[i].ptr));
-            pool[i].ptr = NULL;
-            pool[i].bytes = 0;
+    /** Frees every pooled small and medium block.  Call with m_lock held. */
+    void flushPools() {
+        for (int c = 0; c < numSizeClasses; ++c) {
+            for (int i = 0; i < classPoolSize[c]; ++i) {
+                bytesAllocated -= USERSIZE_TO_REALSIZE(sizeClassBytes(c));
+                ::free(USERPTR_TO_REALPTR(classPool[c][i]));
+                classPool[c][i] = NULL;
+            }
+            classPoolSize[c] = 0;
+        }
+        smallPoolSize = 0;
+        medPoolSize   = 0;
+    }
+
+
+    /** Allocate out of the pool for size class \a c.  Return NULL if
+        the pool is empty.  Call with m_lock held. */
+    UserPtr classMalloc(int c) {
+        if (classPoolSize[c] == 0) {
+            return NULL;
+        }
+
+        if (isSmallClass(c)) {
+            --smallPoolSize;
+        } else {
+            --medPoolSize;
+        }
+
+        --classPoolSize[c];
+        UserPtr ptr = classPool[c][classPoolSize[c]];
+        classPool[c][classPoolSize[c]] = NULL;
+        return ptr;
+    }
+
+
+    /** Return a block of size class \a c to its pool, or to the
+        operating system if the pool is full.  Call with m_lock held. */
+    void classFree(UserPtr ptr, int c) {
+        int& poolSize = isSmallClass(c) ? smallPoolSize : medPoolSize;
+        const int maxPoolSize = isSmallClass(c) ? maxSmallBuffers : maxMedBuffers;
+
+        if (poolSize < maxPoolSize) {
+            classPool[c][classPoolSize[c]] = ptr;
+            ++classPoolSize[c];
+            ++poolSize;
+        } else {
+            bytesAllocated -= USERSIZE_TO_REALSIZE(sizeClassBytes(c));
+            ::free(USERPTR_TO_REALPTR(ptr));
+        }
+    }
+
+
+    /** Add a thread's counters to the shared ones.  Call with m_lock held. */
+    void publishCounters(ThreadCache& cache) {
+        if (cache.counterEpoch == counterEpoch) {
+            totalMallocs           += cache.totalMallocs;
+            mallocsFromTinyPool    += cache.mallocsFromTinyPool;
+            mallocsFromSmallPool   += cache.mallocsFromSmallPool;
+            mallocsFromMedPool     += cache.mallocsFromMedPool;
+            mallocsFromThreadCache += cache.mallocsFromThreadCache;
+        }
+        cache.counterEpoch           = counterEpoch;
+        cache.totalMallocs           = 0;
+        cache.mallocsFromTinyPool    = 0;
+        cache.mallocsFromSmallPool   = 0;
+        cache.mallocsFromMedPool     = 0;
+        cache.mallocsFromThreadCache = 0;
+    }
+
+
+    /** Move up to half a bin of blocks from the shared pool into
+        cache bin \a b.  Call with m_lock held. */
+    void refillBin(ThreadCache& cache, int b) {
+        const int n = binCapacity(b) / 2;
+        int& size = cache.binSize[b];
+
+        while (size < n) {
+            UserPtr ptr = (b == 0) ? tinyMalloc(tinyBufferSize) : classMalloc(b - 1);
+            if (ptr == NULL) {
+                break;
+            }
+            cache.bin[b][size] = ptr;
+            ++size;
         }
-        poolSize = 0;
+        ++threadCacheRefills;
+    }
+
+
+    /** Move the \a n least recently freed blocks of cache bin \a b
+        back to the shared pool.  Call with m_lock held. */
+    void flushBin(ThreadCache& cache, int b, int n) {
+        int& size = cache.binSize[b];
+        n = min(n, size);
+
+        for (int i = 0; i < n; ++i) {
+            if (b == 0) {
+                tinyFree(cache.bin[b][i]);
+            } else {
+                classFree(cache.bin[b][i], b - 1);
+            }
+        }
+
+        size -= n;
+        if (size > 0) {
+            ::memmove(cache.bin[b], cache.bin[b] + n, size * sizeof(UserPtr));
+        }
+        ++threadCacheFlushes;
+    }
+
+
+    /** Pop a block from cache bin \a b, refilling the bin from the
+        shared pool when it is empty.  Returns NULL if the shared pool
+        has no blocks of that size either. */
+    UserPtr cachedMalloc(ThreadCache& cache, int b) {
+        int& size = cache.binSize[b];
+
+        if (size > 0) {
+            ++cache.mallocsFromThreadCache;
+        } else {
+            lock();
+            publishCounters(cache);
+            refillBin(cache, b);
+            unlock();
+
+            if (size == 0) {
+                return NULL;
+            }
+        }
+
+        --size;
+        return cache.bin[b][size];
+    }
+
+
+    /** Push a block onto cache bin \a b, first returning half of the
+        bin to the shared pool if it is full. */
+    void cachedFree(ThreadCache& cache, int b, UserPtr ptr) {
+        if (cache.binSize[b] == binCapacity(b)) {
+            lock();
+            publishCounters(cache);
+            flushBin(cache, b, binCapacity(b) / 2);
+            unlock();
+        }
+
+        cache.bin[b][cache.binSize[b]] = ptr;
+        ++cache.binSize[b];
+    }
+
+
+    /** Allocate from the operating system.  Call without m_lock held. */
+    UserPtr heapMalloc(size_t bytes) {
+        lock();
+        bytesAllocated += USERSIZE_TO_REALSIZE(bytes);
+        unlock();
+
+        // Allocate 4 extra bytes for our size header (unfortunate,
+        // since malloc already added its own header).
+        RealPtr ptr = ::malloc(USERSIZE_TO_REALSIZE(bytes));
+
+        if (ptr == NULL) {
+#           ifdef G3D_WINDOWS
+                // Check for memory corruption
+                alwaysAssertM(_CrtCheckMemory() == TRUE, "Heap corruption detected.");
+#           endif
+
+            // Flush memory pools to try and recover space
+            lock();
+            flushPools();
+            unlock();
+            ptr = ::malloc(USERSIZE_TO_REALSIZE(bytes));
+        }
+
+        if (ptr == NULL) {
+            if ((System::outOfMemoryCallback() != NULL) &&
+                (System::outOfMemoryCallback()(USERSIZE_TO_REALSIZE(bytes), true) == true)) {
+                // Re-attempt the malloc
+                ptr = ::malloc(USERSIZE_TO_REALSIZE(bytes));
+            }
+        }
+
+        if (ptr == NULL) {
+            if (System::outOfMemoryCallback() != NULL) {
+                // Notify the application
+                System::outOfMemoryCallback()(USERSIZE_TO_REALSIZE(bytes), false);
+            }
+#           ifdef G3D_DEBUG
+            debugPrintf("::malloc(%d) returned NULL\n", (int)USERSIZE_TO_REALSIZE(bytes));
+#           endif
+            debugAssertM(ptr != NULL, 
+                         "::malloc returned NULL. Either the "
+                         "operating system is out of memory or the "
+                         "heap is corrupt.");
+            return NULL;
+        }
+
+        ((size_t*)ptr)[0] = bytes;
+
+        return REALPTR_TO_USERPTR(ptr);
+    }
+
+
+    /** Return a block that was not pooled to the operating system. */
+    void heapFree(UserPtr ptr) {
+        size_t bytes = USERSIZE_FROM_USERPTR(ptr);
+
+        lock();
+        bytesAllocated -= USERSIZE_TO_REALSIZE(bytes);
+        unlock();
+
+        ::free(USERPTR_TO_REALPTR(ptr));
     }
 
 
-    /** Allocate out of a specific pool.  Return NULL if no suitable 
-        memory was found. */
-    UserPtr malloc(MemBlock* pool, int& poolSize, size_t bytes) {
+    /** malloc for threads without a ThreadCache */
+    UserPtr sharedMalloc(size_t bytes) {
+        lock();
+        ++totalMallocs;
 
-        // OPT: find the smallest block that satisfies the request.
+        if (bytes <= tinyBufferSize) {
 
-        // See if there's something we can use in the buffer pool.
-        // Search backwards since usually we'll re-use the last one.
-        for (int i = (int)poolSize - 1; i >= 0; --i) {
-            if (pool[i].bytes >= bytes) {
-                // We found a suitable entry in the pool.
+            UserPtr ptr = tinyMalloc(bytes);
 
-                // No need to offset the pointer; it is already offset
-                UserPtr ptr = pool[i].ptr;
+            if (ptr) {
+                ++mallocsFromTinyPool;
+                unlock();
+                return ptr;
+            }
 
-                // Remove this element from the pool, replacing it with
-                // the one from the end (same as Array::fastRemove)
-                --poolSize;
-                pool[i] = pool[poolSize];
+        } 
+        
+        // Failure to allocate a tiny buffer is allowed to flow
+        // through to a small buffer
+        const int c = sizeClassForMalloc(max(bytes, size_t(tinyBufferSize) + 1));
+        if (c >= 0) {
+            UserPtr ptr = classMalloc(c);
 
+            if (ptr) {
+                if (isSmallClass(c)) {
+                    ++mallocsFromSmallPool;
+                } else {
+                    ++mallocsFromMedPool;
+                }
+                unlock();
                 return ptr;
             }
         }
+        unlock();
 
-        return NULL;
+        return heapMalloc((c >= 0) ? sizeClassBytes(c) : bytes);
+    }
+
+
+    /** free for threads without a ThreadCache */
+    void sharedFree(UserPtr ptr) {
+        if (inTinyHeap(ptr)) {
+            lock();
+            tinyFree(ptr);
+            unlock();
+            return;
+        }
+
+        const int c = sizeClassForFree(USERSIZE_FROM_USERPTR(ptr));
+        if (c >= 0) {
+            lock();
+            classFree(ptr, c);
+            unlock();
+            return;
+        }
+
+        // Free; this is too big to store.
+        heapFree(ptr);
     }
 
 public:
@@ -1137,6 +1516,17 @@ public:
     int mallocsFromSmallPool;
     int mallocsFromMedPool;
 
+    /** Pooled allocations that were served by a ThreadCache without taking the lock */
+    int mallocsFromThreadCache;
+
+    /** Number of times a ThreadCache bin was refilled from or
+        flushed to the shared pool */
+    int threadCacheRefills;
+    int threadCacheFlushes;
+
+    /** Number of threads that currently own a ThreadCache */
+    int threadCacheCount;
+
     /** Amount of memory currently allocated (according to the application). 
         This does not count the memory still remaining in the buffer pool,
         but does count extra memory required for rounding off to the size
@@ -1152,6 +1542,12 @@ public:
         mallocsFromSmallPool = 0;
         mallocsFromMedPool   = 0;
 
+        mallocsFromThreadCache = 0;
+        threadCacheRefills   = 0;
+        threadCacheFlushes   = 0;
+        threadCacheCount     = 0;
+        counterEpoch         = 0;
+
         bytesAllocated       = 0;
 
         tinyPoolSize         = 0;
@@ -1161,6 +1557,11 @@ public:
 
         medPoolSize          = 0;
 
+        for (int c = 0; c < numSizeClasses; ++c) {
+            const size_t n = isSmallClass(c) ? maxSmallBuffers : maxMedBuffers;
+            classPool[c] = (UserPtr*)::calloc(n, sizeof(UserPtr));
+            classPoolSize[c] = 0;
+        }
 
         // Initialize the tiny heap as a bunch of pointers into one
         // pre-allocated buffer.
@@ -1182,8 +1583,10 @@ public:
 
     ~BufferPool() {
         ::free(tinyHeap);
-        flushPool(smallPool, smallPoolSize);
-        flushPool(medPool, medPoolSize);
+        flushPools();
+        for (int c = 0; c < numSizeClasses; ++c) {
+            ::free(classPool[c]);
+        }
 #if 0 //-------------------------------- old mutex
 #       ifdef G3D_WINDOWS
             DeleteCriticalSection(&mutex);
@@ -1194,9 +1597,10 @@ public:
     }
 
     
-    UserPtr realloc(UserPtr ptr, size_t bytes) {
+    /** \a cache may be NULL */
+    UserPtr realloc(UserPtr ptr, size_t bytes, ThreadCache* cache) {
         if (ptr == NULL) {
-            return malloc(bytes);
+            return malloc(bytes, cache);
         }
 
         if (inTinyHeap(ptr)) {
@@ -1206,9 +1610,9 @@ public:
             } else {
                 // Free the old pointer and malloc
                 
-                UserPtr newPtr = malloc(bytes);
+                UserPtr newPtr = malloc(bytes, cache);
                 System::memcpy(newPtr, ptr, tinyBufferSize);
-                tinyFree(ptr);
+                free(ptr, cache);
                 return newPtr;
 
             }
@@ -1223,147 +1627,129 @@ public:
             }
 
             // Need to reallocate and move
-            UserPtr newPtr = malloc(bytes);
+            UserPtr newPtr = malloc(bytes, cache);
             System::memcpy(newPtr, ptr, userSize);
-            free(ptr);
+            free(ptr, cache);
             return newPtr;
         }
     }
 
 
-    UserPtr malloc(size_t bytes) {
-        lock();
-        ++totalMallocs;
+    /** \a cache is the calling thread's ThreadCache, or NULL to use the shared pool directly */
+    UserPtr malloc(size_t bytes, ThreadCache* cache) {
+        if (cache == NULL) {
+            return sharedMalloc(bytes);
+        }
 
-        if (bytes <= tinyBufferSize) {
+        if (cache->totalMallocs >= threadCachePublishInterval) {
+            lock();
+            publishCounters(*cache);
+            unlock();
+        }
+        ++cache->totalMallocs;
 
-            UserPtr ptr = tinyMalloc(bytes);
+        if (bytes <= tinyBufferSize) {
+            UserPtr ptr = cachedMalloc(*cache, 0);
 
             if (ptr) {
-                ++mallocsFromTinyPool;
-                unlock();
+                ++cache->mallocsFromTinyPool;
                 return ptr;
             }
+        }
 
-        } 
-        
         // Failure to allocate a tiny buffer is allowed to flow
         // through to a small buffer
-        if (bytes <= smallBufferSize) {
-            
-            UserPtr ptr = malloc(smallPool, smallPoolSize, bytes);
+        const int c = sizeClassForMalloc(max(bytes, size_t(tinyBufferSize) + 1));
+        if (c >= 0) {
+            UserPtr ptr = cachedMalloc(*cache, c + 1);
 
             if (ptr) {
-                ++mallocsFromSmallPool;
-                unlock();
+                if (isSmallClass(c)) {
+                    ++cache->mallocsFromSmallPool;
+                } else {
+                    ++cache->mallocsFromMedPool;
+                }
                 return ptr;
             }
 
-        } else if (bytes <= medBufferSize) {
-            // Note that a small allocation failure does *not* fall
-            // through into a medium allocation because that would
-            // waste the medium buffer's resources.
-
-            UserPtr ptr = malloc(medPool, medPoolSize, bytes);
-
-            if (ptr) {
-                ++mallocsFromMedPool;
-                unlock();
-                debugAssertM(ptr != NULL, "BufferPool::malloc returned NULL");
-                return ptr;
-            }
+            // Round up so that the block can be reused for any
+            // request in its size class once it is freed
+            return heapMalloc(sizeClassBytes(c));
         }
 
-        bytesAllocated += USERSIZE_TO_REALSIZE(bytes);
-        unlock();
-
-        // Heap allocate
+        return heapMalloc(bytes);
+    }
 
-        // Allocate 4 extra bytes for our size header (unfortunate,
-        // since malloc already added its own header).
-        RealPtr ptr = ::malloc(USERSIZE_TO_REALSIZE(bytes));
 
+    /** \a cache is the calling thread's ThreadCache, or NULL to use the shared pool directly */
+    void free(UserPtr ptr, ThreadCache* cache) {
         if (ptr == NULL) {
-#           ifdef G3D_WINDOWS
-                // Check for memory corruption
-                alwaysAssertM(_CrtCheckMemory() == TRUE, "Heap corruption detected.");
-#           endif
-
-            // Flush memory pools to try and recover space
-            flushPool(smallPool, smallPoolSize);
-            flushPool(medPool, medPoolSize);
-            ptr = ::malloc(USERSIZE_TO_REALSIZE(bytes));
+            // Free does nothing on null pointers
+            return;
         }
 
-        if (ptr == NULL) {
-            if ((System::outOfMemoryCallback() != NULL) &&
-                (System::outOfMemoryCallback()(USERSIZE_TO_REALSIZE(bytes), true) == true)) {
-                // Re-attempt the malloc
-                ptr = ::malloc(USERSIZE_TO_REALSIZE(bytes));
-            }
+        assert(isValidPointer(ptr));
+
+        if (cache == NULL) {
+            sharedFree(ptr);
+            return;
         }
 
-        if (ptr == NULL) {
-            if (System::outOfMemoryCallback() != NULL) {
-                // Notify the application
-                System::outOfMemoryCallback()(USERSIZE_TO_REALSIZE(bytes), false);
-            }
-#           ifdef G3D_DEBUG
-            debugPrintf("::malloc(%d) returned NULL\n", (int)USERSIZE_TO_REALSIZE(bytes));
-#           endif
-            debugAssertM(ptr != NULL, 
-                         "::malloc returned NULL. Either the "
-                         "operating system is out of memory or the "
-                         "heap is corrupt.");
-            return NULL;
+        if (inTinyHeap(ptr)) {
+            cachedFree(*cache, 0, ptr);
+            return;
         }
 
-        ((size_t*)ptr)[0] = bytes;
+        const int c = sizeClassForFree(USERSIZE_FROM_USERPTR(ptr));
+        if (c >= 0) {
+            cachedFree(*cache, c + 1, ptr);
+            return;
+        }
 
-        return REALPTR_TO_USERPTR(ptr);
+        // Free; this is too big to store.
+        heapFree(ptr);
     }
 
 
-    void free(UserPtr ptr) {
-        if (ptr == NULL) {
-            // Free does nothing on null pointers
-            return;
-        }
+    void registerThreadCache(ThreadCache& cache) {
+        lock();
+        cache.counterEpoch = counterEpoch;
+        ++threadCacheCount;
+        unlock();
+    }
 
-        assert(isValidPointer(ptr));
 
-        if (inTinyHeap(ptr)) {
-            lock();
-            tinyFree(ptr);
-            unlock();
-            return;
+    /** Returns every block held by \a cache to the shared pool. Called when its thread exits. */
+    void releaseThreadCache(ThreadCache& cache) {
+        lock();
+        publishCounters(cache);
+        for (int b = 0; b < ThreadCache::numBins; ++b) {
+            flushBin(cache, b, cache.binSize[b]);
         }
+        --threadCacheCount;
+        unlock();
+    }
 
-        size_t bytes = USERSIZE_FROM_USERPTR(ptr);
 
+    void resetCounters() {
         lock();
-        if (bytes <= smallBufferSize) {
-            if (smallPoolSize < maxSmallBuffers) {
-                smallPool[smallPoolSize] = MemBlock(ptr, bytes);
-                ++smallPoolSize;
-                unlock();
-                return;
-            }
-        } else if (bytes <= medBufferSize) {
-            if (medPoolSize < maxMedBuffers) {
-                medPool[medPoolSize] = MemBlock(ptr, bytes);
-                ++medPoolSize;
-                unlock();
-                return;
-            }
-        }
-        bytesAllocated -= USERSIZE_TO_REALSIZE(bytes);
+        totalMallocs           = 0;
+        mallocsFromMedPool     = 0;
+        mallocsFromSmallPool   = 0;
+        mallocsFromTinyPool    = 0;
+        mallocsFromThreadCache = 0;
+        threadCacheRefills     = 0;
+        threadCacheFlushes     = 0;
+        // Discard the counts that threads have not published yet
+        ++counterEpoch;
         unlock();
-
-        // Free; the buffer pools are full or this is too big to store.
-        ::free(USERPTR_TO_REALPTR(ptr));
     }
 
+
+    /** Counts made by threads with a ThreadCache are included once
+        they are published, i.e., every threadCachePublishInterval
+        mallocs, whenever the thread uses the shared pool and when the
+        thread exits. */
     std::string performance() const {
         if (totalMallocs > 0) {
             int pooled = mallocsFromTinyPool +
@@ -1373,7 +1759,8 @@ public:
             int total = totalMallocs;
 
             return format("malloc performance: %5.1f%% <= %db, %5.1f%% <= %db, "
-                          "%5.1f%% <= %db, %5.1f%% > %db",
+                          "%5.1f%% <= %db, %5.1f%% > %db; "
+                          "%5.1f%% from thread caches (%d refills, %d flushes)",
                           100.0 * mallocsFromTinyPool  / total,
                           BufferPool::tinyBufferSize,
                           100.0 * mallocsFromSmallPool / total,
@@ -1381,15 +1768,20 @@ public:
                           100.0 * mallocsFromMedPool   / total,
                           BufferPool::medBufferSize,
                           100.0 * (1.0 - (double)pooled / total),
-                          BufferPool::medBufferSize);
+                          BufferPool::medBufferSize,
+                          100.0 * mallocsFromThreadCache / total,
+                          threadCacheRefills,
+                          threadCacheFlushes);
         } else {
             return "No System::malloc calls made yet.";
         }
     }
 
     std::string status() const {
-        return format("preallocated shared buffers: %5d/%d x %db",
-            maxTinyBuffers - tinyPoolSize, maxTinyBuffers, tinyBufferSize);
+        return format("preallocated shared buffers: %5d/%d x %db; "
+                      "shared pool: %d small, %d medium; %d thread caches",
+            maxTinyBuffers - tinyPoolSize, maxTinyBuffers, tinyBufferSize,
+            smallPoolSize, medPoolSize, threadCacheCount);
     }
 };
 
@@ -1398,6 +1790,58 @@ public:
 // is deallocated.
 static BufferPool* bufferpool = NULL;
 
+#if ! defined(NO_BUFFERPOOL) && ! defined(NO_MALLOC_THREAD_CACHE)
+
+/** The calling thread's cache, created by its first System::malloc */
+static __thread BufferPool::ThreadCache* threadCache = NULL;
+
+/** True once this thread's cache has been released at thread exit.
+    Later calls on the thread (e.g., from other thread-local
+    destructors) go straight to the shared pool. */
+static __thread bool threadCacheReleased = false;
+
+/** Returns the thread's cached blocks to the shared pool when the thread exits */
+class ThreadCacheOwner {
+public:
+    ~ThreadCacheOwner() {
+        if (threadCache != NULL) {
+            bufferpool->releaseThreadCache(*threadCache);
+            threadCache->~ThreadCache();
+            ::free(threadCache);
+            threadCache = NULL;
+        }
+        threadCacheReleased = true;
+    }
+};
+
+static thread_local ThreadCacheOwner threadCacheOwner;
+
+static inline BufferPool::ThreadCache* currentThreadCache() {
+    BufferPool::ThreadCache* cache = threadCache;
+
+    if ((cache == NULL) && ! threadCacheReleased) {
+        // Touching the owner registers its destructor for this thread
+        (void)&threadCacheOwner;
+
+        void* mem = ::malloc(sizeof(BufferPool::ThreadCache));
+        if (mem != NULL) {
+            cache = new (mem) BufferPool::ThreadCache();
+            bufferpool->registerThreadCache(*cache);
+            threadCache = cache;
+        }
+    }
+
+    return cache;
+}
+
+#else
+
+static inline BufferPool::ThreadCache* currentThreadCache() {
+    return NULL;
+}
+
+#endif
+
 std::string System::mallocPerformance() {    
 #ifndef NO_BUFFERPOOL
     return bufferpool->performance();
@@ -1417,10 +1861,7 @@ std::string System::mallocStatus() {
 
 void System::resetMallocPerformanceCounters() {
 #ifndef NO_BUFFERPOOL
-    bufferpool->totalMallocs         = 0;
-    bufferpool->mallocsFromMedPool   = 0;
-    bufferpool->mallocsFromSmallPool = 0;
-    bufferpool->mallocsFromTinyPool  = 0;
+    bufferpool->resetCounters();
 #endif
 }
 
@@ -1441,7 +1882,7 @@ inline void initMem() {
 void* System::malloc(size_t bytes) {
 #ifndef NO_BUFFERPOOL
     initMem();
-    return bufferpool->malloc(bytes);
+    return bufferpool->malloc(bytes, currentThreadCache());
 #else
     return ::malloc(bytes);
 #endif
@@ -1463,7 +1904,7 @@ void* System::calloc(size_t n, size_t x) {
 void* System::realloc(void* block, size_t bytes) {
 #ifndef NO_BUFFERPOOL
     initMem();
-    return bufferpool->realloc(block, bytes);
+    return bufferpool->realloc(block, bytes, currentThreadCache());
 #else
     return ::realloc(block, bytes);
 #endif
@@ -1472,7 +1913,11 @@ void* System::realloc(void* block, size_t bytes) {
 
 void System::free(void* p) {
 #ifndef NO_BUFFERPOOL
-    bufferpool->free(p);
+    if (p == NULL) {
+        // The pool may not exist yet, so do not look up the thread cache
+        return;
+    }
+    bufferpool->free(p, currentThreadCache());
 #else
     return ::free(p);
 #endif
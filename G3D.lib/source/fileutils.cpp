@@ -21,9 +21,6 @@
 
 #include <sys/stat.h>
 #include <sys/types.h>
-#if _HAVE_ZIP /* G3DFIX: Use ZIP-library only if defined */
-    #include <zip.h>
-#endif
 
 #ifdef G3D_WINDOWS
    // Needed for _getcwd
@@ -138,31 +135,23 @@ std::string readWholeFile(const std::string& filename) {
 #if _HAVE_ZIP /* G3DFIX: Use ZIP-library only if defined */
         // Zipfiles require Unix-style slashes
         std::string internalFile = FilePath::canonicalize(filename.substr(zipfile.length() + 1));
-        struct zip* z = zip_open(zipfile.c_str(), ZIP_CHECKCONS, NULL);
-        {
-            struct zip_stat info;
-            zip_stat_init( &info );    // TODO: Docs unclear if zip_stat_init is required.
-            zip_stat(z, internalFile.c_str(), ZIP_FL_NOCASE, &info);
-
-            // Add NULL termination
-            char* buffer = reinterpret_cast<char*>(System::alignedMalloc(info.size + 1, 16));
-            buffer[info.size] = '\0';
-
-            struct zip_file* zf = zip_fopen( z, internalFile.c_str(), ZIP_FL_NOCASE );
-            if (zf == NULL) {
-                throw std::string("\"") + internalFile + "\" inside \"" + zipfile + "\" could not be opened.";
-            } else {
-                const int64 bytesRead = zip_fread( zf, buffer, (info.size));
-                debugAssertM((int64)bytesRead == (int64)info.size,
-                             internalFile + " was corrupt because it unzipped to the wrong size.");
-                (void)bytesRead;
-                zip_fclose( zf );
-            }
-            // Copy the string
-            s = buffer;
+        const int64 length = FileSystem::zipEntrySize(zipfile, internalFile);
+        if (length == -1) {
+            throw std::string("\"") + internalFile + "\" inside \"" + zipfile + "\" could not be opened.";
+        }
+
+        // Add NULL termination
+        char* buffer = reinterpret_cast<char*>(System::alignedMalloc(length + 1, 16));
+        buffer[length] = '\0';
+
+        if (! FileSystem::readZipEntry(zipfile, internalFile, buffer, length)) {
             System::alignedFree(buffer);
+            throw std::string("\"") + internalFile + "\" inside \"" + zipfile + "\" was corrupt because it unzipped to the wrong size.";
         }
-        zip_close( z );
+
+        // Copy the string
+        s = buffer;
+        System::alignedFree(buffer);
 #endif
     }
 
@@ -178,19 +167,8 @@ int64 fileLength(const std::string& filename) {
 #if _HAVE_ZIP /* G3DFIX: Use ZIP-library only if defined */
         std::string zip, contents;
         if(zipfileExists(filename, zip, contents)){
-            int64 requiredMem;
-
-                        struct zip *z = zip_open( zip.c_str(), ZIP_CHECKCONS, NULL );
-                        debugAssertM(z != NULL, zip + ": zip open failed.");
-            {
-                                struct zip_stat info;
-                                zip_stat_init( &info );    // TODO: Docs unclear if zip_stat_init is required.
-                                int success = zip_stat( z, contents.c_str(), ZIP_FL_NOCASE, &info );
-                (void)success;
-                                debugAssertM(success == 0, zip + ": " + contents + ": zip stat failed.");
-                                requiredMem = info.size;
-            }
-                        zip_close( z );
+            const int64 requiredMem = FileSystem::zipEntrySize(zip, contents);
+            debugAssertM(requiredMem != -1, zip + ": " + contents + ": zip stat failed.");
             return requiredMem;
         } else {
         return -1;
@@ -318,15 +296,8 @@ static void _zip_resolveDirectory(std::string& completeDir, const std::string& d
 
 /** assumes that zipDir references a .zip file */
 static bool _zip_zipContains(const std::string& zipDir, const std::string& desiredFile){
-        struct zip *z = zip_open( zipDir.c_str(), ZIP_CHECKCONS, NULL );
-    //the last parameter, an int, determines case sensitivity:
-    //1 is sensitive, 2 is not, 0 is default
-        int test = zip_name_locate( z, desiredFile.c_str(), ZIP_FL_NOCASE );
-        zip_close( z );
-    if(test == -1){
-        return false;
-    }
-    return true;
+    // Case insensitive, using the cached index of the zipfile
+    return FileSystem::zipEntrySize(zipDir, desiredFile) != -1;
 }
 #endif
 
@@ -740,20 +711,14 @@ static void getFileOrDirListZip(const std::string& path,
                                 bool wantFiles,
                                 bool includePath){
 #if _HAVE_ZIP /* G3DFIX: Use ZIP-library only if defined */
-    struct zip *z = zip_open( path.c_str(), ZIP_CHECKCONS, NULL );
+    Array<std::string> entry;
+    FileSystem::getZipEntries(path, entry);
 
     Set<std::string> fileSet;
-
-    int count = zip_get_num_files( z );
-    for( int i = 0; i < count; ++i ) {
-        struct zip_stat info;
-        zip_stat_init( &info );    // TODO: Docs unclear if zip_stat_init is required.
-        zip_stat_index( z, i, ZIP_FL_NOCASE, &info );
-        _zip_addEntry(path, prefix, info.name, fileSet, wantFiles, includePath);
+    for (int i = 0; i < entry.size(); ++i) {
+        _zip_addEntry(path, prefix, entry[i], fileSet, wantFiles, includePath);
     }
 
-    zip_close( z );
-
     fileSet.getMembers(files);
 #endif
 }